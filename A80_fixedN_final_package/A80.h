@@ -0,0 +1,23 @@
+#pragma once
+// libA80 public header: everything a tool needs to link against libA80.so.
+//   Config.h       A80Config (header-only, default values = process_runs_A80 defaults)
+//   A80Types.h     SummaryRow / AeqResult / PeakWin
+//   Metrics.h      Aeq / coverage-curve routines on counts (no ROOT objects needed)
+//   RunProcessor.h RunProcessor (file or in-memory input), RunAccumulator (incremental) and RunResult
+//   RunFollower.h  live follow mode for a run file that is still growing
+#include "Config.h"
+#include "A80Types.h"
+#include "Metrics.h"
+#include "RunProcessor.h"
+#include "RunFollower.h"
+
+#include <cstddef>
+
+// In-memory entry point: arrays of (E, x, y), one entry per event (first hit,
+// DSSDX_mul==1 && DSSDY_mul==1), in, summary row out. No file round-trip.
+inline SummaryRow AnalyzeA80Events(const A80Config& cfg, int run,
+                                   const double* E, const double* x, const double* y, size_t n) {
+  RunResult res;
+  RunProcessor(cfg).AnalyzeEvents(run, E, x, y, n, res);
+  return res.row;
+}
@@ -1,6 +1,16 @@
 #pragma once
 #include <cstdint>
 #include <cstring>
+#include <vector>
+
+inline uint64_t Mix64(uint64_t x) {
+  // simple 64-bit mix (splitmix64-like)
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  x = x ^ (x >> 31);
+  return x;
+}
 
 // AeqResult: "equivalent pixels" for target coverage (e.g. 80%)
 // n_pix: integer number of bins needed to reach target
@@ -12,6 +22,26 @@ struct AeqResult {
   double    cov_at_npix = 0.0;
 };
 
+// Columnar buffer of events passing the global gate
+// (DSSDX_mul==1 && DSSDY_mul==1 && EgLo<=DSSDX_E<=EgHi).
+// Only (E, x, y) of the first hit are kept, so every pass after the peak fits
+// runs over this buffer instead of decompressing tr_map again.
+struct GatedEvents {
+  std::vector<double> E;
+  std::vector<double> x;
+  std::vector<double> y;
+
+  size_t size() const { return E.size(); }
+
+  void clear() {
+    E.clear(); x.clear(); y.clear();
+  }
+
+  void push_back(double e, double xx, double yy) {
+    E.push_back(e); x.push_back(xx); y.push_back(yy);
+  }
+};
+
 // Peak window + fit result + ROI + per-peak metrics
 struct PeakWin {
   double win_lo = 0.0;
@@ -69,6 +99,25 @@ struct SummaryRow {
   long long A80pix_fixN[3];
   double A80cov_fixN[3];
 
+  // Fixed-N replicas (A80Config::fixedNReplicas > 1): replica 0 is the reservoir above,
+  // the others are independent N0-subsets of the same ROI events.
+  // lo/hi: central percentile interval at A80Config::fixedNIntervalCL.
+  int nRepFix = 0;
+  double A80eq_fixN_mean[3];
+  double A80eq_fixN_std[3];
+  double A80eq_fixN_lo[3];
+  double A80eq_fixN_hi[3];
+
+  // Coverage curve at A80Config::curveFracs (first nCurve entries valid, rest -999)
+  static constexpr int kMaxCurve = 8;
+  int nCurve = 0;
+  double curveFrac[kMaxCurve];
+  double Aeq_curve_all[kMaxCurve];
+  double Xeq_curve_all[kMaxCurve];
+  double Yeq_curve_all[kMaxCurve];
+  double Aeq_curve[3][kMaxCurve];
+  double Aeq_curve_fixN[3][kMaxCurve];
+
   void reset(int run_) {
     run = run_;
     nPeaks = 0;
@@ -77,6 +126,14 @@ struct SummaryRow {
     A80_eq_all = X80_eq_all = Y80_eq_all = 0.0;
     A80_pix_all = X80_pix_all = Y80_pix_all = 0;
     A80_cov_all = X80_cov_all = Y80_cov_all = 0.0;
+    nRepFix = 0;
+
+    nCurve = 0;
+    for (int j = 0; j < kMaxCurve; ++j) {
+      curveFrac[j] = -999.0;
+      Aeq_curve_all[j] = Xeq_curve_all[j] = Yeq_curve_all[j] = -999.0;
+      for (int i = 0; i < 3; ++i) Aeq_curve[i][j] = Aeq_curve_fixN[i][j] = -999.0;
+    }
 
     for (int i = 0; i < 3; ++i) {
       muE[i] = -999.0;
@@ -94,6 +151,9 @@ struct SummaryRow {
       A80eq_fixN[i] = -999.0;
       A80pix_fixN[i] = 0;
       A80cov_fixN[i] = 0.0;
+
+      A80eq_fixN_mean[i] = A80eq_fixN_std[i] = -999.0;
+      A80eq_fixN_lo[i] = A80eq_fixN_hi[i] = -999.0;
     }
   }
 };
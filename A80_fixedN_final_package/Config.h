@@ -1,11 +1,16 @@
 #pragma once
 #include "A80Types.h"
 #include <cstdint>
+#include <memory>
+#include <vector>
+
+class PixelGainMap; // common/PixelGainMap.h
 
 // A80 / X80 / Y80 QA 管线的“集中式参数配置”。
 // 只需要在这里修改参数并重新编译即可，无需到各个 .cpp 里找魔法数字。
 //
 // 约定：
+// - 新增会影响结果的参数时，同步加入 RunCache.cpp 的 HashConfig()，否则 --cache 会复用旧结果
 // - 能量单位：keV
 // - 峰编号：0=Peak1，1=Peak2，2=Peak3
 struct A80Config {
@@ -22,10 +27,22 @@ struct A80Config {
   // 改动 nEbins 会改变单 bin 计数大小；阈值可能需要相应调整。
   int nEbins = 500;
 
+  // -------- 事件读取方式 --------
+  // true ：单遍读取。tr_map 只解压一次，门内事件的 (E, x, y) 存入内存列式缓冲，
+  //        拟合之后的 XY / 蓄水池抽样都在缓冲上进行（门内事件远少于整棵树）。
+  // false：旧的两遍读取（填 hE 一遍，拟合后填 XY 再读一遍），仅用于对比验证。
+  bool singlePass = true;
+
   // -------- A80 / X80 / Y80 的目标覆盖率 --------
   // A80eq 的定义是：覆盖 targetFrac(默认 80%) 计数所需的等效像素/等效 bin 数。
   double targetFrac = 0.80;
 
+  // -------- 覆盖率曲线 A(f) --------
+  // 与 targetFrac 在同一次排序/累计中求出，summary 里写成定长数组（见 SummaryRow::kMaxCurve，超出部分忽略）：
+  //   curveFrac[i]、Aeq_curve_all/Xeq_curve_all/Yeq_curve_all[i]、Aeq_curve[峰][i]、Aeq_curve_fixN[峰][i]
+  // 0.39 = 2D 高斯 1σ 内的概率（1 - exp(-1/2)）。留空则不输出曲线（nCurve=0）。
+  std::vector<double> curveFracs = {0.39, 0.50, 0.80, 0.90, 0.95};
+
   // -------- 峰搜索与拟合相关参数 --------
   // 初次拟合窗口：以 seed 峰位为中心的局部窗口 [seed-W, seed+W]
   double fitWindow_keV = 80.0;
@@ -67,6 +84,35 @@ struct A80Config {
   int  peakFixedN   = 5000;      // N0：固定抽样事件数
   uint64_t fixedNSeedBase = 12345ULL; // 基础随机种子（+runnum/峰号 生成每个 run 的可复现随机序列）
 
+  // Fixed-N 误差估计：每个峰共 R=fixedNReplicas 个副本。
+  // 副本 0 就是上面的蓄水池样本（A80eq_fixN 不变）；副本 1..R-1 从同一批 ROI 事件（已在内存里）
+  // 各自无放回地均匀抽 N0 个，种子为 Mix64(峰种子 + r)，结果与线程数无关、可复现。
+  // summary 增加 A80eq_fixN_mean/std/lo/hi，lo/hi 为中心置信区间（fixedNIntervalCL）的分位数。
+  // R<=1 时不做（这些分支为 -999）。副本在 fixedNReplicaThreads 个线程上并行（0=硬件线程数）。
+  // 用 --threads N (N>1) 按 run 并行时 main 把它设为 1，避免每个 run worker 再各开一组线程。
+  int    fixedNReplicas       = 1;
+  double fixedNIntervalCL     = 0.68;
+  int    fixedNReplicaThreads = 0;
+
+  // -------- 每个 run 的 QA PDF（5 页） --------
+  // PDF 不在数值管线里画，而是全部 run 处理完后，从 qa_plots.root / summary.root 读回直方图再统一画。
+  // - kNone  ：不画 PDF（只输出 summary.root / qa_plots.root）
+  // - kFailed：只画“有问题”的 run（有峰没找到，或 ROI 内没有事件，见 QaRender.h 的 IsFlaggedRun）
+  // - kAll   ：每个 run 都画（旧行为）
+  enum class RenderMode { kNone, kFailed, kAll };
+  RenderMode renderMode = RenderMode::kAll;
+
+  // -------- 在线监控（monitor_A80：跟随正在写入的 run 文件） --------
+  // 每次更新只读新增的 entry；峰每次都重新拟合，但只有当某个 ROI 边界移动超过 followRoiTol_keV
+  // （或峰出现/消失）时才采用新 ROI，并从内存里的门内事件重放 XY/蓄水池；否则新事件直接增量累加。
+  // run 结束时再做一次完整重拟合+重放，结果与 process_runs_A80 相同。不影响离线结果（不进 HashConfig）。
+  double followRoiTol_keV = 2.0;
+
+  // -------- 像素增益图（DSSD_recal_all 生成的 pixel_gain_map.dat，见 common/PixelGainMap.h） --------
+  // 非空时，读 tr_map 的同一遍里先按像素修正 E = g(DSSDX_Ch, DSSDY_Ch) * DSSDX_E，再做能量门与后续全部分析。
+  // 由 --pixel-gain FILE 载入；增益值进 HashConfig。内存接口 AnalyzeEvents 的 E 由调用者给出，不再修正。
+  std::shared_ptr<const PixelGainMap> pixelGain;
+
   // -------- XY 直方图分 bin（会直接影响 A80 的数值尺度） --------
   // 默认按像素化 index（X:128, Y:48）。如果改成更粗的 bin（例如 64x24），
   // A80 的绝对数值会随之变化（因为“一个 bin”代表更大的区域），比较前请统一标准。
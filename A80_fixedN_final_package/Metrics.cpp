@@ -4,18 +4,36 @@
 #include <TH2D.h>
 
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <thread>
+
+// Fraction indices in ascending order (the order in which a descending walk reaches them).
+static std::vector<size_t> FracOrder(const std::vector<double>& fracs) {
+  std::vector<size_t> order(fracs.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return fracs[a] < fracs[b]; });
+  return order;
+}
 
 AeqResult CalcAeqFromCounts(std::vector<double> counts, double targetFrac) {
-  AeqResult r;
-  if (counts.empty()) return r;
+  return CalcAeqCurveFromCounts(std::move(counts), {targetFrac})[0];
+}
+
+std::vector<AeqResult> CalcAeqCurveFromCounts(std::vector<double> counts, const std::vector<double>& fracs) {
+  std::vector<AeqResult> out(fracs.size());
+  if (counts.empty() || fracs.empty()) return out;
 
   double tot = 0.0;
   for (double c : counts) tot += c;
-  if (tot <= 0.0) return r;
+  if (tot <= 0.0) return out;
 
   std::sort(counts.begin(), counts.end(), std::greater<double>());
 
-  const double target = targetFrac * tot;
+  const std::vector<size_t> order = FracOrder(fracs);
+  size_t next = 0;
 
   double acc = 0.0, accPrev = 0.0;
   long long nFull = 0;
@@ -24,24 +42,28 @@ AeqResult CalcAeqFromCounts(std::vector<double> counts, double targetFrac) {
     accPrev = acc;
     acc += c;
     ++nFull;
-    if (acc >= target) {
+    for (; next < order.size() && acc >= fracs[order[next]] * tot; ++next) {
+      AeqResult& r = out[order[next]];
       r.n_pix = nFull;
       r.cov_at_npix = acc / tot;
 
-      const double need = target - accPrev; // (0..c]
+      const double need = fracs[order[next]] * tot - accPrev; // (0..c]
       double f = (c > 0.0) ? (need / c) : 1.0;
       if (f < 0.0) f = 0.0;
       if (f > 1.0) f = 1.0;
       r.n_eq = (nFull - 1) + f;
-      return r;
     }
+    if (next == order.size()) return out;
   }
 
-  // target not reached (shouldn't happen if tot>0)
-  r.n_pix = static_cast<long long>(counts.size());
-  r.n_eq = static_cast<double>(counts.size());
-  r.cov_at_npix = 1.0;
-  return r;
+  // target not reached (shouldn't happen if tot>0 and frac<=1)
+  for (; next < order.size(); ++next) {
+    AeqResult& r = out[order[next]];
+    r.n_pix = static_cast<long long>(counts.size());
+    r.n_eq = static_cast<double>(counts.size());
+    r.cov_at_npix = 1.0;
+  }
+  return out;
 }
 
 AeqResult CalcAeq2D(const TH2D* h, double targetFrac) {
@@ -79,19 +101,284 @@ AeqResult CalcAeq1D(const TH1D* h, double targetFrac) {
 
 
 AeqResult CalcAeq2DFromSampledBins(const std::vector<int>& binIdx, int nx, int ny, double targetFrac) {
-  AeqResult r;
-  if (nx <= 0 || ny <= 0) return r;
+  if (nx <= 0 || ny <= 0) return AeqResult();
+  return CalcAeq2DCurveFromSampledBins(binIdx, nx, ny, {targetFrac})[0];
+}
+
+std::vector<AeqResult> CalcAeq2DCurveFromSampledBins(const std::vector<int>& binIdx, int nx, int ny,
+                                                    const std::vector<double>& fracs) {
+  if (nx <= 0 || ny <= 0) return std::vector<AeqResult>(fracs.size());
 
   const int nbin = nx * ny;
-  std::vector<int> cnt(nbin, 0);
+  std::vector<uint32_t> cnt(static_cast<size_t>(nbin), 0);
   for (int idx : binIdx) {
     if (idx >= 0 && idx < nbin) cnt[idx] += 1;
   }
+  return CalcAeqCurveFromIntCounts(cnt.data(), cnt.size(), fracs);
+}
 
-  std::vector<double> counts;
-  counts.reserve(static_cast<size_t>(nbin));
-  for (int c : cnt) {
-    if (c > 0) counts.push_back(static_cast<double>(c));
+std::vector<AeqResult> CalcAeq2DSubsampleReplicas(const std::vector<int>& binIdx, int N0, int nReplicas,
+                                                  uint64_t seed, int nx, int ny, double targetFrac,
+                                                  int nThreads) {
+  std::vector<AeqResult> out;
+  if (N0 <= 0 || nReplicas <= 0 || nx <= 0 || ny <= 0) return out;
+  if (binIdx.size() < static_cast<size_t>(N0)) return out;
+  out.resize(static_cast<size_t>(nReplicas));
+
+  if (nThreads <= 0) nThreads = static_cast<int>(std::thread::hardware_concurrency());
+  nThreads = std::max(1, std::min(nThreads, nReplicas));
+
+  const size_t nbin = static_cast<size_t>(nx) * static_cast<size_t>(ny);
+
+  // Each worker owns one copy of the indices. A replica is a partial Fisher-Yates shuffle of
+  // N0 swaps, which are undone afterwards, so it costs O(N0) instead of O(size of binIdx).
+  auto worker = [&](int t) {
+    std::vector<int> work(binIdx);
+    std::vector<uint32_t> cnt(nbin, 0);
+    std::vector<size_t> swapped(static_cast<size_t>(N0));
+    const size_t n = work.size();
+
+    for (int r = t; r < nReplicas; r += nThreads) {
+      std::mt19937_64 rng(Mix64(seed + static_cast<uint64_t>(r + 1)));
+      for (size_t i = 0; i < static_cast<size_t>(N0); ++i) {
+        const size_t j = i + std::uniform_int_distribution<size_t>(0, n - 1 - i)(rng);
+        std::swap(work[i], work[j]);
+        swapped[i] = j;
+      }
+
+      for (int i = 0; i < N0; ++i) {
+        const int idx = work[static_cast<size_t>(i)];
+        if (idx >= 0 && static_cast<size_t>(idx) < nbin) ++cnt[static_cast<size_t>(idx)];
+      }
+      out[static_cast<size_t>(r)] = CalcAeqFromIntCounts(cnt.data(), cnt.size(), targetFrac);
+
+      for (int i = N0 - 1; i >= 0; --i) {
+        const int idx = work[static_cast<size_t>(i)];
+        if (idx >= 0 && static_cast<size_t>(idx) < nbin) cnt[static_cast<size_t>(idx)] = 0;
+        std::swap(work[static_cast<size_t>(i)], work[swapped[static_cast<size_t>(i)]]);
+      }
+    }
+  };
+
+  if (nThreads == 1) {
+    worker(0);
+    return out;
   }
-  return CalcAeqFromCounts(std::move(counts), targetFrac);
+  std::vector<std::thread> pool;
+  for (int t = 0; t < nThreads; ++t) pool.emplace_back(worker, t);
+  for (auto& th : pool) th.join();
+  return out;
+}
+
+ReplicaStats SummarizeReplicas(std::vector<double> v, double cl) {
+  ReplicaStats st;
+  if (v.empty()) return st;
+
+  const size_t n = v.size();
+  double sum = 0.0;
+  for (double x : v) sum += x;
+  st.mean = sum / n;
+
+  double ss = 0.0;
+  for (double x : v) ss += (x - st.mean) * (x - st.mean);
+  st.std = (n > 1) ? std::sqrt(ss / (n - 1)) : 0.0;
+
+  std::sort(v.begin(), v.end());
+  auto quantile = [&](double q) {
+    const double pos = q * (n - 1);
+    const size_t i = static_cast<size_t>(std::floor(pos));
+    if (i + 1 >= n) return v[n - 1];
+    const double w = pos - i;
+    return v[i] * (1.0 - w) + v[i + 1] * w;
+  };
+  st.lo = quantile(0.5 * (1.0 - cl));
+  st.hi = quantile(0.5 * (1.0 + cl));
+  return st;
+}
+
+namespace {
+
+// Walks the counts in descending order, one group of equal values at a time, with exactly
+// the arithmetic of CalcAeqFromCounts: every partial sum is an integer < 2^53, hence exact,
+// so accStart + k*v equals the one-by-one sum and the result is bit-identical.
+// All targets (ascending) are resolved in the same walk.
+struct AeqGroupWalker {
+  double tot = 0.0;
+  std::vector<double> target; // ascending
+  std::vector<AeqResult> r;   // same order as target
+  size_t next = 0;
+  double acc = 0.0;
+  long long nBefore = 0;
+
+  // true once every target is reached (results in r)
+  bool Add(double v, long long m) {
+    const double accEnd = acc + static_cast<double>(m) * v;
+    for (; next < target.size() && accEnd >= target[next]; ++next) {
+      Resolve(v, m, target[next], r[next]);
+    }
+    acc = accEnd;
+    nBefore += m;
+    return next == target.size();
+  }
+
+  void Resolve(double v, long long m, double t, AeqResult& out) const {
+    // smallest k in [1, m] with acc + k*v >= t
+    long long k = static_cast<long long>(std::ceil((t - acc) / v));
+    k = std::max(1LL, std::min(m, k));
+    while (k > 1 && acc + static_cast<double>(k - 1) * v >= t) --k;
+    while (k < m && acc + static_cast<double>(k) * v < t) ++k;
+
+    const double accPrev = acc + static_cast<double>(k - 1) * v;
+    const double accK = accPrev + v;
+    const long long nFull = nBefore + k;
+
+    out.n_pix = nFull;
+    out.cov_at_npix = accK / tot;
+
+    const double need = t - accPrev; // (0..v]
+    double f = need / v;
+    if (f < 0.0) f = 0.0;
+    if (f > 1.0) f = 1.0;
+    out.n_eq = (nFull - 1) + f;
+  }
+};
+
+} // namespace
+
+AeqResult CalcAeqFromIntCounts(const uint32_t* counts, size_t n, double targetFrac) {
+  return CalcAeqCurveFromIntCounts(counts, n, {targetFrac})[0];
+}
+
+std::vector<AeqResult> CalcAeqCurveFromIntCounts(const uint32_t* counts, size_t n,
+                                                 const std::vector<double>& fracs) {
+  std::vector<AeqResult> out(fracs.size());
+  if (fracs.empty()) return out;
+
+  uint64_t totI = 0;
+  uint32_t vmax = 0;
+  size_t nnz = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const uint32_t c = counts[i];
+    if (c == 0) continue;
+    totI += c;
+    if (c > vmax) vmax = c;
+    ++nnz;
+  }
+  if (nnz == 0) return out;
+
+  const std::vector<size_t> order = FracOrder(fracs);
+  AeqGroupWalker w;
+  w.tot = static_cast<double>(totI);
+  w.target.reserve(order.size());
+  for (size_t i : order) w.target.push_back(fracs[i] * w.tot);
+  w.r.resize(order.size());
+
+  auto finish = [&]() {
+    // targets not reached (only if frac > 1)
+    for (size_t j = w.next; j < w.r.size(); ++j) {
+      w.r[j].n_pix = static_cast<long long>(nnz);
+      w.r[j].n_eq = static_cast<double>(nnz);
+      w.r[j].cov_at_npix = 1.0;
+    }
+    for (size_t j = 0; j < order.size(); ++j) out[order[j]] = w.r[j];
+    return out;
+  };
+
+  // Counting sort when the value range is comparable to the number of bins (pixel maps);
+  // otherwise (e.g. 1D marginals with large counts) sort the nonzero values.
+  const size_t kCountingSlack = 4096;
+  if (static_cast<size_t>(vmax) <= 4 * nnz + kCountingSlack) {
+    std::vector<uint32_t> mult(static_cast<size_t>(vmax) + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+      if (counts[i] > 0) ++mult[counts[i]];
+    }
+    for (uint32_t v = vmax; v > 0; --v) {
+      if (mult[v] > 0 && w.Add(static_cast<double>(v), mult[v])) break;
+    }
+  } else {
+    std::vector<uint32_t> vals;
+    vals.reserve(nnz);
+    for (size_t i = 0; i < n; ++i) {
+      if (counts[i] > 0) vals.push_back(counts[i]);
+    }
+    std::sort(vals.begin(), vals.end(), std::greater<uint32_t>());
+    for (size_t i = 0; i < vals.size();) {
+      size_t j = i + 1;
+      while (j < vals.size() && vals[j] == vals[i]) ++j;
+      if (w.Add(static_cast<double>(vals[i]), static_cast<long long>(j - i))) break;
+      i = j;
+    }
+  }
+  return finish();
+}
+
+// Same bin rule as TAxis::FindFixBin for fixed bins: 0 = underflow, n+1 = overflow (also NaN).
+static inline int AxisBin(double v, int n, double lo, double hi) {
+  if (v < lo) return 0;
+  if (!(v < hi)) return n + 1;
+  return 1 + static_cast<int>(n * (v - lo) / (hi - lo));
+}
+
+PixelCounts::PixelCounts(int nx, double xlo, double xhi, int ny, double ylo, double yhi)
+  : nx_(nx), ny_(ny), xlo_(xlo), xhi_(xhi), ylo_(ylo), yhi_(yhi),
+    c_(static_cast<size_t>(nx) * static_cast<size_t>(ny), 0),
+    xOnly_(static_cast<size_t>(nx), 0),
+    yOnly_(static_cast<size_t>(ny), 0) {}
+
+void PixelCounts::Fill(double x, double y) {
+  const int bx = AxisBin(x, nx_, xlo_, xhi_);
+  const int by = AxisBin(y, ny_, ylo_, yhi_);
+  const bool inX = (bx >= 1 && bx <= nx_);
+  const bool inY = (by >= 1 && by <= ny_);
+  if (inX && inY) ++c_[static_cast<size_t>(by - 1) * nx_ + (bx - 1)];
+  else if (inX)   ++xOnly_[bx - 1];
+  else if (inY)   ++yOnly_[by - 1];
+}
+
+std::vector<uint32_t> PixelCounts::MarginalX() const {
+  std::vector<uint32_t> m(xOnly_);
+  for (int iy = 0; iy < ny_; ++iy) {
+    const uint32_t* row = &c_[static_cast<size_t>(iy) * nx_];
+    for (int ix = 0; ix < nx_; ++ix) m[ix] += row[ix];
+  }
+  return m;
+}
+
+std::vector<uint32_t> PixelCounts::MarginalY() const {
+  std::vector<uint32_t> m(yOnly_);
+  for (int iy = 0; iy < ny_; ++iy) {
+    const uint32_t* row = &c_[static_cast<size_t>(iy) * nx_];
+    uint32_t s = 0;
+    for (int ix = 0; ix < nx_; ++ix) s += row[ix];
+    m[iy] += s;
+  }
+  return m;
+}
+
+std::vector<AeqResult> PixelCounts::Aeq2DCurve(const std::vector<double>& fracs) const {
+  return CalcAeqCurveFromIntCounts(c_.data(), c_.size(), fracs);
+}
+
+std::vector<AeqResult> PixelCounts::AeqXCurve(const std::vector<double>& fracs) const {
+  const std::vector<uint32_t> m = MarginalX();
+  return CalcAeqCurveFromIntCounts(m.data(), m.size(), fracs);
+}
+
+std::vector<AeqResult> PixelCounts::AeqYCurve(const std::vector<double>& fracs) const {
+  const std::vector<uint32_t> m = MarginalY();
+  return CalcAeqCurveFromIntCounts(m.data(), m.size(), fracs);
+}
+
+AeqResult PixelCounts::Aeq2D(double targetFrac) const {
+  return CalcAeqFromIntCounts(c_.data(), c_.size(), targetFrac);
+}
+
+AeqResult PixelCounts::AeqX(double targetFrac) const {
+  const std::vector<uint32_t> m = MarginalX();
+  return CalcAeqFromIntCounts(m.data(), m.size(), targetFrac);
+}
+
+AeqResult PixelCounts::AeqY(double targetFrac) const {
+  const std::vector<uint32_t> m = MarginalY();
+  return CalcAeqFromIntCounts(m.data(), m.size(), targetFrac);
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "A80Types.h"
+#include <cstdint>
 #include <vector>
 
 class TH1D;
@@ -8,6 +9,10 @@ class TH2D;
 // counts: per-bin counts (positive only recommended). Sorted descending internally.
 AeqResult CalcAeqFromCounts(std::vector<double> counts, double targetFrac);
 
+// 覆盖率曲线 A(f)：排序一次，沿累计覆盖率一次走完，给出 fracs 中每个 f 的 Aeq（顺序与 fracs 相同）。
+// 每个 f 的结果与单独调用 CalcAeqFromCounts(counts, f) 逐位相同。
+std::vector<AeqResult> CalcAeqCurveFromCounts(std::vector<double> counts, const std::vector<double>& fracs);
+
 AeqResult CalcAeq2D(const TH2D* h, double targetFrac);
 AeqResult CalcAeq1D(const TH1D* h, double targetFrac);
 
@@ -16,3 +21,63 @@ AeqResult CalcAeq1D(const TH1D* h, double targetFrac);
 // 传入的是每个事件落入的像素 bin 下标 idx = iy*nx + ix（0-based）。
 // 该函数会把这些 idx 统计成每像素计数，再调用 CalcAeqFromCounts。
 AeqResult CalcAeq2DFromSampledBins(const std::vector<int>& binIdx, int nx, int ny, double targetFrac);
+std::vector<AeqResult> CalcAeq2DCurveFromSampledBins(const std::vector<int>& binIdx, int nx, int ny,
+                                                    const std::vector<double>& fracs);
+
+// Fixed-N 副本：从 binIdx（某峰 ROI 内全部事件的像素下标）中无放回均匀抽 N0 个，重复 nReplicas 次；
+// 第 r 个副本（r=1..nReplicas）的随机种子为 Mix64(seed + r)，因此结果与 nThreads 无关。
+// 返回每个副本的 2D Aeq（下标 r-1）。binIdx.size() < N0 时返回空。
+std::vector<AeqResult> CalcAeq2DSubsampleReplicas(const std::vector<int>& binIdx, int N0, int nReplicas,
+                                                  uint64_t seed, int nx, int ny, double targetFrac,
+                                                  int nThreads);
+
+// 副本分布的汇总：均值、样本标准差，以及中心 cl 区间的分位数（线性插值）。
+struct ReplicaStats {
+  double mean = -999.0;
+  double std  = -999.0;
+  double lo   = -999.0;
+  double hi   = -999.0;
+};
+ReplicaStats SummarizeReplicas(std::vector<double> v, double cl);
+
+
+// 整数计数版本：结果与 CalcAeqFromCounts 逐位相同（整数计数的部分和在 double 里是精确的），
+// 但不做整体排序：按计数值做计数排序（值域过大时退回对 uint32 排序），
+// 并按“同值分组”一次跳过整组，到达目标覆盖率即停止。
+AeqResult CalcAeqFromIntCounts(const uint32_t* counts, size_t n, double targetFrac);
+std::vector<AeqResult> CalcAeqCurveFromIntCounts(const uint32_t* counts, size_t n,
+                                                 const std::vector<double>& fracs);
+
+// 直方图无关的 A80/X80/Y80 引擎：事件循环里直接往扁平 uint32_t[nx*ny] 里计数，
+// 分 bin 规则与 TH2D(nx,xlo,xhi,ny,ylo,yhi) 完全一致（TAxis::FindBin）。
+// X/Y 边缘分布由同一数组求和得到；另外记录“x 在范围内但 y 越界”（及反之）的事件，
+// 因此 AeqX/AeqY 与对 TH2D::ProjectionX/Y（默认含 under/overflow）调用 CalcAeq1D 的结果相同。
+class PixelCounts {
+public:
+  PixelCounts(int nx, double xlo, double xhi, int ny, double ylo, double yhi);
+
+  void Fill(double x, double y);
+
+  AeqResult Aeq2D(double targetFrac) const;
+  AeqResult AeqX(double targetFrac) const;
+  AeqResult AeqY(double targetFrac) const;
+
+  // 覆盖率曲线（见 CalcAeqCurveFromCounts）
+  std::vector<AeqResult> Aeq2DCurve(const std::vector<double>& fracs) const;
+  std::vector<AeqResult> AeqXCurve(const std::vector<double>& fracs) const;
+  std::vector<AeqResult> AeqYCurve(const std::vector<double>& fracs) const;
+
+  std::vector<uint32_t> MarginalX() const;
+  std::vector<uint32_t> MarginalY() const;
+
+  int nx() const { return nx_; }
+  int ny() const { return ny_; }
+  const std::vector<uint32_t>& pixels() const { return c_; } // idx = iy*nx + ix (0-based)
+
+private:
+  int nx_, ny_;
+  double xlo_, xhi_, ylo_, yhi_;
+  std::vector<uint32_t> c_;     // nx*ny in-range pixels
+  std::vector<uint32_t> xOnly_; // x in range, y under/overflow
+  std::vector<uint32_t> yOnly_; // y in range, x under/overflow
+};
@@ -1,7 +1,7 @@
 #include "PeakFinder.h"
+#include "GausFit.h"
 
 #include <TH1D.h>
-#include <TF1.h>
 
 #include <algorithm>
 #include <cmath>
@@ -29,28 +29,42 @@ bool FitOnePeakGaus(TH1D* hE, PeakWin& p, const A80Config& cfg) {
   const double r1 = std::max(p.win_lo, seed - W);
   const double r2 = std::min(p.win_hi, seed + W);
 
-  TF1 f1("f1", "gaus", r1, r2);
-  f1.SetParameters(yMax, seed, cfg.seedSigma_keV);  // A, mu, sigma
-  f1.SetParLimits(2, cfg.sigmaMin_keV, cfg.sigmaMax_keV);
-  hE->Fit(&f1, "RQ0");
+  // Native fitter (GausFit.h): same Neyman chi2 and bin selection as TH1::Fit "R", thread-safe
+  GausFitTask t;
+  t.y   = hE->GetArray() + 1;
+  t.n   = hE->GetNbinsX();
+  t.xlo = hE->GetXaxis()->GetXmin();
+  t.xhi = hE->GetXaxis()->GetXmax();
+  t.lo  = r1;
+  t.hi  = r2;
+  t.A0 = yMax; t.mu0 = seed; t.sigma0 = cfg.seedSigma_keV;
+  t.sigmaMin = cfg.sigmaMin_keV;
+  t.sigmaMax = cfg.sigmaMax_keV;
+  const GausFitResult f1 = FitGaus(t);
+  if (f1.status == GausFitResult::kTooFewBins) return false;
 
-  double mu = f1.GetParameter(1);
-  double sg = std::fabs(f1.GetParameter(2));
-  if (!(sg > 0.0)) return false;
+  const double mu = f1.mu;
+  const double sg = std::fabs(f1.sigma);
+  if (!(sg > 0.0) || !std::isfinite(mu)) return false;
 
   // core refit in [mu-refitSigmaMult*sg, mu+refitSigmaMult*sg] clipped
-  const double c1 = std::max(p.win_lo, mu - cfg.refitSigmaMult * sg);
-  const double c2 = std::min(p.win_hi, mu + cfg.refitSigmaMult * sg);
+  t.lo = std::max(p.win_lo, mu - cfg.refitSigmaMult * sg);
+  t.hi = std::min(p.win_hi, mu + cfg.refitSigmaMult * sg);
+  t.A0 = f1.A; t.mu0 = mu; t.sigma0 = sg;
+  const GausFitResult f2 = FitGaus(t);
+  if (f2.status == GausFitResult::kTooFewBins) return false;
 
-  TF1 f2("f2", "gaus", c1, c2);
-  f2.SetParameters(f1.GetParameter(0), mu, sg);
-  f2.SetParLimits(2, cfg.sigmaMin_keV, cfg.sigmaMax_keV);
-  hE->Fit(&f2, "RQ0");
+  p.mu  = f2.mu;
+  p.sig = std::fabs(f2.sigma);
+  if (!(p.sig > 0.0) || !std::isfinite(p.mu)) return false;
 
-  p.mu  = f2.GetParameter(1);
-  p.sig = std::fabs(f2.GetParameter(2));
-  if (!(p.sig > 0.0)) return false;
+  SetPeakROI(p, cfg);
 
+  p.ok = true;
+  return true;
+}
+
+void SetPeakROI(PeakWin& p, const A80Config& cfg) {
   // ROI according to config
   if (cfg.roiMode == A80Config::ROIMode::kSigma) {
     p.roi_lo = p.mu - cfg.roiSigmaMult * p.sig;
@@ -59,7 +73,4 @@ bool FitOnePeakGaus(TH1D* hE, PeakWin& p, const A80Config& cfg) {
     p.roi_lo = p.mu - cfg.roiHalfWidth_keV;
     p.roi_hi = p.mu + cfg.roiHalfWidth_keV;
   }
-
-  p.ok = true;
-  return true;
 }
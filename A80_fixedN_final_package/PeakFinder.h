@@ -13,3 +13,7 @@ class TH1D;
 //
 // 返回 true 表示拟合成功并写入 p.mu/p.sig/p.roi_lo/p.roi_hi/p.ok。
 bool FitOnePeakGaus(TH1D* hE, PeakWin& p, const A80Config& cfg);
+
+// 按 cfg.roiMode 由 p.mu/p.sig 设置 p.roi_lo/p.roi_hi（FitOnePeakGaus 内部使用；
+// 从缓存/summary 恢复峰信息时也用它，保证 ROI 口径一致）。
+void SetPeakROI(PeakWin& p, const A80Config& cfg);
@@ -1,5 +1,7 @@
 #include "QaIO.h"
 
+#include "RunProcessor.h"
+
 #include <TFile.h>
 #include <TDirectory.h>
 #include <TSystem.h>
@@ -9,12 +11,79 @@
 #include <TH2D.h>
 #include <TCanvas.h>
 #include <TLatex.h>
+#include <TTree.h>
+
+#include <memory>
 
 
 void EnsureDir(const std::string& dir) {
   gSystem->mkdir(dir.c_str(), kTRUE);
 }
 
+void BindSummaryBranches(TTree& t, SummaryRow& r, bool forRead) {
+  auto bind = [&](const char* name, void* addr, const char* leaf) {
+    if (forRead) t.SetBranchAddress(name, addr);
+    else         t.Branch(name, addr, leaf);
+  };
+
+
+  bind("runnum", &r.run, "runnum/I");
+  bind("nPeaks", &r.nPeaks, "nPeaks/I");
+
+  bind("N_all", &r.N_all, "N_all/L");
+
+  bind("A80_eq_all", &r.A80_eq_all, "A80_eq_all/D");
+  bind("A80_pix_all", &r.A80_pix_all, "A80_pix_all/L");
+  bind("A80_cov_all", &r.A80_cov_all, "A80_cov_all/D");
+
+  bind("X80_eq_all", &r.X80_eq_all, "X80_eq_all/D");
+  bind("X80_pix_all", &r.X80_pix_all, "X80_pix_all/L");
+  bind("X80_cov_all", &r.X80_cov_all, "X80_cov_all/D");
+
+  bind("Y80_eq_all", &r.Y80_eq_all, "Y80_eq_all/D");
+  bind("Y80_pix_all", &r.Y80_pix_all, "Y80_pix_all/L");
+  bind("Y80_cov_all", &r.Y80_cov_all, "Y80_cov_all/D");
+
+  bind("muE", r.muE, "muE[3]/D");
+  bind("sigE", r.sigE, "sigE[3]/D");
+
+  bind("Npk", r.Npk, "Npk[3]/L");
+  bind("mux", r.mux, "mux[3]/D");
+  bind("muy", r.muy, "muy[3]/D");
+
+  bind("A80eq", r.A80eq, "A80eq[3]/D");
+  bind("A80pix", r.A80pix, "A80pix[3]/L");
+  bind("A80cov", r.A80cov, "A80cov[3]/D");
+
+  bind("X80eq", r.X80eq, "X80eq[3]/D");
+  bind("X80pix", r.X80pix, "X80pix[3]/L");
+  bind("X80cov", r.X80cov, "X80cov[3]/D");
+
+  bind("Y80eq", r.Y80eq, "Y80eq[3]/D");
+  bind("Y80pix", r.Y80pix, "Y80pix[3]/L");
+  bind("Y80cov", r.Y80cov, "Y80cov[3]/D");
+
+  bind("Nfix", r.Nfix, "Nfix[3]/L");
+  bind("A80eq_fixN", r.A80eq_fixN, "A80eq_fixN[3]/D");
+  bind("A80pix_fixN", r.A80pix_fixN, "A80pix_fixN[3]/L");
+  bind("A80cov_fixN", r.A80cov_fixN, "A80cov_fixN[3]/D");
+
+  bind("nRepFix", &r.nRepFix, "nRepFix/I");
+  bind("A80eq_fixN_mean", r.A80eq_fixN_mean, "A80eq_fixN_mean[3]/D");
+  bind("A80eq_fixN_std", r.A80eq_fixN_std, "A80eq_fixN_std[3]/D");
+  bind("A80eq_fixN_lo", r.A80eq_fixN_lo, "A80eq_fixN_lo[3]/D");
+  bind("A80eq_fixN_hi", r.A80eq_fixN_hi, "A80eq_fixN_hi[3]/D");
+
+  const int nc = SummaryRow::kMaxCurve;
+  bind("nCurve", &r.nCurve, "nCurve/I");
+  bind("curveFrac", r.curveFrac, TString::Format("curveFrac[%d]/D", nc));
+  bind("Aeq_curve_all", r.Aeq_curve_all, TString::Format("Aeq_curve_all[%d]/D", nc));
+  bind("Xeq_curve_all", r.Xeq_curve_all, TString::Format("Xeq_curve_all[%d]/D", nc));
+  bind("Yeq_curve_all", r.Yeq_curve_all, TString::Format("Yeq_curve_all[%d]/D", nc));
+  bind("Aeq_curve", r.Aeq_curve, TString::Format("Aeq_curve[3][%d]/D", nc));
+  bind("Aeq_curve_fixN", r.Aeq_curve_fixN, TString::Format("Aeq_curve_fixN[3][%d]/D", nc));
+}
+
 void WriteRunObjects(
   TFile& fqa, int run,
   TH1D& hE,
@@ -22,9 +91,7 @@ void WriteRunObjects(
   TH1D& hX_all, TH1D& hY_all,
   TH1D& hX1, TH1D& hY1,
   TH1D& hX2, TH1D& hY2,
-  TH1D& hX3, TH1D& hY3,
-  TCanvas* cEnergy, TCanvas* cAll,
-  TCanvas* cP1, TCanvas* cP2, TCanvas* cP3
+  TH1D& hX3, TH1D& hY3
 ) {
   const TString dname = TString::Format("run%05d", run);
   TDirectory* d = fqa.mkdir(dname);
@@ -42,15 +109,35 @@ void WriteRunObjects(
   hX2.Write("hX_p2"); hY2.Write("hY_p2");
   hX3.Write("hX_p3"); hY3.Write("hY_p3");
 
-  if (cEnergy) cEnergy->Write("c_energy");
-  if (cAll)    cAll->Write("c_all");
-  if (cP1)     cP1->Write("c_p1");
-  if (cP2)     cP2->Write("c_p2");
-  if (cP3)     cP3->Write("c_p3");
-
   fqa.cd();
 }
 
+// Take ownership of a histogram stored in d (detached from the file).
+template <class H>
+static std::unique_ptr<H> TakeHist(TDirectory* d, const char* name) {
+  H* h = dynamic_cast<H*>(d->Get(name));
+  if (h) h->SetDirectory(nullptr);
+  return std::unique_ptr<H>(h);
+}
+
+bool ReadRunObjects(TDirectory& f, int run, RunResult& res) {
+  TDirectory* d = f.GetDirectory(TString::Format("run%05d", run));
+  if (!d) return false;
+
+  res.hE      = TakeHist<TH1D>(d, "hE_5000_6000");
+  res.hXY_all = TakeHist<TH2D>(d, "hXY_all");
+  res.hX_all  = TakeHist<TH1D>(d, "hX_all");
+  res.hY_all  = TakeHist<TH1D>(d, "hY_all");
+  bool ok = res.hE && res.hXY_all && res.hX_all && res.hY_all;
+  for (int k = 0; k < 3; ++k) {
+    res.hXY[k] = TakeHist<TH2D>(d, TString::Format("hXY_p%d", k + 1));
+    res.hX[k]  = TakeHist<TH1D>(d, TString::Format("hX_p%d", k + 1));
+    res.hY[k]  = TakeHist<TH1D>(d, TString::Format("hY_p%d", k + 1));
+    ok = ok && res.hXY[k] && res.hX[k] && res.hY[k];
+  }
+  return ok;
+}
+
 void DrawXYPage(
   TCanvas& c, TLatex& t,
   TH2D& hxy, TH1D& hx, TH1D& hy, const char* title,
@@ -3,14 +3,21 @@
 #include <string>
 
 class TFile;
+class TDirectory;
 class TCanvas;
 class TH1D;
 class TH2D;
 class TLatex;
+class TTree;
+struct RunResult;
 
 // Create directory recursively.
 void EnsureDir(const std::string& dir);
 
+// Summary tree layout (one branch per SummaryRow field).
+// forRead=false creates the branches; forRead=true attaches r to an existing tree.
+void BindSummaryBranches(TTree& t, SummaryRow& r, bool forRead = false);
+
 // Write per-run objects into QA ROOT file (under run%05d directory).
 void WriteRunObjects(
   TFile& fqa, int run,
@@ -19,11 +26,13 @@ void WriteRunObjects(
   TH1D& hX_all, TH1D& hY_all,
   TH1D& hX1, TH1D& hY1,
   TH1D& hX2, TH1D& hY2,
-  TH1D& hX3, TH1D& hY3,
-  TCanvas* cEnergy, TCanvas* cAll,
-  TCanvas* cP1, TCanvas* cP2, TCanvas* cP3
+  TH1D& hX3, TH1D& hY3
 );
 
+// Read the objects written by WriteRunObjects (run%05d/ in f) back into res
+// (histograms detached from f). Returns false if the directory or a histogram is missing.
+bool ReadRunObjects(TDirectory& f, int run, RunResult& res);
+
 // Draw a 4-panel page: XY heatmap + X/Y projections + text block (A80/X80/Y80 + ROI).
 // NOTE: Pass in projections (hx, hy) that stay alive until after printing.
 void DrawXYPage(
@@ -0,0 +1,156 @@
+#include "QaRender.h"
+
+#include "RunProcessor.h"
+#include "QaIO.h"
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TSystem.h>
+#include <TString.h>
+
+#include <TH1D.h>
+#include <TH2D.h>
+#include <TCanvas.h>
+#include <TLine.h>
+#include <TLatex.h>
+
+#include <cstdio>
+
+bool IsFlaggedRun(const SummaryRow& r) {
+  return r.nPeaks < 3 || r.N_all <= 0;
+}
+
+bool WantPdf(const SummaryRow& r, const A80Config& cfg) {
+  switch (cfg.renderMode) {
+    case A80Config::RenderMode::kAll:    return true;
+    case A80Config::RenderMode::kFailed: return IsFlaggedRun(r);
+    case A80Config::RenderMode::kNone:   break;
+  }
+  return false;
+}
+
+void RenderRunPdf(RunResult& res, const A80Config& cfg, const std::string& pdfDir) {
+  const int run = res.row.run;
+  const PeakWin* P = res.P;
+  const int N0 = (cfg.enableFixedN ? cfg.peakFixedN : 0);
+
+  TH1D& hE = *res.hE;
+  TH2D& hXY_all = *res.hXY_all;
+
+  EnsureDir(pdfDir);
+  const TString pdf = TString::Format("%s/run%05d_QA_A80.pdf", pdfDir.c_str(), run);
+
+  TString roiDesc;
+  if (cfg.roiMode == A80Config::ROIMode::kFixed) {
+    roiDesc = TString::Format("fixed: mu#pm%.0f keV", cfg.roiHalfWidth_keV);
+  } else {
+    roiDesc = TString::Format("sigma: mu#pm%.1f#sigma", cfg.roiSigmaMult);
+  }
+
+  TCanvas cEnergy("cEnergy", "cEnergy", 1100, 850);
+  TCanvas cAll("cAll", "cAll", 1100, 850);
+  TCanvas cP1("cP1", "cP1", 1100, 850);
+  TCanvas cP2("cP2", "cP2", 1100, 850);
+  TCanvas cP3("cP3", "cP3", 1100, 850);
+
+  TLatex tx; tx.SetNDC(true);
+  cEnergy.Print((pdf + "[").Data());
+
+  // Page 1: energy + windows/ROIs
+  cEnergy.Clear();
+  hE.Draw();
+
+  TLine l; l.SetLineStyle(2);
+  const double ymax = hE.GetMaximum();
+  for (int i = 0; i < 3; ++i) {
+    l.DrawLine(P[i].win_lo, 0, P[i].win_lo, ymax * 0.55);
+    l.DrawLine(P[i].win_hi, 0, P[i].win_hi, ymax * 0.55);
+    if (P[i].ok) {
+      l.SetLineStyle(1);
+      l.DrawLine(P[i].roi_lo, 0, P[i].roi_lo, ymax * 0.85);
+      l.DrawLine(P[i].roi_hi, 0, P[i].roi_hi, ymax * 0.85);
+      l.SetLineStyle(2);
+    }
+  }
+
+  tx.SetTextSize(0.035);
+  tx.DrawLatex(0.12, 0.92, TString::Format("Cuts: DSSDX_mul==1 && DSSDY_mul==1 && DSSDX_E in [%.0f,%.0f] keV", cfg.EgLo, cfg.EgHi));
+  tx.DrawLatex(0.12, 0.88, TString::Format("ROI mode: %s", roiDesc.Data()));
+  tx.DrawLatex(0.12, 0.84, TString::Format("Fit: W=%.0f keV, refit=%.1f#sigma, minPeakMaxCount=%.0f",
+                                            cfg.fitWindow_keV, cfg.refitSigmaMult, cfg.minPeakMaxCount));
+  if (N0 > 0) {
+    tx.DrawLatex(0.12, 0.80, TString::Format("Fixed-N A80: enabled, N0=%d (compute only if Npk>=N0)", N0));
+  } else {
+    tx.DrawLatex(0.12, 0.80, "Fixed-N A80: disabled");
+  }
+
+  for (int i = 0; i < 3; ++i) {
+    const TString s = P[i].ok
+      ? TString::Format("Peak%d: mu=%.1f keV, sigma=%.1f keV, ROI=[%.0f,%.0f]",
+                        i + 1, P[i].mu, P[i].sig, P[i].roi_lo, P[i].roi_hi)
+      : TString::Format("Peak%d: NOT FOUND", i + 1);
+    tx.DrawLatex(0.12, 0.74 - 0.04 * i, s);
+  }
+  cEnergy.Print(pdf.Data());
+
+  // Page 2: all peaks union
+  DrawXYPage(cAll, tx, hXY_all, *res.hX_all, *res.hY_all, "All peaks (ROI union) XY",
+             nullptr, res.Aall, res.Xall, res.Yall, roiDesc.Data());
+  cAll.Print(pdf.Data());
+
+  // Page 3-5: each peak (pass Fixed-N metrics)
+  TCanvas* cPk[3] = {&cP1, &cP2, &cP3};
+  for (int k = 0; k < 3; ++k) {
+    DrawXYPage(*cPk[k], tx, *res.hXY[k], *res.hX[k], *res.hY[k], TString::Format("Peak%d XY (ROI)", k + 1),
+               &P[k], res.Aall, res.Xall, res.Yall, roiDesc.Data(), (N0>0? &res.Afix[k]:nullptr), res.Nfix[k], N0);
+    cPk[k]->Print(pdf.Data());
+  }
+
+  cEnergy.Print((pdf + "]").Data());
+}
+
+int RenderQaPdfs(const std::string& sumFile, const std::string& qaFile, const std::string& pdfDir,
+                 const A80Config& cfg, const std::set<int>& keepExisting) {
+  if (cfg.renderMode == A80Config::RenderMode::kNone) return 0;
+
+  TFile fsum(sumFile.c_str(), "READ");
+  TFile fqa(qaFile.c_str(), "READ");
+  if (fsum.IsZombie() || fqa.IsZombie()) {
+    std::printf("render: cannot open %s / %s\n", sumFile.c_str(), qaFile.c_str());
+    return 0;
+  }
+  auto* t = dynamic_cast<TTree*>(fsum.Get("summary"));
+  if (!t) {
+    std::printf("render: no summary tree in %s\n", sumFile.c_str());
+    return 0;
+  }
+
+  SummaryRow row;
+  row.reset(0);
+  BindSummaryBranches(*t, row, true);
+
+  int nPdf = 0;
+  const Long64_t n = t->GetEntries();
+  for (Long64_t i = 0; i < n; ++i) {
+    t->GetEntry(i);
+    if (!WantPdf(row, cfg)) continue;
+
+    const int run = row.run;
+    if (keepExisting.count(run) &&
+        !gSystem->AccessPathName(TString::Format("%s/run%05d_QA_A80.pdf", pdfDir.c_str(), run))) {
+      continue;
+    }
+
+    RunResult res;
+    res.row = row;
+    if (!ReadRunObjects(fqa, run, res)) {
+      std::printf("render: run%05d missing in %s, skip\n", run, qaFile.c_str());
+      continue;
+    }
+    RestoreResultFromRow(res, cfg);
+
+    RenderRunPdf(res, cfg, pdfDir);
+    ++nPdf;
+  }
+  return nPdf;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Config.h"
+#include <set>
+#include <string>
+
+struct RunResult;
+
+// A run worth looking at: some peak was not found, or nothing landed in the ROI union.
+bool IsFlaggedRun(const SummaryRow& r);
+
+// Does cfg.renderMode ask for a PDF of this run?
+bool WantPdf(const SummaryRow& r, const A80Config& cfg);
+
+// Five-page QA PDF of one run: pdfDir/run%05d_QA_A80.pdf
+// (energy + windows/ROIs, ROI union XY, then one XY page per peak).
+void RenderRunPdf(RunResult& res, const A80Config& cfg, const std::string& pdfDir);
+
+// Post-pass over finished outputs: read each summary row back from sumFile and its histograms
+// from qaFile, then render the runs selected by cfg.renderMode. Runs listed in keepExisting
+// (e.g. restored from the cache) are skipped when their PDF already exists.
+// Returns the number of PDFs written.
+int RenderQaPdfs(const std::string& sumFile, const std::string& qaFile, const std::string& pdfDir,
+                 const A80Config& cfg, const std::set<int>& keepExisting = {});
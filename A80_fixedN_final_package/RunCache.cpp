@@ -0,0 +1,185 @@
+#include "RunCache.h"
+
+#include "RunProcessor.h"
+#include "QaIO.h"
+#include "PixelGainMap.h"
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TNamed.h>
+#include <TSystem.h>
+#include <TString.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+static const char* kCacheVersion = "A80cache-v4"; // bump when SummaryRow (or how it is computed) changes
+
+static uint64_t HashBytes(uint64_t h, const void* data, size_t n) {
+  // FNV-1a, finalized with Mix64
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < n; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+template <class T>
+static uint64_t HashValue(uint64_t h, const T& v) {
+  return HashBytes(h, &v, sizeof(v));
+}
+
+uint64_t HashConfig(const A80Config& cfg) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  h = HashValue(h, cfg.EgLo);
+  h = HashValue(h, cfg.EgHi);
+  h = HashValue(h, cfg.nEbins);
+  h = HashValue(h, cfg.targetFrac);
+  h = HashValue(h, cfg.curveFracs.size()); // length first: [a] and [a, b] must not collide
+  for (double f : cfg.curveFracs) h = HashValue(h, f);
+  h = HashValue(h, cfg.fitWindow_keV);
+  h = HashValue(h, cfg.refitSigmaMult);
+  h = HashValue(h, cfg.minPeakMaxCount);
+  h = HashValue(h, cfg.seedSigma_keV);
+  h = HashValue(h, cfg.sigmaMin_keV);
+  h = HashValue(h, cfg.sigmaMax_keV);
+  h = HashValue(h, cfg.roiMode);
+  h = HashValue(h, cfg.roiSigmaMult);
+  h = HashValue(h, cfg.roiHalfWidth_keV);
+  h = HashValue(h, cfg.enableFixedN);
+  h = HashValue(h, cfg.peakFixedN);
+  h = HashValue(h, cfg.fixedNSeedBase);
+  h = HashValue(h, cfg.fixedNReplicas);
+  h = HashValue(h, cfg.fixedNIntervalCL);
+  h = HashValue(h, cfg.nx);
+  h = HashValue(h, cfg.ny);
+  h = HashValue(h, cfg.xlo);
+  h = HashValue(h, cfg.xhi);
+  h = HashValue(h, cfg.ylo);
+  h = HashValue(h, cfg.yhi);
+  for (int i = 0; i < 3; ++i) {
+    h = HashValue(h, cfg.Ptpl[i].win_lo);
+    h = HashValue(h, cfg.Ptpl[i].win_hi);
+  }
+  if (const PixelGainMap* m = cfg.pixelGain.get()) {
+    for (int x = 0; x < m->NX(); ++x) {
+      for (int y = 0; y < m->NY(); ++y) h = HashValue(h, m->Gain(x, y));
+    }
+  }
+  return Mix64(h);
+}
+
+// Checksum of the first and last 64 KiB: cheap even for multi-GB inputs.
+static uint64_t QuickChecksum(const std::string& path, long long size) {
+  const long long kChunk = 64 * 1024;
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return 0;
+
+  std::vector<char> buf(static_cast<size_t>(kChunk));
+  uint64_t h = 0xcbf29ce484222325ULL;
+
+  in.read(buf.data(), kChunk);
+  h = HashBytes(h, buf.data(), static_cast<size_t>(in.gcount()));
+
+  if (size > kChunk) {
+    in.clear();
+    in.seekg(std::max(kChunk, size - kChunk));
+    in.read(buf.data(), kChunk);
+    h = HashBytes(h, buf.data(), static_cast<size_t>(in.gcount()));
+  }
+  return Mix64(h);
+}
+
+RunCache::RunCache(std::string dir, const A80Config& cfg)
+  : dir_(std::move(dir)), cfg_(cfg), cfgHash_(HashConfig(cfg)) {
+  EnsureDir(dir_);
+}
+
+std::string RunCache::CacheFile(int run) const {
+  return TString::Format("%s/run%05d_cache.root", dir_.c_str(), run).Data();
+}
+
+std::string RunCache::MakeKey(const std::string& inputFile) const {
+  FileStat_t st;
+  if (gSystem->GetPathInfo(inputFile.c_str(), st) != 0) return "";
+
+  const long long size = static_cast<long long>(st.fSize);
+  const long long mtime = static_cast<long long>(st.fMtime);
+  return TString::Format("%s size=%lld mtime=%lld sum=%016llx cfg=%016llx", kCacheVersion,
+                         size, mtime,
+                         static_cast<unsigned long long>(QuickChecksum(inputFile, size)),
+                         static_cast<unsigned long long>(cfgHash_)).Data();
+}
+
+bool RunCache::Load(const std::string& inputFile, int run, RunResult& res) const {
+  const std::string cfn = CacheFile(run);
+  if (gSystem->AccessPathName(cfn.c_str())) return false;
+
+  const std::string key = MakeKey(inputFile);
+  if (key.empty()) return false;
+
+  TFile fc(cfn.c_str(), "READ");
+  if (fc.IsZombie()) return false;
+
+  auto* stored = dynamic_cast<TNamed*>(fc.Get("cache_key"));
+  if (!stored || key != stored->GetTitle()) return false;
+
+  auto* t = dynamic_cast<TTree*>(fc.Get("summary"));
+  if (!t || t->GetEntries() != 1) return false;
+
+  SummaryRow row;
+  row.reset(run);
+  BindSummaryBranches(*t, row, true);
+  t->GetEntry(0);
+  if (row.run != run) return false;
+
+  RunResult tmp;
+  tmp.row = row;
+  if (!ReadRunObjects(fc, run, tmp)) return false;
+
+  RestoreResultFromRow(tmp, cfg_);
+  tmp.fromCache = true;
+  res = std::move(tmp);
+  return true;
+}
+
+void RunCache::Store(const std::string& inputFile, const RunResult& res) const {
+  const std::string key = MakeKey(inputFile);
+  if (key.empty()) return;
+
+  const int run = res.row.run;
+  const std::string cfn = CacheFile(run);
+  const std::string tmpfn = cfn + ".tmp";
+
+  {
+    TFile fc(tmpfn.c_str(), "RECREATE");
+    if (fc.IsZombie()) {
+      std::printf("run%05d: cannot write cache %s\n", run, tmpfn.c_str());
+      return;
+    }
+
+    TNamed named("cache_key", key.c_str());
+    fc.WriteTObject(&named);
+
+    SummaryRow row = res.row;
+    auto* t = new TTree("summary", "summary"); // owned by fc
+    t->SetDirectory(&fc);
+    BindSummaryBranches(*t, row);
+    t->Fill();
+    fc.WriteTObject(t);
+
+    WriteRunObjects(fc, run, *res.hE,
+                    *res.hXY_all, *res.hXY[0], *res.hXY[1], *res.hXY[2],
+                    *res.hX_all, *res.hY_all,
+                    *res.hX[0], *res.hY[0],
+                    *res.hX[1], *res.hY[1],
+                    *res.hX[2], *res.hY[2]);
+    fc.Close();
+  }
+  gSystem->Rename(tmpfn.c_str(), cfn.c_str());
+}
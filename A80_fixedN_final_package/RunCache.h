@@ -0,0 +1,34 @@
+#pragma once
+#include "Config.h"
+#include <cstdint>
+#include <string>
+
+struct RunResult;
+
+// Persistent per-run result cache (one sidecar ROOT file per run in dir):
+//   run%05d_cache.root : TNamed "cache_key", 1-entry "summary" tree, run%05d/ histograms
+// An entry is valid only while its key matches: input file size, mtime, a checksum of the
+// first/last 64 KiB of the input (ROOT rewrites its header and key list there), the cache
+// format version, and a hash of every A80Config field that changes the results.
+class RunCache {
+public:
+  RunCache(std::string dir, const A80Config& cfg);
+
+  // true: res holds the cached summary row, histograms and restored peak info for run.
+  bool Load(const std::string& inputFile, int run, RunResult& res) const;
+
+  // Store a freshly analyzed run (written to a temp file, then renamed into place).
+  void Store(const std::string& inputFile, const RunResult& res) const;
+
+private:
+  std::string CacheFile(int run) const;
+  std::string MakeKey(const std::string& inputFile) const;
+
+  std::string dir_;
+  A80Config cfg_;
+  uint64_t cfgHash_ = 0;
+};
+
+// Hash of the A80Config fields that change the physics output.
+// NOTE: extend this whenever a result-affecting field is added to A80Config.
+uint64_t HashConfig(const A80Config& cfg);
@@ -0,0 +1,69 @@
+#include "RunFollower.h"
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TSystem.h>
+
+#include <cstdio>
+
+RunFollower::RunFollower(const A80Config& cfg, std::string file, int run)
+  : cfg_(cfg), file_(std::move(file)), run_(run) {
+  Reset();
+}
+
+RunFollower::~RunFollower() = default;
+
+void RunFollower::Reset() {
+  ev_.clear();
+  nextEntry_ = 0;
+  rebuilds_ = 0;
+  acc_ = std::make_unique<RunAccumulator>(cfg_, run_);
+}
+
+void RunFollower::Replay(size_t from) {
+  for (size_t i = from; i < ev_.size(); ++i) acc_->FillXY(ev_.E[i], ev_.x[i], ev_.y[i]);
+  acc_->Finish();
+}
+
+long long RunFollower::Update() {
+  if (gSystem->AccessPathName(file_.c_str())) return -1;
+
+  TFile fin(file_.c_str(), "READ");
+  if (fin.IsZombie()) return -1;
+
+  TTree* tr = dynamic_cast<TTree*>(fin.Get("tr_map"));
+  if (!tr) return -1;
+
+  GatedTreeReader reader(*tr, cfg_);
+  const long long n = reader.GetEntries();
+  if (n < nextEntry_) {
+    // file was rewritten (run restarted): start over
+    std::printf("run%05d: tr_map shrank (%lld -> %lld entries), restarting\n", run_, nextEntry_, n);
+    Reset();
+  }
+  if (n == nextEntry_) return 0;
+
+  const long long first = nextEntry_;
+  const size_t firstEv = ev_.size();
+  double E = 0.0, x = 0.0, y = 0.0;
+  for (long long i = first; i < n; ++i) {
+    if (!reader.Read(i, E, x, y)) continue;
+    ev_.push_back(E, x, y);
+    acc_->FillSpectrum(E);
+  }
+  nextEntry_ = n;
+
+  // new ROI -> the XY stage restarted, replay everything; otherwise only the new events
+  if (acc_->FitPeaks(cfg_.followRoiTol_keV)) {
+    ++rebuilds_;
+    Replay(0);
+  } else {
+    Replay(firstEv);
+  }
+  return n - first;
+}
+
+void RunFollower::Finalize() {
+  acc_->FitPeaks();
+  Replay(0);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Config.h"
+#include "RunProcessor.h"
+
+#include <memory>
+#include <string>
+
+// Follows one run file that is still being written (online monitor).
+// Each Update() reopens the file and reads only the tr_map entries past the last one seen;
+// gated events are kept in memory so a changed ROI (see A80Config::followRoiTol_keV) can be
+// replayed without touching the file again. Cost per update: O(new entries), plus O(gated
+// events) on the rare ROI change, instead of O(N) for a full reprocess every time.
+class RunFollower {
+public:
+  RunFollower(const A80Config& cfg, std::string file, int run);
+  ~RunFollower();
+
+  // Returns the number of new tr_map entries (0 = nothing new), or -1 if the file or
+  // tr_map is not readable yet (e.g. before the first AutoSave).
+  long long Update();
+
+  // Refit on the full spectrum and replay every buffered event: the same row as
+  // RunProcessor::AnalyzeRun gives for the closed file.
+  void Finalize();
+
+  const SummaryRow& row() const { return acc_->result().row; }
+  const RunResult& result() const { return acc_->result(); }
+
+  int run() const { return run_; }
+  long long entries() const { return nextEntry_; }
+  long long gatedEvents() const { return static_cast<long long>(ev_.size()); }
+  int roiRebuilds() const { return rebuilds_; }
+
+private:
+  void Reset();
+  void Replay(size_t from);
+
+  A80Config cfg_;
+  std::string file_;
+  int run_;
+
+  GatedEvents ev_;
+  long long nextEntry_ = 0;
+  std::unique_ptr<RunAccumulator> acc_;
+  int rebuilds_ = 0;
+};
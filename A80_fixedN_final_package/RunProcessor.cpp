@@ -3,24 +3,28 @@
 #include "PeakFinder.h"
 #include "Metrics.h"
 #include "QaIO.h"
+#include "RunCache.h"
+#include "PixelGainMap.h"
 
 #include <TFile.h>
 #include <TTree.h>
 #include <TSystem.h>
 #include <TString.h>
-#include <TStyle.h>
 
 #include <TH1D.h>
 #include <TH2D.h>
-#include <TCanvas.h>
-#include <TLine.h>
-#include <TLatex.h>
 
 #include <cstdio>
 #include <cstdlib>
 #include <memory>
 #include <random>
 #include <cmath>
+#include <algorithm>
+
+RunResult::RunResult() = default;
+RunResult::~RunResult() = default;
+RunResult::RunResult(RunResult&&) noexcept = default;
+RunResult& RunResult::operator=(RunResult&&) noexcept = default;
 
 RunProcessor::RunProcessor(Config cfg) : cfg_(std::move(cfg)) {}
 
@@ -36,92 +40,98 @@ static void ResetPeak(PeakWin& p, const PeakWin& tpl) {
   p.Y80_1D = {};
 }
 
-static inline uint64_t Mix64(uint64_t x) {
-  // simple 64-bit mix (splitmix64-like)
-  x += 0x9e3779b97f4a7c15ULL;
-  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
-  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
-  x = x ^ (x >> 31);
-  return x;
-}
-
-bool RunProcessor::ProcessRun(const std::string& indir, int run, TFile& fqa, const std::string& pdfDir, SummaryRow& outRow) const {
-  outRow.reset(run);
+void RestoreResultFromRow(RunResult& res, const A80Config& cfg) {
+  const SummaryRow& r = res.row;
+  const int N0 = (cfg.enableFixedN ? cfg.peakFixedN : 0);
 
-  PeakWin P[3];
-  for (int i = 0; i < 3; ++i) ResetPeak(P[i], cfg_.Ptpl[i]);
+  res.Aall = {r.A80_pix_all, r.A80_eq_all, r.A80_cov_all};
+  res.Xall = {r.X80_pix_all, r.X80_eq_all, r.X80_cov_all};
+  res.Yall = {r.Y80_pix_all, r.Y80_eq_all, r.Y80_cov_all};
 
-  const TString fn = TString::Format("%s/run%05d_map.root", indir.c_str(), run);
-  if (gSystem->AccessPathName(fn)) {
-    return false; // missing file
+  for (int i = 0; i < 3; ++i) {
+    PeakWin& p = res.P[i];
+    ResetPeak(p, cfg.Ptpl[i]);
+    res.Afix[i] = {};
+    res.Nfix[i] = 0;
+
+    if (!(r.sigE[i] > 0.0)) continue; // fit failed: muE/sigE stay at -999
+    p.ok  = true;
+    p.mu  = r.muE[i];
+    p.sig = r.sigE[i];
+    SetPeakROI(p, cfg);
+
+    p.N   = r.Npk[i];
+    p.mux = r.mux[i];
+    p.muy = r.muy[i];
+    p.A80_2D = {r.A80pix[i], r.A80eq[i], r.A80cov[i]};
+    p.X80_1D = {r.X80pix[i], r.X80eq[i], r.X80cov[i]};
+    p.Y80_1D = {r.Y80pix[i], r.Y80eq[i], r.Y80cov[i]};
+
+    res.Nfix[i] = r.Nfix[i];
+    if (N0 > 0 && r.Nfix[i] >= N0) {
+      res.Afix[i] = {r.A80pix_fixN[i], r.A80eq_fixN[i], r.A80cov_fixN[i]};
+    }
   }
+}
 
-  TFile fin(fn, "READ");
-  if (fin.IsZombie()) {
-    std::printf("run%05d: cannot open, skip\n", run);
-    return false;
+GatedTreeReader::GatedTreeReader(TTree& tr, const A80Config& cfg)
+  : tr_(tr), EgLo_(cfg.EgLo), EgHi_(cfg.EgHi), pixelGain_(cfg.pixelGain.get()) {
+  // branches (only need first hit when multiplicity==1); everything else stays compressed on disk
+  tr_.SetBranchStatus("*", false);
+  for (const char* b : {"DSSDX_mul", "DSSDY_mul", "DSSDX_Ch", "DSSDY_Ch", "DSSDX_E"}) {
+    tr_.SetBranchStatus(b, true);
   }
+  tr_.SetBranchAddress("DSSDX_mul", &mx_);
+  tr_.SetBranchAddress("DSSDY_mul", &my_);
+  tr_.SetBranchAddress("DSSDX_Ch", Xch_);
+  tr_.SetBranchAddress("DSSDY_Ch", Ych_);
+  tr_.SetBranchAddress("DSSDX_E", XE_);
+}
 
-  TTree* tr = static_cast<TTree*>(fin.Get("tr_map"));
-  if (!tr) {
-    std::printf("run%05d: no tr_map, skip\n", run);
-    return false;
-  }
+long long GatedTreeReader::GetEntries() const {
+  return tr_.GetEntries();
+}
 
-  // branches (only need first hit when multiplicity==1)
-  UShort_t mx = 0, my = 0;
-  Double_t Xch[256]{0}, Ych[256]{0};
-  Double_t XE[256]{0};
-  tr->SetBranchAddress("DSSDX_mul", &mx);
-  tr->SetBranchAddress("DSSDY_mul", &my);
-  tr->SetBranchAddress("DSSDX_Ch", Xch);
-  tr->SetBranchAddress("DSSDY_Ch", Ych);
-  tr->SetBranchAddress("DSSDX_E", XE);
+bool GatedTreeReader::Read(long long i, double& E, double& x, double& y) {
+  tr_.GetEntry(i);
+  if (mx_ != 1) return false;
+  if (my_ != 1) return false;
+  x = Xch_[0];
+  y = Ych_[0];
+  E = pixelGain_ ? pixelGain_->Apply(static_cast<int>(x), static_cast<int>(y), XE_[0]) : XE_[0];
+  if (E < EgLo_ || E > EgHi_) return false;
+  return true;
+}
 
-  // Energy spectrum under global gate
-  TH1D hE("hE", TString::Format("run%05d: DSSDX_E (keV);E_{x} (keV);Counts", run),
-          cfg_.nEbins, cfg_.EgLo, cfg_.EgHi);
-
-  const Long64_t nent = tr->GetEntries();
-  for (Long64_t i = 0; i < nent; ++i) {
-    tr->GetEntry(i);
-    if (mx != 1) continue;
-    if (my != 1) continue;
-    const double E = XE[0];
-    if (E < cfg_.EgLo || E > cfg_.EgHi) continue;
-    hE.Fill(E);
-  }
+// XY stage state: pixel counters, fixed-N reservoirs and (for replicas) all ROI pixel indices.
+struct RunAccumulator::XYState {
+  PixelCounts pcAll;
+  std::vector<PixelCounts> pcPk;
 
-  // Fit peaks independently
-  for (int i = 0; i < 3; ++i) {
-    if (FitOnePeakGaus(&hE, P[i], cfg_)) {
-      outRow.nPeaks++;
-      outRow.muE[i] = P[i].mu;
-      outRow.sigE[i] = P[i].sig;
-    }
-  }
-
-  // XY histograms (ROI union + per-peak)
-  TH2D hXY_all("hXY_all", "All peaks (ROI union);DSSDX_Ch;DSSDY_Ch",
-               cfg_.nx, cfg_.xlo, cfg_.xhi, cfg_.ny, cfg_.ylo, cfg_.yhi);
-  TH2D hXY1("hXY1", "Peak1 XY;DSSDX_Ch;DSSDY_Ch", cfg_.nx, cfg_.xlo, cfg_.xhi, cfg_.ny, cfg_.ylo, cfg_.yhi);
-  TH2D hXY2("hXY2", "Peak2 XY;DSSDX_Ch;DSSDY_Ch", cfg_.nx, cfg_.xlo, cfg_.xhi, cfg_.ny, cfg_.ylo, cfg_.yhi);
-  TH2D hXY3("hXY3", "Peak3 XY;DSSDX_Ch;DSSDY_Ch", cfg_.nx, cfg_.xlo, cfg_.xhi, cfg_.ny, cfg_.ylo, cfg_.yhi);
-
-  // Fixed-N (reservoir sampling) containers
-  const int N0 = (cfg_.enableFixedN ? cfg_.peakFixedN : 0);
+  int N0 = 0;
   std::vector<int> resIdx[3];
   long long seen[3] = {0, 0, 0};
   std::mt19937_64 rng[3];
-  if (N0 > 0) {
-    for (int k = 0; k < 3; ++k) {
-      resIdx[k].reserve(static_cast<size_t>(N0));
-      const uint64_t seed = Mix64(cfg_.fixedNSeedBase) ^ Mix64(static_cast<uint64_t>(run) + 1000ULL * (k + 1));
-      rng[k].seed(seed);
+  uint64_t fixSeed[3] = {0, 0, 0};
+
+  int nRep = 0;
+  std::vector<int> roiIdx[3];
+
+  XYState(const A80Config& cfg, int run)
+    : pcAll(cfg.nx, cfg.xlo, cfg.xhi, cfg.ny, cfg.ylo, cfg.yhi), pcPk(3, pcAll) {
+    N0 = (cfg.enableFixedN ? cfg.peakFixedN : 0);
+    if (N0 > 0) {
+      for (int k = 0; k < 3; ++k) {
+        resIdx[k].reserve(static_cast<size_t>(N0));
+        fixSeed[k] = Mix64(cfg.fixedNSeedBase) ^ Mix64(static_cast<uint64_t>(run) + 1000ULL * (k + 1));
+        rng[k].seed(fixSeed[k]);
+      }
     }
+    // Fixed-N replicas 1..R-1 resample all ROI pixel indices of the peak in Finish()
+    nRep = (N0 > 0 ? std::max(1, cfg.fixedNReplicas) : 0);
   }
 
-  auto reservoir_update = [&](int k, int idx) {
+  void reservoir_update(int k, int idx) {
     // k: 0..2
     if (N0 <= 0) return;
     ++seen[k];
@@ -134,59 +144,159 @@ bool RunProcessor::ProcessRun(const std::string& indir, int run, TFile& fqa, con
     if (j < static_cast<uint64_t>(N0)) {
       v[static_cast<size_t>(j)] = idx;
     }
-  };
+  }
+};
 
-  for (Long64_t i = 0; i < nent; ++i) {
-    tr->GetEntry(i);
-    if (mx != 1) continue;
-    if (my != 1) continue;
-    const double E = XE[0];
-    if (E < cfg_.EgLo || E > cfg_.EgHi) continue;
+RunAccumulator::RunAccumulator(const A80Config& cfg, int run) : cfg_(cfg), run_(run) {
+  res_.row.reset(run_);
+  for (int i = 0; i < 3; ++i) ResetPeak(res_.P[i], cfg_.Ptpl[i]);
 
-    int pid = 0;
-    for (int k = 0; k < 3; ++k) {
-      if (P[k].ok && E >= P[k].roi_lo && E <= P[k].roi_hi) { pid = k + 1; break; }
+  // Energy spectrum under global gate
+  // (all result histograms are detached right away so they outlive the input file and stay thread-local)
+  res_.hE = std::make_unique<TH1D>("hE", TString::Format("run%05d: DSSDX_E (keV);E_{x} (keV);Counts", run_),
+                                   cfg_.nEbins, cfg_.EgLo, cfg_.EgHi);
+  res_.hE->SetDirectory(nullptr);
+
+  ResetXY();
+}
+
+RunAccumulator::~RunAccumulator() = default;
+
+void RunAccumulator::FillSpectrum(double E) {
+  res_.hE->Fill(E);
+}
+
+bool RunAccumulator::FitPeaks(double roiTolerance_keV) {
+  // Fit peaks independently
+  // (native fitter, no TMinuit global state: runs on worker threads without a lock)
+  PeakWin fit[3];
+  for (int i = 0; i < 3; ++i) {
+    ResetPeak(fit[i], cfg_.Ptpl[i]);
+    FitOnePeakGaus(res_.hE.get(), fit[i], cfg_);
+  }
+
+  if (roiTolerance_keV >= 0.0) {
+    bool moved = false;
+    for (int i = 0; i < 3; ++i) {
+      const PeakWin& p = res_.P[i];
+      if (fit[i].ok != p.ok) moved = true;
+      else if (p.ok && (std::fabs(fit[i].roi_lo - p.roi_lo) > roiTolerance_keV ||
+                        std::fabs(fit[i].roi_hi - p.roi_hi) > roiTolerance_keV)) moved = true;
     }
-    if (pid == 0) continue;
+    if (!moved) return false;
+  }
+
+  SummaryRow& outRow = res_.row;
+  outRow.reset(run_);
+  for (int i = 0; i < 3; ++i) {
+    res_.P[i] = fit[i];
+    if (fit[i].ok) {
+      outRow.nPeaks++;
+      outRow.muE[i] = fit[i].mu;
+      outRow.sigE[i] = fit[i].sig;
+    }
+  }
+  ResetXY();
+  return true;
+}
 
-    const double x = Xch[0];
-    const double y = Ych[0];
+void RunAccumulator::ResetXY() {
+  // XY histograms (ROI union + per-peak)
+  res_.hXY_all = std::make_unique<TH2D>("hXY_all", "All peaks (ROI union);DSSDX_Ch;DSSDY_Ch",
+                                       cfg_.nx, cfg_.xlo, cfg_.xhi, cfg_.ny, cfg_.ylo, cfg_.yhi);
+  for (int k = 0; k < 3; ++k) {
+    res_.hXY[k] = std::make_unique<TH2D>(TString::Format("hXY%d", k + 1), TString::Format("Peak%d XY;DSSDX_Ch;DSSDY_Ch", k + 1),
+                                         cfg_.nx, cfg_.xlo, cfg_.xhi, cfg_.ny, cfg_.ylo, cfg_.yhi);
+  }
+  for (TH2D* hh : {res_.hXY_all.get(), res_.hXY[0].get(), res_.hXY[1].get(), res_.hXY[2].get()}) {
+    hh->SetDirectory(nullptr);
+  }
 
-    hXY_all.Fill(x, y);
-    if (pid == 1) hXY1.Fill(x, y);
-    if (pid == 2) hXY2.Fill(x, y);
-    if (pid == 3) hXY3.Fill(x, y);
+  // Flat pixel counters on the same binning; A80/X80/Y80 come from these (bit-identical to
+  // reading the TH2D bins back), the histograms are kept for the QA file.
+  xy_ = std::make_unique<XYState>(cfg_, run_);
 
-    // Fixed-N sampling: store pixel bin index (0-based)
-    if (N0 > 0) {
-      const int ix = static_cast<int>(std::llround(x));
-      const int iy = static_cast<int>(std::llround(y));
-      if (ix >= 0 && ix < cfg_.nx && iy >= 0 && iy < cfg_.ny) {
-        const int idx = iy * cfg_.nx + ix;
-        reservoir_update(pid - 1, idx);
-      }
+  for (int k = 0; k < 3; ++k) {
+    res_.Afix[k] = {};
+    res_.Nfix[k] = 0;
+  }
+}
+
+void RunAccumulator::FillXY(double E, double x, double y) {
+  const PeakWin* P = res_.P;
+  int pid = 0;
+  for (int k = 0; k < 3; ++k) {
+    if (P[k].ok && E >= P[k].roi_lo && E <= P[k].roi_hi) { pid = k + 1; break; }
+  }
+  if (pid == 0) return;
+
+  XYState& s = *xy_;
+  res_.hXY_all->Fill(x, y);
+  res_.hXY[pid - 1]->Fill(x, y);
+  s.pcAll.Fill(x, y);
+  s.pcPk[pid - 1].Fill(x, y);
+
+  // Fixed-N sampling: store pixel bin index (0-based)
+  if (s.N0 > 0) {
+    const int ix = static_cast<int>(std::llround(x));
+    const int iy = static_cast<int>(std::llround(y));
+    if (ix >= 0 && ix < cfg_.nx && iy >= 0 && iy < cfg_.ny) {
+      const int idx = iy * cfg_.nx + ix;
+      s.reservoir_update(pid - 1, idx);
+      if (s.nRep > 1) s.roiIdx[pid - 1].push_back(idx);
     }
   }
+}
+
+void RunAccumulator::Finish() {
+  RunResult& res = res_;
+  SummaryRow& outRow = res.row;
+  PeakWin* P = res.P;
+  const XYState& s = *xy_;
+  const A80Config& cfg = cfg_;
+  const int N0 = s.N0;
+  TH2D& hXY_all = *res.hXY_all;
 
   // Projections (IMPORTANT: keep ownership to avoid leaks)
-  auto hX_all = std::unique_ptr<TH1D>(hXY_all.ProjectionX("hX_all"));
-  auto hY_all = std::unique_ptr<TH1D>(hXY_all.ProjectionY("hY_all"));
-  auto hX1    = std::unique_ptr<TH1D>(hXY1.ProjectionX("hX1"));
-  auto hY1    = std::unique_ptr<TH1D>(hXY1.ProjectionY("hY1"));
-  auto hX2    = std::unique_ptr<TH1D>(hXY2.ProjectionX("hX2"));
-  auto hY2    = std::unique_ptr<TH1D>(hXY2.ProjectionY("hY2"));
-  auto hX3    = std::unique_ptr<TH1D>(hXY3.ProjectionX("hX3"));
-  auto hY3    = std::unique_ptr<TH1D>(hXY3.ProjectionY("hY3"));
+  res.hX_all.reset(hXY_all.ProjectionX("hX_all"));
+  res.hY_all.reset(hXY_all.ProjectionY("hY_all"));
+  for (int k = 0; k < 3; ++k) {
+    res.hX[k].reset(res.hXY[k]->ProjectionX(TString::Format("hX%d", k + 1)));
+    res.hY[k].reset(res.hXY[k]->ProjectionY(TString::Format("hY%d", k + 1)));
+  }
 
   // Detach from any directory to keep lifetime controlled here
-  for (auto* hh : {hX_all.get(), hY_all.get(), hX1.get(), hY1.get(), hX2.get(), hY2.get(), hX3.get(), hY3.get()}) {
+  for (TH1D* hh : {res.hX_all.get(), res.hY_all.get(), res.hX[0].get(), res.hY[0].get(),
+                   res.hX[1].get(), res.hY[1].get(), res.hX[2].get(), res.hY[2].get()}) {
     if (hh) hh->SetDirectory(nullptr);
   }
 
+  // Coverage fractions: [0] = targetFrac, [1..nCurve] = curve points, all from one walk per map
+  const int nCurve = std::min<int>(static_cast<int>(cfg.curveFracs.size()), SummaryRow::kMaxCurve);
+  std::vector<double> fracs(1, cfg.targetFrac);
+  fracs.insert(fracs.end(), cfg.curveFracs.begin(), cfg.curveFracs.begin() + nCurve);
+  outRow.nCurve = nCurve;
+  for (int j = 0; j < nCurve; ++j) outRow.curveFrac[j] = fracs[j + 1];
+
+  auto storeCurve = [&](const std::vector<AeqResult>& c, double* dst) {
+    for (int j = 0; j < nCurve; ++j) dst[j] = c[j + 1].n_eq;
+  };
+
   // A80 / X80 / Y80 (union)
-  const AeqResult Aall = CalcAeq2D(&hXY_all, cfg_.targetFrac);
-  const AeqResult Xall = CalcAeq1D(hX_all.get(), cfg_.targetFrac);
-  const AeqResult Yall = CalcAeq1D(hY_all.get(), cfg_.targetFrac);
+  {
+    const std::vector<AeqResult> a = s.pcAll.Aeq2DCurve(fracs);
+    const std::vector<AeqResult> x = s.pcAll.AeqXCurve(fracs);
+    const std::vector<AeqResult> y = s.pcAll.AeqYCurve(fracs);
+    res.Aall = a[0];
+    res.Xall = x[0];
+    res.Yall = y[0];
+    storeCurve(a, outRow.Aeq_curve_all);
+    storeCurve(x, outRow.Xeq_curve_all);
+    storeCurve(y, outRow.Yeq_curve_all);
+  }
+  const AeqResult& Aall = res.Aall;
+  const AeqResult& Xall = res.Xall;
+  const AeqResult& Yall = res.Yall;
 
   outRow.N_all = static_cast<long long>(hXY_all.GetEntries());
 
@@ -203,22 +313,38 @@ bool RunProcessor::ProcessRun(const std::string& indir, int run, TFile& fqa, con
   outRow.Y80_cov_all = Yall.cov_at_npix;
 
   // per-peak
-  TH2D* hp2[3] = {&hXY1, &hXY2, &hXY3};
-  TH1D* hpX[3] = {hX1.get(), hX2.get(), hX3.get()};
-  TH1D* hpY[3] = {hY1.get(), hY2.get(), hY3.get()};
+  TH2D* hp2[3] = {res.hXY[0].get(), res.hXY[1].get(), res.hXY[2].get()};
 
   // Fixed-N results (per peak)
-  AeqResult Afix[3];
-  long long Nfix[3] = {0, 0, 0};
+  AeqResult* Afix = res.Afix;
+  long long* Nfix = res.Nfix;
   if (N0 > 0) {
     for (int k = 0; k < 3; ++k) {
-      if ((int)resIdx[k].size() == N0) {
-        Afix[k] = CalcAeq2DFromSampledBins(resIdx[k], cfg_.nx, cfg_.ny, cfg_.targetFrac);
+      if ((int)s.resIdx[k].size() == N0) {
+        const std::vector<AeqResult> c = CalcAeq2DCurveFromSampledBins(s.resIdx[k], cfg.nx, cfg.ny, fracs);
+        Afix[k] = c[0];
         Nfix[k] = N0;
+        storeCurve(c, outRow.Aeq_curve_fixN[k]);
       }
     }
   }
 
+  ReplicaStats fixStats[3];
+  if (s.nRep > 1) {
+    for (int k = 0; k < 3; ++k) {
+      if (Nfix[k] != N0) continue;
+      const std::vector<AeqResult> reps =
+        CalcAeq2DSubsampleReplicas(s.roiIdx[k], N0, s.nRep - 1, s.fixSeed[k], cfg.nx, cfg.ny,
+                                   cfg.targetFrac, cfg.fixedNReplicaThreads);
+      std::vector<double> aeq;
+      aeq.reserve(reps.size() + 1);
+      aeq.push_back(Afix[k].n_eq);
+      for (const AeqResult& a : reps) aeq.push_back(a.n_eq);
+      fixStats[k] = SummarizeReplicas(std::move(aeq), cfg.fixedNIntervalCL);
+    }
+    outRow.nRepFix = s.nRep;
+  }
+
   for (int i = 0; i < 3; ++i) {
     if (!P[i].ok) continue;
 
@@ -226,9 +352,11 @@ bool RunProcessor::ProcessRun(const std::string& indir, int run, TFile& fqa, con
     P[i].mux = hp2[i]->GetMean(1);
     P[i].muy = hp2[i]->GetMean(2);
 
-    P[i].A80_2D = CalcAeq2D(hp2[i], cfg_.targetFrac);
-    P[i].X80_1D = CalcAeq1D(hpX[i], cfg_.targetFrac);
-    P[i].Y80_1D = CalcAeq1D(hpY[i], cfg_.targetFrac);
+    const std::vector<AeqResult> a = s.pcPk[i].Aeq2DCurve(fracs);
+    P[i].A80_2D = a[0];
+    storeCurve(a, outRow.Aeq_curve[i]);
+    P[i].X80_1D = s.pcPk[i].AeqX(cfg.targetFrac);
+    P[i].Y80_1D = s.pcPk[i].AeqY(cfg.targetFrac);
 
     outRow.Npk[i] = P[i].N;
     outRow.mux[i] = P[i].mux;
@@ -244,105 +372,133 @@ bool RunProcessor::ProcessRun(const std::string& indir, int run, TFile& fqa, con
       outRow.A80eq_fixN[i]  = Afix[i].n_eq;
       outRow.A80pix_fixN[i] = Afix[i].n_pix;
       outRow.A80cov_fixN[i] = Afix[i].cov_at_npix;
+
+      outRow.A80eq_fixN_mean[i] = fixStats[i].mean;
+      outRow.A80eq_fixN_std[i]  = fixStats[i].std;
+      outRow.A80eq_fixN_lo[i]   = fixStats[i].lo;
+      outRow.A80eq_fixN_hi[i]   = fixStats[i].hi;
     } else {
       outRow.A80eq_fixN[i]  = -999.0;
       outRow.A80pix_fixN[i] = 0;
       outRow.A80cov_fixN[i] = 0.0;
     }
   }
+}
 
-  // ----- PDF output -----
-  EnsureDir(pdfDir);
-  const TString pdf = TString::Format("%s/run%05d_QA_A80.pdf", pdfDir.c_str(), run);
+// Everything after the input: spectrum, peak fits, XY maps, metrics and the summary row.
+// forEachGated(fn) must call fn(E, x, y) for every event passing the global gate, and may be
+// called several times (it is either a loop over a buffer or a re-read of tr_map).
+template <class ForEachGated>
+static void AnalyzeGated(const A80Config& cfg, int run, ForEachGated&& forEachGated, RunResult& res) {
+  RunAccumulator acc(cfg, run);
+  forEachGated([&](double E, double, double) { acc.FillSpectrum(E); });
+  acc.FitPeaks();
+  forEachGated([&](double E, double x, double y) { acc.FillXY(E, x, y); });
+  acc.Finish();
+  res = acc.TakeResult();
+}
 
-  TString roiDesc;
-  if (cfg_.roiMode == A80Config::ROIMode::kFixed) {
-    roiDesc = TString::Format("fixed: mu#pm%.0f keV", cfg_.roiHalfWidth_keV);
-  } else {
-    roiDesc = TString::Format("sigma: mu#pm%.1f#sigma", cfg_.roiSigmaMult);
-  }
+bool RunProcessor::ProcessRun(const std::string& indir, int run, TFile& fqa, SummaryRow& outRow) const {
+  RunResult res;
+  const bool ok = AnalyzeRun(indir, run, res);
+  outRow = res.row;
+  if (!ok) return false;
 
-  TCanvas cEnergy("cEnergy", "cEnergy", 1100, 850);
-  TCanvas cAll("cAll", "cAll", 1100, 850);
-  TCanvas cP1("cP1", "cP1", 1100, 850);
-  TCanvas cP2("cP2", "cP2", 1100, 850);
-  TCanvas cP3("cP3", "cP3", 1100, 850);
+  WriteRun(res, fqa);
+  return true;
+}
 
-  TLatex tx; tx.SetNDC(true);
-  cEnergy.Print((pdf + "[").Data());
+bool RunProcessor::AnalyzeRun(const std::string& indir, int run, RunResult& res) const {
+  SummaryRow& outRow = res.row;
+  outRow.reset(run);
 
-  // Page 1: energy + windows/ROIs
-  cEnergy.Clear();
-  hE.Draw();
+  PeakWin* P = res.P;
+  for (int i = 0; i < 3; ++i) ResetPeak(P[i], cfg_.Ptpl[i]);
 
-  TLine l; l.SetLineStyle(2);
-  const double ymax = hE.GetMaximum();
-  for (int i = 0; i < 3; ++i) {
-    l.DrawLine(P[i].win_lo, 0, P[i].win_lo, ymax * 0.55);
-    l.DrawLine(P[i].win_hi, 0, P[i].win_hi, ymax * 0.55);
-    if (P[i].ok) {
-      l.SetLineStyle(1);
-      l.DrawLine(P[i].roi_lo, 0, P[i].roi_lo, ymax * 0.85);
-      l.DrawLine(P[i].roi_hi, 0, P[i].roi_hi, ymax * 0.85);
-      l.SetLineStyle(2);
-    }
+  const TString fn = TString::Format("%s/run%05d_map.root", indir.c_str(), run);
+  if (gSystem->AccessPathName(fn)) {
+    return false; // missing file
   }
 
-  tx.SetTextSize(0.035);
-  tx.DrawLatex(0.12, 0.92, TString::Format("Cuts: DSSDX_mul==1 && DSSDY_mul==1 && DSSDX_E in [%.0f,%.0f] keV", cfg_.EgLo, cfg_.EgHi));
-  tx.DrawLatex(0.12, 0.88, TString::Format("ROI mode: %s", roiDesc.Data()));
-  tx.DrawLatex(0.12, 0.84, TString::Format("Fit: W=%.0f keV, refit=%.1f#sigma, minPeakMaxCount=%.0f",
-                                            cfg_.fitWindow_keV, cfg_.refitSigmaMult, cfg_.minPeakMaxCount));
-  if (N0 > 0) {
-    tx.DrawLatex(0.12, 0.80, TString::Format("Fixed-N A80: enabled, N0=%d (compute only if Npk>=N0)", N0));
-  } else {
-    tx.DrawLatex(0.12, 0.80, "Fixed-N A80: disabled");
+  if (cache_ && cache_->Load(fn.Data(), run, res)) {
+    return true;
   }
 
-  for (int i = 0; i < 3; ++i) {
-    const TString s = P[i].ok
-      ? TString::Format("Peak%d: mu=%.1f keV, sigma=%.1f keV, ROI=[%.0f,%.0f]",
-                        i + 1, P[i].mu, P[i].sig, P[i].roi_lo, P[i].roi_hi)
-      : TString::Format("Peak%d: NOT FOUND", i + 1);
-    tx.DrawLatex(0.12, 0.74 - 0.04 * i, s);
+  TFile fin(fn, "READ");
+  if (fin.IsZombie()) {
+    std::printf("run%05d: cannot open, skip\n", run);
+    return false;
+  }
+
+  TTree* tr = static_cast<TTree*>(fin.Get("tr_map"));
+  if (!tr) {
+    std::printf("run%05d: no tr_map, skip\n", run);
+    return false;
+  }
+
+  GatedTreeReader reader(*tr, cfg_);
+  const long long nent = reader.GetEntries();
+
+  // One pass over tr_map under the global gate; fn(E, x, y) gets the first hit of each gated event.
+  auto readGated = [&](auto&& fn) {
+    double E = 0.0, x = 0.0, y = 0.0;
+    for (long long i = 0; i < nent; ++i) {
+      if (reader.Read(i, E, x, y)) fn(E, x, y);
+    }
+  };
+
+  // Single-pass mode: decompress tr_map once into the gated (E, x, y) buffer.
+  GatedEvents ev;
+  if (cfg_.singlePass) {
+    readGated([&](double E, double x, double y) { ev.push_back(E, x, y); });
   }
-  cEnergy.Print(pdf.Data());
 
-  // Page 2: all peaks union
-  DrawXYPage(cAll, tx, hXY_all, *hX_all, *hY_all, "All peaks (ROI union) XY",
-             nullptr, Aall, Xall, Yall, roiDesc.Data());
-  cAll.Print(pdf.Data());
+  // Visit every gated event: from the buffer in single-pass mode, otherwise by re-reading the tree.
+  auto forEachGated = [&](auto&& fn) {
+    if (!cfg_.singlePass) {
+      readGated(fn);
+      return;
+    }
+    for (size_t i = 0; i < ev.size(); ++i) fn(ev.E[i], ev.x[i], ev.y[i]);
+  };
 
-  // Page 3-5: each peak (pass Fixed-N metrics)
-  DrawXYPage(cP1, tx, hXY1, *hX1, *hY1, "Peak1 XY (ROI)",
-             &P[0], Aall, Xall, Yall, roiDesc.Data(), (N0>0? &Afix[0]:nullptr), Nfix[0], N0);
-  cP1.Print(pdf.Data());
+  AnalyzeGated(cfg_, run, forEachGated, res);
 
-  DrawXYPage(cP2, tx, hXY2, *hX2, *hY2, "Peak2 XY (ROI)",
-             &P[1], Aall, Xall, Yall, roiDesc.Data(), (N0>0? &Afix[1]:nullptr), Nfix[1], N0);
-  cP2.Print(pdf.Data());
+  if (cache_) cache_->Store(fn.Data(), res);
+  return true;
+}
 
-  DrawXYPage(cP3, tx, hXY3, *hX3, *hY3, "Peak3 XY (ROI)",
-             &P[2], Aall, Xall, Yall, roiDesc.Data(), (N0>0? &Afix[2]:nullptr), Nfix[2], N0);
-  cP3.Print(pdf.Data());
+bool RunProcessor::AnalyzeEvents(int run, const double* E, const double* x, const double* y, size_t n,
+                                 RunResult& res) const {
+  // same global energy gate as readGated in AnalyzeRun (multiplicity is the caller's business)
+  auto forEachGated = [&](auto&& fn) {
+    for (size_t i = 0; i < n; ++i) {
+      if (E[i] < cfg_.EgLo || E[i] > cfg_.EgHi) continue;
+      fn(E[i], x[i], y[i]);
+    }
+  };
 
-  cEnergy.Print((pdf + "]").Data());
+  AnalyzeGated(cfg_, run, forEachGated, res);
+  return res.hE->GetEntries() > 0;
+}
+
+void RunProcessor::WriteRun(RunResult& res, TFile& fqa) const {
+  const SummaryRow& outRow = res.row;
+  const int run = outRow.run;
 
-  // write QA objects
+  // write QA objects (PDF pages are rendered afterwards from this file, see QaRender.h)
   fqa.cd();
   WriteRunObjects(
-    fqa, run, hE,
-    hXY_all, hXY1, hXY2, hXY3,
-    *hX_all, *hY_all,
-    *hX1, *hY1,
-    *hX2, *hY2,
-    *hX3, *hY3,
-    &cEnergy, &cAll, &cP1, &cP2, &cP3
+    fqa, run, *res.hE,
+    *res.hXY_all, *res.hXY[0], *res.hXY[1], *res.hXY[2],
+    *res.hX_all, *res.hY_all,
+    *res.hX[0], *res.hY[0],
+    *res.hX[1], *res.hY[1],
+    *res.hX[2], *res.hY[2]
   );
 
   // progress print
-  std::printf("DONE run%05d: nPeaks=%d N_all=%lld A80_eq=%.3f X80_eq=%.3f Y80_eq=%.3f\n",
-              run, outRow.nPeaks, outRow.N_all, outRow.A80_eq_all, outRow.X80_eq_all, outRow.Y80_eq_all);
+  std::printf("DONE run%05d%s: nPeaks=%d N_all=%lld A80_eq=%.3f X80_eq=%.3f Y80_eq=%.3f\n",
+              run, res.fromCache ? " (cached)" : "", outRow.nPeaks, outRow.N_all, outRow.A80_eq_all, outRow.X80_eq_all, outRow.Y80_eq_all);
   std::fflush(stdout);
-  return true;
 }
@@ -1,21 +1,133 @@
 #pragma once
 #include "Config.h"
+#include <cstddef>
+#include <memory>
 #include <string>
 
 class TFile;
+class TH1D;
+class TH2D;
+class TTree;
+
+// Everything computed for one run: summary row, peak fits, metrics and the QA histograms.
+// Histograms are detached from any TDirectory, so a result can be handed from a worker
+// thread to the writer thread.
+struct RunResult {
+  SummaryRow row;
+
+  PeakWin P[3];
+  AeqResult Aall, Xall, Yall;
+
+  // Fixed-N (per peak); Nfix[k]==0 means not computed
+  AeqResult Afix[3];
+  long long Nfix[3] = {0, 0, 0};
+
+  std::unique_ptr<TH1D> hE;
+  std::unique_ptr<TH2D> hXY_all;
+  std::unique_ptr<TH2D> hXY[3];
+  std::unique_ptr<TH1D> hX_all, hY_all;
+  std::unique_ptr<TH1D> hX[3], hY[3];
+
+  bool fromCache = false; // restored by RunCache instead of analyzed
+
+  RunResult();
+  ~RunResult();
+  RunResult(RunResult&&) noexcept;
+  RunResult& operator=(RunResult&&) noexcept;
+};
+
+class RunCache;
+
+// tr_map reader for the global gate (DSSDX_mul==1 && DSSDY_mul==1 && EgLo<=DSSDX_E<=EgHi).
+// Enables only the five branches it needs; the tree must outlive the reader.
+class GatedTreeReader {
+public:
+  GatedTreeReader(TTree& tr, const A80Config& cfg);
+
+  long long GetEntries() const;
+
+  // Reads entry i; true if it passes the gate (E, x, y = first hit; E pixel-corrected if cfg.pixelGain).
+  bool Read(long long i, double& E, double& x, double& y);
+
+private:
+  TTree& tr_;
+  double EgLo_, EgHi_;
+  unsigned short mx_ = 0, my_ = 0; // UShort_t
+  double Xch_[256]{0}, Ych_[256]{0};
+  double XE_[256]{0};
+  const PixelGainMap* pixelGain_ = nullptr; // A80Config::pixelGain
+};
+
+// The per-run analysis in incremental form (AnalyzeRun/AnalyzeEvents, and RunFollower for live runs):
+//   FillSpectrum(E)...  ->  FitPeaks()  ->  FillXY(E, x, y)...  ->  Finish()
+// Fills may continue after Finish(), which can be called again for an updated result.
+// FitPeaks() restarts the XY stage (maps, reservoirs), so the caller re-feeds FillXY afterwards.
+class RunAccumulator {
+public:
+  RunAccumulator(const A80Config& cfg, int run);
+  ~RunAccumulator();
+
+  void FillSpectrum(double E);
+
+  // Fits the three peaks on the current spectrum. With roiTolerance_keV >= 0 the new fit is
+  // only adopted if a peak appeared/vanished or an ROI edge moved by more than that; returns
+  // true if it was adopted (XY stage restarted).
+  bool FitPeaks(double roiTolerance_keV = -1.0);
+
+  void FillXY(double E, double x, double y);
+
+  // Projections, metrics and the summary row from the XY stage so far.
+  void Finish();
+
+  const RunResult& result() const { return res_; }
+  RunResult TakeResult() { return std::move(res_); }
+
+private:
+  struct XYState;
+
+  void ResetXY();
+
+  A80Config cfg_;
+  int run_;
+  RunResult res_;
+  std::unique_ptr<XYState> xy_;
+};
+
+// Rebuild res.P / Aall / Xall / Yall / Afix / Nfix from res.row (e.g. for a cached run).
+void RestoreResultFromRow(RunResult& res, const A80Config& cfg);
 
 // Per-run processing: open input ROOT, fill histos under gates, fit peaks, compute A80/X80/Y80,
-// write per-run QA objects into fqa, and produce per-run multi-page PDF.
+// and write per-run QA objects into fqa. Per-run PDFs are a separate post-pass (QaRender.h).
 class RunProcessor {
 public:
   using Config = A80Config;
 
   explicit RunProcessor(Config cfg = Config());
 
+  const Config& config() const { return cfg_; }
+
+  // Optional result cache (not owned). AnalyzeRun reuses valid entries and stores new ones.
+  void SetCache(const RunCache* cache) { cache_ = cache; }
+
   // Returns true if the run was processed (input file existed and contained tr_map).
   // Returns false if skipped (missing file, open failure, missing tree).
-  bool ProcessRun(const std::string& indir, int run, TFile& fqa, const std::string& pdfDir, SummaryRow& outRow) const;
+  bool ProcessRun(const std::string& indir, int run, TFile& fqa, SummaryRow& outRow) const;
+
+  // Numerical part of ProcessRun (read, fit, metrics). Touches no shared output,
+  // so it may run concurrently on several threads (after ROOT::EnableThreadSafety()).
+  bool AnalyzeRun(const std::string& indir, int run, RunResult& res) const;
+
+  // Same analysis on events already in memory (no ROOT file, no cache): E[i], x[i], y[i] are
+  // the first hit of event i with DSSDX_mul==1 && DSSDY_mul==1; the EgLo/EgHi gate is applied here.
+  // Returns false if no event passes the gate (res.row is still filled, with nPeaks==0).
+  bool AnalyzeEvents(int run, const double* E, const double* x, const double* y, size_t n,
+                     RunResult& res) const;
+
+  // Output part of ProcessRun: QA objects into fqa. Not thread-safe (TFile writes);
+  // call from a single writer thread.
+  void WriteRun(RunResult& res, TFile& fqa) const;
 
 private:
   Config cfg_;
+  const RunCache* cache_ = nullptr;
 };
@@ -0,0 +1,76 @@
+#include "RunScheduler.h"
+
+#include "RunProcessor.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int ProcessRunsParallel(const RunProcessor& proc, const std::string& indir,
+                        int runFirst, int runLast, int nThreads,
+                        const std::function<void(RunResult&)>& write) {
+  const int nRuns = runLast - runFirst + 1;
+  if (nRuns <= 0) return 0;
+  nThreads = std::max(1, std::min(nThreads, nRuns));
+
+  // Workers may run at most maxAhead runs ahead of the writer, which bounds the number of
+  // finished results (histograms) waiting in memory while the writer prints PDFs.
+  const int maxAhead = 4 * nThreads;
+
+  std::mutex mtx;
+  std::condition_variable cvDone;   // worker -> writer: a result was added
+  std::condition_variable cvSpace;  // writer -> workers: the writer moved on
+  int nextRun = runFirst;           // next run to hand out
+  int writerRun = runFirst;         // run the writer is waiting for
+  std::map<int, std::unique_ptr<RunResult>> done; // nullptr: run skipped
+
+  auto worker = [&]() {
+    for (;;) {
+      int run = 0;
+      {
+        std::unique_lock<std::mutex> lk(mtx);
+        cvSpace.wait(lk, [&] { return nextRun > runLast || nextRun < writerRun + maxAhead; });
+        if (nextRun > runLast) return;
+        run = nextRun++;
+      }
+
+      auto res = std::make_unique<RunResult>();
+      if (!proc.AnalyzeRun(indir, run, *res)) res.reset();
+
+      {
+        std::lock_guard<std::mutex> lk(mtx);
+        done.emplace(run, std::move(res));
+      }
+      cvDone.notify_one();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(static_cast<size_t>(nThreads));
+  for (int i = 0; i < nThreads; ++i) pool.emplace_back(worker);
+
+  int nProcessed = 0;
+  for (int run = runFirst; run <= runLast; ++run) {
+    std::unique_ptr<RunResult> res;
+    {
+      std::unique_lock<std::mutex> lk(mtx);
+      cvDone.wait(lk, [&] { return done.count(run) > 0; });
+      auto it = done.find(run);
+      res = std::move(it->second);
+      done.erase(it);
+      writerRun = run + 1;
+    }
+    cvSpace.notify_all();
+
+    if (!res) continue;
+    write(*res);
+    ++nProcessed;
+  }
+
+  for (auto& t : pool) t.join();
+  return nProcessed;
+}
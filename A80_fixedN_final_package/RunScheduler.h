@@ -0,0 +1,16 @@
+#pragma once
+#include <functional>
+#include <string>
+
+class RunProcessor;
+struct RunResult;
+
+// In-process replacement for mulicore_run.sh.
+// nThreads workers pull the next run number from one shared queue, so a 10x larger run
+// only delays the worker that took it (no static chunks, no hadd merge afterwards).
+// write(res) is called on the calling thread only, once per processed run and in ascending
+// run order; it is the single writer that owns the summary TTree and the QA TFile.
+// Returns the number of processed (not skipped) runs.
+int ProcessRunsParallel(const RunProcessor& proc, const std::string& indir,
+                        int runFirst, int runLast, int nThreads,
+                        const std::function<void(RunResult&)>& write);
@@ -3,71 +3,104 @@
 //   g++ -O2 -std=c++17 src/*.cpp -Iinclude $(root-config --cflags --libs) -o process_runs_A80
 //
 // Run:
-//   ./process_runs_A80 <indir> <runFirst> <runLast> <outSummary.root> <outQA.root> <pdfDir>
+//   ./process_runs_A80 <indir> <runFirst> <runLast> <outSummary.root> <outQA.root> <pdfDir> [options]
+//
+//   --threads N : analyze runs on N worker threads (shared run queue); this thread stays the
+//                 only writer of the summary/QA files, so no hadd merge is needed.
+//                 With N > 1 the fixed-N replicas of each peak run on their run's worker
+//                 (A80Config::fixedNReplicaThreads is forced to 1), so at most N threads compute.
+//   --cache DIR : keep per-run results in DIR; a rerun only analyzes new/changed input files
+//                 (or all of them after an A80Config change) and re-emits the full summary.
+//   --render M  : per-run PDFs after processing, M = none | failed | all (default: A80Config::renderMode).
+//                 PDFs are drawn in a post-pass from the finished summary/QA files.
+//   --fixn-replicas R : fixed-N A80 with R replicas per peak -> A80eq_fixN_mean/std/lo/hi
+//                 (default: A80Config::fixedNReplicas).
+//   --curve F1,F2,... : coverage fractions for the A(f) arrays in the summary
+//                 (default: A80Config::curveFracs; "" = none).
+//   --render-only : skip processing; only render PDFs from existing <outSummary.root>/<outQA.root>.
+//   --pixel-gain FILE : per-pixel gain map (DSSD_recal_all pixel_gain_map.dat) applied to DSSDX_E
+//                 while reading, before the energy gate (A80Config::pixelGain).
 
 #include "RunProcessor.h"
+#include "RunScheduler.h"
+#include "RunCache.h"
+#include "QaRender.h"
 #include "QaIO.h"
 #include "A80Types.h"
+#include "PixelGainMap.h"
 
 #include <TFile.h>
 #include <TTree.h>
 #include <TStyle.h>
+#include <TROOT.h>
+#include <TH1.h>
 
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
+#include <set>
 #include <string>
 
-static void BindSummaryBranches(TTree& t, SummaryRow& r) {
-  t.Branch("runnum", &r.run, "runnum/I");
-  t.Branch("nPeaks", &r.nPeaks, "nPeaks/I");
-
-  t.Branch("N_all", &r.N_all, "N_all/L");
-
-  t.Branch("A80_eq_all", &r.A80_eq_all, "A80_eq_all/D");
-  t.Branch("A80_pix_all", &r.A80_pix_all, "A80_pix_all/L");
-  t.Branch("A80_cov_all", &r.A80_cov_all, "A80_cov_all/D");
-
-  t.Branch("X80_eq_all", &r.X80_eq_all, "X80_eq_all/D");
-  t.Branch("X80_pix_all", &r.X80_pix_all, "X80_pix_all/L");
-  t.Branch("X80_cov_all", &r.X80_cov_all, "X80_cov_all/D");
-
-  t.Branch("Y80_eq_all", &r.Y80_eq_all, "Y80_eq_all/D");
-  t.Branch("Y80_pix_all", &r.Y80_pix_all, "Y80_pix_all/L");
-  t.Branch("Y80_cov_all", &r.Y80_cov_all, "Y80_cov_all/D");
-
-  t.Branch("muE", r.muE, "muE[3]/D");
-  t.Branch("sigE", r.sigE, "sigE[3]/D");
-
-  t.Branch("Npk", r.Npk, "Npk[3]/L");
-  t.Branch("mux", r.mux, "mux[3]/D");
-  t.Branch("muy", r.muy, "muy[3]/D");
-
-  t.Branch("A80eq", r.A80eq, "A80eq[3]/D");
-  t.Branch("A80pix", r.A80pix, "A80pix[3]/L");
-  t.Branch("A80cov", r.A80cov, "A80cov[3]/D");
-
-  t.Branch("X80eq", r.X80eq, "X80eq[3]/D");
-  t.Branch("X80pix", r.X80pix, "X80pix[3]/L");
-  t.Branch("X80cov", r.X80cov, "X80cov[3]/D");
-
-  t.Branch("Y80eq", r.Y80eq, "Y80eq[3]/D");
-  t.Branch("Y80pix", r.Y80pix, "Y80pix[3]/L");
-  t.Branch("Y80cov", r.Y80cov, "Y80cov[3]/D");
-
-  t.Branch("Nfix", r.Nfix, "Nfix[3]/L");
-  t.Branch("A80eq_fixN", r.A80eq_fixN, "A80eq_fixN[3]/D");
-  t.Branch("A80pix_fixN", r.A80pix_fixN, "A80pix_fixN[3]/L");
-  t.Branch("A80cov_fixN", r.A80cov_fixN, "A80cov_fixN[3]/D");
-}
-
 int main(int argc, char** argv) {
   if (argc < 7) {
     std::fprintf(stderr,
-      "Usage:\n  %s <indir> <runFirst> <runLast> <outSummary.root> <outQA.root> <pdfDir>\n",
+      "Usage:\n  %s <indir> <runFirst> <runLast> <outSummary.root> <outQA.root> <pdfDir>\n"
+      "     [--threads N] [--cache DIR] [--fixn-replicas R] [--curve F1,F2,...]\n"
+      "     [--render none|failed|all] [--render-only] [--pixel-gain FILE]\n"
+      "  --threads N: N runs in parallel; the fixed-N replicas then run on each run's own thread\n",
       argv[0]);
     return 2;
   }
 
+  A80Config cfg;
+  int nThreads = 1;
+  std::string cacheDir;
+  bool renderOnly = false;
+  for (int i = 7; i < argc; ++i) {
+    const std::string opt = argv[i];
+    if (opt == "--threads" && i + 1 < argc) {
+      nThreads = std::atoi(argv[++i]);
+    } else if (opt == "--cache" && i + 1 < argc) {
+      cacheDir = argv[++i];
+    } else if (opt == "--fixn-replicas" && i + 1 < argc) {
+      cfg.fixedNReplicas = std::atoi(argv[++i]);
+    } else if (opt == "--curve" && i + 1 < argc) {
+      cfg.curveFracs.clear();
+      const std::string list = argv[++i];
+      for (size_t pos = 0; pos < list.size();) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        if (end > pos) cfg.curveFracs.push_back(std::atof(list.substr(pos, end - pos).c_str()));
+        pos = end + 1;
+      }
+      if ((int)cfg.curveFracs.size() > SummaryRow::kMaxCurve) {
+        std::fprintf(stderr, "--curve: at most %d fractions\n", SummaryRow::kMaxCurve);
+        return 2;
+      }
+    } else if (opt == "--render" && i + 1 < argc) {
+      const std::string m = argv[++i];
+      if      (m == "none")   cfg.renderMode = A80Config::RenderMode::kNone;
+      else if (m == "failed") cfg.renderMode = A80Config::RenderMode::kFailed;
+      else if (m == "all")    cfg.renderMode = A80Config::RenderMode::kAll;
+      else {
+        std::fprintf(stderr, "Unknown render mode: %s (none|failed|all)\n", m.c_str());
+        return 2;
+      }
+    } else if (opt == "--render-only") {
+      renderOnly = true;
+    } else if (opt == "--pixel-gain" && i + 1 < argc) {
+      const std::string file = argv[++i];
+      cfg.pixelGain = PixelGainMap::Load(file);
+      if (!cfg.pixelGain) {
+        std::fprintf(stderr, "Cannot read pixel gain map: %s\n", file.c_str());
+        return 2;
+      }
+    } else {
+      std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
   const std::string indir  = argv[1];
   const int runFirst       = std::atoi(argv[2]);
   const int runLast        = std::atoi(argv[3]);
@@ -76,7 +109,20 @@ int main(int argc, char** argv) {
   const std::string pdfDir = argv[6];
 
   gStyle->SetOptStat(0);
-  EnsureDir(pdfDir);
+
+  if (renderOnly) {
+    const int nPdf = RenderQaPdfs(outSum, outQA, pdfDir, cfg);
+    std::printf("Rendered %d PDF(s) into %s/\n", nPdf, pdfDir.c_str());
+    return 0;
+  }
+
+  if (nThreads > 1) {
+    // must precede any worker thread; histograms are owned explicitly, never by gDirectory
+    ROOT::EnableThreadSafety();
+    TH1::AddDirectory(kFALSE);
+    // runs already use the cores: replica pools inside every run worker would give N x cores threads
+    cfg.fixedNReplicaThreads = 1;
+  }
 
   TFile fqa(outQA.c_str(), "RECREATE");
   TFile fsum(outSum.c_str(), "RECREATE");
@@ -86,19 +132,45 @@ int main(int argc, char** argv) {
   row.reset(0);
   BindSummaryBranches(tsum, row);
 
-  RunProcessor proc;
+  RunProcessor proc(cfg);
 
-  for (int run = runFirst; run <= runLast; ++run) {
-    if (!proc.ProcessRun(indir, run, fqa, pdfDir, row)) {
-      continue;
-    }
+  std::unique_ptr<RunCache> cache;
+  if (!cacheDir.empty()) {
+    cache = std::make_unique<RunCache>(cacheDir, proc.config());
+    proc.SetCache(cache.get());
+  }
+
+  std::set<int> cachedRuns; // their PDFs from an earlier pass are still valid
+  auto write = [&](RunResult& res) {
+    proc.WriteRun(res, fqa);
+    if (res.fromCache) cachedRuns.insert(res.row.run);
+    row = res.row;
     fsum.cd();
     tsum.Fill();
+  };
+
+  if (nThreads > 1) {
+    ProcessRunsParallel(proc, indir, runFirst, runLast, nThreads, write);
+  } else {
+    for (int run = runFirst; run <= runLast; ++run) {
+      RunResult res;
+      if (!proc.AnalyzeRun(indir, run, res)) {
+        continue;
+      }
+      write(res);
+    }
   }
 
   fqa.cd(); fqa.Write(); fqa.Close();
   fsum.cd(); tsum.Write(); fsum.Close();
 
+  // PDF post-pass: reads the histograms back, so the numerical pass above never waits on rendering
+  if (cfg.renderMode != A80Config::RenderMode::kNone) {
+    EnsureDir(pdfDir);
+    const int nPdf = RenderQaPdfs(outSum, outQA, pdfDir, cfg, cachedRuns);
+    std::printf("Rendered %d PDF(s)\n", nPdf);
+  }
+
   std::printf("All done.\nOutput:\n  %s\n  %s\n  %s/\n",
               outSum.c_str(), outQA.c_str(), pdfDir.c_str());
   return 0;
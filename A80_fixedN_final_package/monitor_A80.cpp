@@ -0,0 +1,187 @@
+// Online A80/X80/Y80 monitor: follows the run file that is being written (links libA80, see Makefile).
+//
+// Run:
+//   ./monitor_A80 <indir> <run> <out.txt> [options]
+//
+//   --interval S  : poll every S seconds (default 10)
+//   --socket PATH : also send every update as one datagram to the UNIX socket PATH
+//   --stay        : do not move on to run+1 when it appears
+//   --pixel-gain FILE : per-pixel gain map applied to DSSDX_E (same as process_runs_A80)
+//
+// Every poll reopens <indir>/run%05d_map.root and processes only the entries added since the
+// last poll (RunFollower). The current SummaryRow is written to out.txt as "key = value" lines
+// (replaced atomically, so readers never see a half-written file).
+// When run+1 appears, the current run is finalized (full refit over its events, same numbers as
+// process_runs_A80), published with final = 1, and the monitor follows run+1. Ctrl-C finalizes too.
+
+#include "RunFollower.h"
+#include "A80Types.h"
+#include "PixelGainMap.h"
+
+#include <TSystem.h>
+#include <TString.h>
+#include <TH1.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+static volatile std::sig_atomic_t gStop = 0;
+
+static void OnSignal(int) { gStop = 1; }
+
+static std::string FormatRow(const RunFollower& f, bool final) {
+  const SummaryRow& r = f.row();
+  std::string s;
+  auto add = [&](const char* key, const TString& val) {
+    s += key;
+    s += " = ";
+    s += val.Data();
+    s += "\n";
+  };
+  add("run", TString::Format("%d", r.run));
+  add("final", TString::Format("%d", final ? 1 : 0));
+  add("entries", TString::Format("%lld", f.entries()));
+  add("gated", TString::Format("%lld", f.gatedEvents()));
+  add("nPeaks", TString::Format("%d", r.nPeaks));
+  add("N_all", TString::Format("%lld", r.N_all));
+  add("A80_eq_all", TString::Format("%.4f", r.A80_eq_all));
+  add("X80_eq_all", TString::Format("%.4f", r.X80_eq_all));
+  add("Y80_eq_all", TString::Format("%.4f", r.Y80_eq_all));
+  for (int i = 0; i < 3; ++i) {
+    const TString k = TString::Format("_%d", i);
+    add("muE" + k, TString::Format("%.3f", r.muE[i]));
+    add("sigE" + k, TString::Format("%.3f", r.sigE[i]));
+    add("Npk" + k, TString::Format("%lld", r.Npk[i]));
+    add("mux" + k, TString::Format("%.3f", r.mux[i]));
+    add("muy" + k, TString::Format("%.3f", r.muy[i]));
+    add("A80eq" + k, TString::Format("%.4f", r.A80eq[i]));
+    add("X80eq" + k, TString::Format("%.4f", r.X80eq[i]));
+    add("Y80eq" + k, TString::Format("%.4f", r.Y80eq[i]));
+    add("Nfix" + k, TString::Format("%lld", r.Nfix[i]));
+    add("A80eq_fixN" + k, TString::Format("%.4f", r.A80eq_fixN[i]));
+  }
+  return s;
+}
+
+static void Publish(const std::string& text, const std::string& outFile, int sock, const std::string& sockPath) {
+  const std::string tmp = outFile + ".tmp";
+  if (FILE* fp = std::fopen(tmp.c_str(), "w")) {
+    std::fputs(text.c_str(), fp);
+    std::fclose(fp);
+    gSystem->Rename(tmp.c_str(), outFile.c_str());
+  }
+
+  if (sock >= 0) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, sockPath.c_str(), sizeof(addr.sun_path) - 1);
+    // no listener is fine: the file is the primary output
+    sendto(sock, text.data(), text.size(), 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    std::fprintf(stderr,
+      "Usage:\n  %s <indir> <run> <out.txt> [--interval S] [--socket PATH] [--stay] [--pixel-gain FILE]\n", argv[0]);
+    return 2;
+  }
+
+  const std::string indir   = argv[1];
+  int run                   = std::atoi(argv[2]);
+  const std::string outFile = argv[3];
+
+  double interval = 10.0;
+  std::string sockPath;
+  bool stay = false;
+  std::shared_ptr<const PixelGainMap> pixelGain;
+  for (int i = 4; i < argc; ++i) {
+    const std::string opt = argv[i];
+    if (opt == "--interval" && i + 1 < argc) {
+      interval = std::atof(argv[++i]);
+    } else if (opt == "--socket" && i + 1 < argc) {
+      sockPath = argv[++i];
+    } else if (opt == "--stay") {
+      stay = true;
+    } else if (opt == "--pixel-gain" && i + 1 < argc) {
+      pixelGain = PixelGainMap::Load(argv[++i]);
+      if (!pixelGain) {
+        std::fprintf(stderr, "Cannot read pixel gain map: %s\n", argv[i]);
+        return 2;
+      }
+    } else {
+      std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  int sock = -1;
+  if (!sockPath.empty()) {
+    sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (sock < 0) std::perror("socket");
+  }
+
+  std::signal(SIGINT, OnSignal);
+  std::signal(SIGTERM, OnSignal);
+
+  TH1::AddDirectory(kFALSE);
+  A80Config cfg;
+  cfg.pixelGain = pixelGain;
+
+  auto runFile = [&](int r) {
+    return std::string(TString::Format("%s/run%05d_map.root", indir.c_str(), r).Data());
+  };
+
+  auto finalize = [&](RunFollower& f) {
+    f.Finalize();
+    Publish(FormatRow(f, true), outFile, sock, sockPath);
+    const SummaryRow& r = f.row();
+    std::printf("FINAL run%05d: entries=%lld nPeaks=%d N_all=%lld A80_eq=%.3f X80_eq=%.3f Y80_eq=%.3f\n",
+                r.run, f.entries(), r.nPeaks, r.N_all, r.A80_eq_all, r.X80_eq_all, r.Y80_eq_all);
+    std::fflush(stdout);
+  };
+
+  auto follower = std::make_unique<RunFollower>(cfg, runFile(run), run);
+  while (!gStop) {
+    // check for the next run before polling, so the last entries of this one are still read below
+    const bool nextExists = !stay && !gSystem->AccessPathName(runFile(run + 1).c_str());
+
+    const long long nNew = follower->Update();
+    if (nNew > 0) {
+      Publish(FormatRow(*follower, false), outFile, sock, sockPath);
+      const SummaryRow& r = follower->row();
+      std::printf("run%05d: +%lld entries (%lld) nPeaks=%d N_all=%lld A80_eq=%.3f X80_eq=%.3f Y80_eq=%.3f roiRebuilds=%d\n",
+                  run, nNew, follower->entries(), r.nPeaks, r.N_all, r.A80_eq_all, r.X80_eq_all, r.Y80_eq_all,
+                  follower->roiRebuilds());
+      std::fflush(stdout);
+    }
+
+    if (nextExists) {
+      if (follower->entries() > 0) finalize(*follower); // a skipped run number has no file: publish nothing
+      else { std::printf("run%05d: no entries, skipped\n", run); std::fflush(stdout); }
+      ++run;
+      follower = std::make_unique<RunFollower>(cfg, runFile(run), run);
+      continue;
+    }
+
+    // sleep in short steps so Ctrl-C is handled promptly
+    const auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(interval);
+    while (!gStop && std::chrono::steady_clock::now() < until) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+  }
+
+  if (follower->entries() > 0) finalize(*follower);
+  if (sock >= 0) close(sock);
+  return 0;
+}
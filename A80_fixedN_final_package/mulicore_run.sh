@@ -8,6 +8,9 @@ set -euo pipefail
 #   ./mulicore_run.sh 8 ../ 1 385
 #   ./mulicore_run.sh 8 ../ 1 385 out
 #
+# 提示：单机多核也可以直接用进程内调度（动态分配 run、单一写线程、无需 hadd）：
+#   ./process_runs_A80 INDIR RUN_FIRST RUN_LAST summary.root qa_plots.root pdf --threads 8
+#
 # 环境变量：
 #   CLEAN=1  运行前清理旧输出（默认 1）
 #   CLEAN=0  不清理
@@ -43,12 +46,15 @@ mkdir -p "$JOBS_DIR" "$PDF_DIR"
 
 echo "[1/3] Build binary..."
 # 小工程：直接编译源码目录下的 .cpp，输出到 out/
-g++ -O2 -std=c++17 \
+g++ -O2 -std=c++17 -I"${BASEDIR}/../common" \
   "${BASEDIR}/main.cpp" \
   "${BASEDIR}/RunProcessor.cpp" \
+  "${BASEDIR}/RunScheduler.cpp" \
+  "${BASEDIR}/RunCache.cpp" \
   "${BASEDIR}/PeakFinder.cpp" \
   "${BASEDIR}/Metrics.cpp" \
   "${BASEDIR}/QaIO.cpp" \
+  "${BASEDIR}/QaRender.cpp" \
   $(root-config --cflags --libs) \
   -o "$BIN"
 
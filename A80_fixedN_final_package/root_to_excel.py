@@ -22,6 +22,11 @@ for k, v in arr.items():
     elif v.ndim == 2:
         for i in range(v.shape[1]):
             df[f"{k}_{i}"] = v[:, i]
+    # 二维定长数组，比如 Aeq_curve[3][8] -> Aeq_curve_<峰>_<曲线点>
+    elif v.ndim == 3:
+        for i in range(v.shape[1]):
+            for j in range(v.shape[2]):
+                df[f"{k}_{i}_{j}"] = v[:, i, j]
     else:
         # 更高维/不规则的先跳过
         print(f"Skip {k}: ndim={v.ndim}")
@@ -1,5 +1,7 @@
-// Build:
-//   g++ -O2 -std=c++17 A39_mini.cpp -o A39_mini $(root-config --cflags --glibs)
+// Build (Aeq 计算来自 libA80，先在 ../A80_fixedN_final_package 下 make):
+//   A80=../A80_fixedN_final_package
+//   g++ -O2 -std=c++17 A80_mini_gasfilled.cpp -o A39_mini -I$A80 -L$A80 -lA80 -Wl,-rpath,$A80 \
+//       $(root-config --cflags --glibs)
 //
 // Run:
 //   ./A39_mini <runnum> [E_loss_keV]
@@ -36,6 +38,9 @@
 #include <TRootCanvas.h>    // GUI
 #include <TCanvasImp.h>     // GUI
 
+// libA80: AeqResult / CalcAeq2DCurveFromSampledBins（与 process_runs_A80 同一实现）
+#include "Metrics.h"
+
 // ==========================================
 //  1.Config.h
 // ==========================================
@@ -48,17 +53,13 @@ const double YLO = -0.5, YHI = 47.5;
 const int RESERVOIR_SIZE = 5000;
 // 覆盖率
 const double TARGET_FRAC = 0.39;
+// 顺带输出的覆盖率曲线（同一次排序，几乎无额外开销）
+const std::vector<double> CURVE_FRACS = {0.39, 0.50, 0.80, 0.90, 0.95};
 
 // ==========================================
 // 2.*.cpp
 // ==========================================
 
-struct AeqResult {
-    long long n_pix = 0;
-    double    n_eq  = 0.0;
-    double    cov_at_npix = 0.0;
-};
-
 // 旋转：把 TH1 横着画成 “Counts-x / Channel-y” 的阶梯线
 TGraph* CreateRotatedGraph(TH1* h) {
     if (!h) return nullptr;
@@ -87,60 +88,14 @@ TGraph* CreateRotatedGraph(TH1* h) {
     return gr;
 }
 
-// Metrics.cpp
-AeqResult CalcAeqFromCounts(std::vector<double> counts, double targetFrac) {
-    AeqResult r;
-    if (counts.empty()) return r;
-
-    double tot = 0.0;
-    for (double c : counts) tot += c;
-    if (tot <= 0.0) return r;
-
-    std::sort(counts.begin(), counts.end(), std::greater<double>());
-
-    const double target = targetFrac * tot;
-    double acc = 0.0, accPrev = 0.0;
-    long long nFull = 0;
+// 从蓄水池样本中重建计数并计算 A39；curve 同时给出 CURVE_FRACS 各点
+AeqResult CalculateReservoirA39(const std::vector<int>& binIdx, std::vector<AeqResult>* curve = nullptr) {
+    std::vector<double> fracs(1, TARGET_FRAC);
+    fracs.insert(fracs.end(), CURVE_FRACS.begin(), CURVE_FRACS.end());
 
-    for (double c : counts) {
-        accPrev = acc;
-        acc += c;
-        ++nFull;
-        if (acc >= target) {
-            r.n_pix = nFull;
-            r.cov_at_npix = acc / tot;
-
-            const double need = target - accPrev;
-            double f = (c > 0.0) ? (need / c) : 1.0;
-            if (f < 0.0) f = 0.0;
-            if (f > 1.0) f = 1.0;
-
-            r.n_eq = (nFull - 1) + f;
-            return r;
-        }
-    }
-
-    r.n_pix = (long long)counts.size();
-    r.n_eq = (double)counts.size();
-    r.cov_at_npix = 1.0;
-    return r;
-}
-
-// 从蓄水池样本中重建计数并计算 A39
-AeqResult CalculateReservoirA39(const std::vector<int>& binIdx) {
-    int nbin = NX * NY;
-    std::vector<int> cnt(nbin, 0);
-
-    for (int idx : binIdx) {
-        if (idx >= 0 && idx < nbin) cnt[idx]++;
-    }
-
-    std::vector<double> counts;
-    counts.reserve(nbin);
-    for (int c : cnt) {
-        if (c > 0) counts.push_back((double)c);
-    }
-    return CalcAeqFromCounts(counts, TARGET_FRAC);
+    std::vector<AeqResult> c = CalcAeq2DCurveFromSampledBins(binIdx, NX, NY, fracs);
+    if (curve) curve->assign(c.begin() + 1, c.end());
+    return c[0];
 }
 
 // ==========================================
@@ -288,13 +243,14 @@ int main(int argc, char** argv) {
     // 4. 计算结果
     // ==========================================
     AeqResult res;
+    std::vector<AeqResult> curve;
     if (seenCount >= RESERVOIR_SIZE) {
-        res = CalculateReservoirA39(reservoir);
+        res = CalculateReservoirA39(reservoir, &curve);
     } else {
         std::cout << "[Warning] Total events in ROI (" << seenCount
                   << ") < Reservoir Size (" << RESERVOIR_SIZE
                   << "). Using all events.\n";
-        res = CalculateReservoirA39(reservoir);
+        res = CalculateReservoirA39(reservoir, &curve);
     }
 
     // 终端输出
@@ -311,6 +267,11 @@ int main(int argc, char** argv) {
     std::cout << "Fixed-N A39 (EqPix):   " << res.n_eq << "\n";
     std::cout << "Raw Pixels used:       " << res.n_pix << "\n";
     std::cout << "Coverage achieved:     " << res.cov_at_npix * 100.0 << " %\n";
+    std::cout << "Coverage curve A(f):  ";
+    for (size_t i = 0; i < curve.size(); ++i) {
+        std::cout << " " << CURVE_FRACS[i] << ":" << curve[i].n_eq;
+    }
+    std::cout << "\n";
     std::cout << "------------------------------------------------\n";
 
     // ==========================================
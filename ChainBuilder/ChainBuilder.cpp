@@ -0,0 +1,376 @@
+#include "ChainBuilder.h"
+#include "Config.h"
+#include "PixelEventStore.h"
+#include "ROOT/RDataFrame.hxx"
+#include "ROOT/RVec.hxx"
+#include "ROOT/TSeq.hxx"
+#include "ROOT/TThreadExecutor.hxx"
+#include "TFile.h"
+#include "TString.h"
+#include "TSystem.h"
+#include "TTree.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+using namespace ROOT;
+
+ChainBuilder::ChainBuilder(const ChainWindows& w, int n_regions) : w_(w) {
+    n_regions = max(1, min(n_regions, NUM_DSSDX_POS));
+    for (int r = 0; r < n_regions; ++r) {
+        region_lo_.push_back(NUM_DSSDX_POS * r / n_regions);
+        region_hi_.push_back(NUM_DSSDX_POS * (r + 1) / n_regions);
+        regions_.emplace_back(w_, NUM_DSSDX_POS, NUM_DSSDY_POS, region_lo_.back(), region_hi_.back());
+    }
+    region_out_.resize(n_regions);
+}
+
+// 事件选择（Preselect 的 implant/decay 划分）+ 各窗口并集的粗能量筛选；真正的判断在 Correlator 里
+static bool Candidate(const ChainWindows& w, bool implant, bool ssd, bool veto, double e) {
+    if (veto) return false;
+    if (implant) return !ssd && e >= w.er_e_min && e <= w.er_e_max;
+    if (ssd) return w.allow_escape && e >= w.esc_e_min && e <= w.esc_e_max;
+    for (const ChainStep& s : w.steps) {
+        if (e >= s.e_min && e <= s.e_max) return true;
+    }
+    return w.allow_sf && e >= w.sf_e_min;
+}
+
+vector<ChainHit> ChainBuilder::ReadRun(const string& file, int run, const ChainWindows& w) {
+    ROOT::RDataFrame df(TREE_NAME, file);
+    vector<vector<ChainHit>> slots(df.GetNSlots());
+    // 多线程下 rdfentry_ 不是 tr_map 的 entry：用任务区间起点 + 本槽计数还原（同一区间内按顺序读）
+    vector<pair<ULong64_t, ULong64_t>> cursor(df.GetNSlots(), {~0ULL, 0});
+    auto dfe = df.DefinePerSample("entry0", [](unsigned int, const ROOT::RDF::RSampleInfo& id) { return id.EntryRange().first; });
+
+    dfe.ForeachSlot([&](unsigned int s, UShort_t xm, UShort_t ym, UShort_t vm, UShort_t mm, UShort_t sm,
+                       const RVec<double>& xe, const RVec<double>& xch, const RVec<double>& ych,
+                       const RVec<ULong64_t>& xts, const RVec<double>& se, const RVec<double>& sch,
+                       ULong64_t entry0) {
+        auto& c = cursor[s];
+        if (c.first != entry0) c = {entry0, entry0};
+        const ULong64_t entry = c.second++;
+        if (xm != 1 || ym != 1 || xts.empty()) return;
+        const bool implant = (mm > 0);
+        const bool ssd = (sm > 0 && !se.empty() && !sch.empty());
+        if (!Candidate(w, implant, sm > 0, vm > 0, xe[0])) return;
+        if (xch[0] < 0 || xch[0] >= NUM_DSSDX_POS || ych[0] < 0 || ych[0] >= NUM_DSSDY_POS) return;
+
+        ChainHit h;
+        h.ts      = xts[0];
+        h.entry   = static_cast<int64_t>(entry);
+        h.e       = static_cast<float>(xe[0]);
+        h.ssd_e   = ssd ? static_cast<float>(se[0]) : 0.f;
+        h.run     = static_cast<int16_t>(run);
+        h.ssd_pos = ssd ? static_cast<int8_t>(sch[0]) : -1;
+        h.x       = static_cast<uint8_t>(xch[0]);
+        h.y       = static_cast<uint8_t>(ych[0]);
+        h.implant = implant ? 1 : 0;
+        slots[s].push_back(h);
+    }, {"DSSDX_mul", "DSSDY_mul", "Veto_mul", "MWPC_mul", "SSD_mul",
+        "DSSDX_E", "DSSDX_Ch", "DSSDY_Ch", "DSSDX_Ts", "SSD_E", "SSD_Ch", "entry0"});
+
+    vector<ChainHit> hits;
+    size_t n = 0;
+    for (auto& v : slots) n += v.size();
+    hits.reserve(n);
+    for (auto& v : slots) { hits.insert(hits.end(), v.begin(), v.end()); vector<ChainHit>().swap(v); }
+    // 多线程读入的顺序不定；entry 作为同一时间戳的次序，结果可复现
+    sort(hits.begin(), hits.end(), [](const ChainHit& a, const ChainHit& b) {
+        return a.ts != b.ts ? a.ts < b.ts : a.entry < b.entry;
+    });
+    return hits;
+}
+
+void ChainBuilder::Correlate(const vector<ChainHit>& hits, vector<Chain>& out) {
+    const uint64_t now = hits.back().ts;
+    ROOT::TThreadExecutor pool(NUM_THREADS);
+    pool.Foreach([&](int r) {
+        vector<Chain>& ro = region_out_[r];
+        auto emit = [&ro](const Chain& c) { ro.push_back(c); };
+        for (const ChainHit& h : hits) regions_[r].Process(h, emit);
+        regions_[r].Sweep(now, emit);
+    }, ROOT::TSeqI(static_cast<int>(regions_.size())));
+
+    for (auto& ro : region_out_) { out.insert(out.end(), ro.begin(), ro.end()); ro.clear(); }
+}
+
+void ChainBuilder::FlushAll(vector<Chain>& out) {
+    for (auto& c : regions_) c.Flush([&out](const Chain& ch) { out.push_back(ch); });
+}
+
+bool ChainBuilder::WriteRun(const string& file, int run, vector<Chain>& chains) const {
+    sort(chains.begin(), chains.end(), [](const Chain& a, const Chain& b) {
+        if (a.hit[0].ts != b.hit[0].ts) return a.hit[0].ts < b.hit[0].ts;
+        if (a.hit[0].entry != b.hit[0].entry) return a.hit[0].entry < b.hit[0].entry;
+        return a.hit[a.n - 1].entry < b.hit[b.n - 1].entry;
+    });
+
+    TFile f(file.c_str(), "RECREATE");
+    if (f.IsZombie()) return false;
+    TTree t(CHAIN_TREE_NAME, "ER-alpha-alpha(-SF) chains");
+
+    // 与下游 (SSD_calibration, transfer_plot, count_range.C) 读的 tr_chain 分支一致：
+    // DSSD_E / SSD_E / SSD_Pos / Delta_Ts[chain_mul]，[0] 为 ER，Delta_Ts[k] = Ts[k] - Ts[k-1] (ns)
+    Int_t     b_run = run;
+    UInt_t    mul = 0;
+    Double_t  dssd_e[kMaxChain], ssd_e[kMaxChain], ssd_pos[kMaxChain], dts[kMaxChain];
+    Double_t  xch[kMaxChain], ych[kMaxChain];
+    ULong64_t ts[kMaxChain];
+    Int_t     type[kMaxChain], src_run[kMaxChain];
+    Long64_t  src_entry[kMaxChain];
+    t.Branch("run",       &b_run,    "run/I");
+    t.Branch("chain_mul", &mul,      "chain_mul/i");
+    t.Branch("DSSD_E",    dssd_e,    "DSSD_E[chain_mul]/D");
+    t.Branch("SSD_E",     ssd_e,     "SSD_E[chain_mul]/D");
+    t.Branch("SSD_Pos",   ssd_pos,   "SSD_Pos[chain_mul]/D");
+    t.Branch("Delta_Ts",  dts,       "Delta_Ts[chain_mul]/D");
+    t.Branch("DSSDX_Ch",  xch,       "DSSDX_Ch[chain_mul]/D");
+    t.Branch("DSSDY_Ch",  ych,       "DSSDY_Ch[chain_mul]/D");
+    t.Branch("Ts",        ts,        "Ts[chain_mul]/l");
+    t.Branch("type",      type,      "type[chain_mul]/I");
+    t.Branch("src_run",   src_run,   "src_run[chain_mul]/I");
+    t.Branch("src_entry", src_entry, "src_entry[chain_mul]/L");
+
+    for (const Chain& c : chains) {
+        mul = static_cast<UInt_t>(c.n);
+        for (int i = 0; i < c.n; ++i) {
+            const ChainHit& h = c.hit[i];
+            dssd_e[i]    = h.e;
+            ssd_e[i]     = h.ssd_e;
+            ssd_pos[i]   = h.ssd_pos;
+            dts[i]       = (i == 0) ? 0.0 : static_cast<double>(h.ts - c.hit[i - 1].ts);
+            xch[i]       = h.x;
+            ych[i]       = h.y;
+            ts[i]        = h.ts;
+            type[i]      = c.type[i];
+            src_run[i]   = h.run;
+            src_entry[i] = h.entry;
+        }
+        b_run = c.hit[0].run;
+        t.Fill();
+    }
+    t.Write();
+    f.Close();
+    return true;
+}
+
+long long ChainBuilder::Run() {
+    long long n_total = 0;
+    int n_files = 0;
+    uint64_t last_ts = 0;
+
+    // 链写进它关闭时所在 run 的文件；上一个 run 的文件等到确定下一个 run 的时间戳是否连续后再写
+    string pending_file;
+    int pending_run = -1;
+    vector<Chain> pending;
+    auto write_pending = [&]() {
+        if (pending_run < 0) return;
+        if (!WriteRun(pending_file, pending_run, pending)) {
+            cerr << "[ERROR] Cannot write " << pending_file << endl;
+        } else {
+            cout << "--> " << pending_file << ": " << pending.size() << " chains" << endl;
+            n_total += static_cast<long long>(pending.size());
+        }
+        pending.clear();
+    };
+
+    for (int run = RUN_START; run <= RUN_END; ++run) {
+        TString in = TString::Format(INPUT_DIR_PATTERN, run);
+        if (gSystem->AccessPathName(in)) continue;
+        ++n_files;
+
+        vector<ChainHit> hits = ReadRun(in.Data(), run, w_);
+        size_t n_implant = 0;
+        for (const ChainHit& h : hits) n_implant += h.implant;
+        cout << "--> run " << run << ": " << n_implant << " implant / " << hits.size() - n_implant << " decay candidates" << endl;
+
+        // 时钟回退（或不允许跨 run）：打开的链归上一个 run
+        if (!CHAIN_ACROSS_RUNS || (!hits.empty() && hits.front().ts < last_ts)) FlushAll(pending);
+        write_pending();
+
+        pending_file = TString::Format(OUTPUT_PATTERN, run).Data();
+        pending_run = run;
+        if (!hits.empty()) {
+            Correlate(hits, pending);
+            last_ts = hits.back().ts;
+        }
+    }
+    if (n_files == 0) return -1;
+
+    FlushAll(pending);
+    write_pending();
+    return n_total;
+}
+
+bool ChainBuilder::FromStore(const ChainWindows& w, int x, int y, const StoreEvent& ev, ChainHit& h) {
+    if (!Candidate(w, ev.flags & kStoreMWPC, ev.flags & kStoreSSD, ev.flags & kStoreVeto, ev.e)) return false;
+    h.ts      = ev.ts;
+    h.entry   = ev.entry;
+    h.e       = ev.e;
+    h.ssd_e   = ev.ssd_e;
+    h.run     = static_cast<int16_t>(ev.run);
+    h.ssd_pos = ev.ssd_pos;
+    h.x       = static_cast<uint8_t>(x);
+    h.y       = static_cast<uint8_t>(y);
+    h.implant = (ev.flags & kStoreMWPC) ? 1 : 0;
+    return true;
+}
+
+long long ChainBuilder::RunFromStore(const PixelEventStore& store) {
+    if (store.NX() != NUM_DSSDX_POS || store.NY() != NUM_DSSDY_POS) return -1;
+    const int win = w_.pos_win;
+    const int n_regions = static_cast<int>(regions_.size());
+    const int n_slots = RUN_END - RUN_START + 1;
+    auto slot_of = [](int run) { return (run >= RUN_START && run <= RUN_END) ? run - RUN_START : -1; };
+
+    // 1. 每个 run 的候选统计（与 Run() 里 ReadRun 的结果相同）：最早 / 最晚候选时间决定 Sweep 和是否清空
+    struct RunInfo {
+        bool present = false;
+        long long n_implant = 0, n_decay = 0;
+        uint64_t first = UINT64_MAX, last = 0;
+        bool has_cand() const { return n_implant + n_decay > 0; }
+    };
+    vector<vector<RunInfo>> part(n_regions, vector<RunInfo>(n_slots));
+    ROOT::TThreadExecutor pool(NUM_THREADS);
+    pool.Foreach([&](int r) {
+        for (int x = region_lo_[r]; x < region_hi_[r]; ++x) {
+            for (int y = 0; y < NUM_DSSDY_POS; ++y) {
+                for (const StoreEvent* ev = store.Begin(x, y); ev != store.End(x, y); ++ev) {
+                    const int s = slot_of(ev->run);
+                    if (s < 0) continue;
+                    RunInfo& ri = part[r][s];
+                    ri.present = true;
+                    ChainHit h;
+                    if (!FromStore(w_, x, y, *ev, h)) continue;
+                    (h.implant ? ri.n_implant : ri.n_decay)++;
+                    ri.first = min(ri.first, h.ts);
+                    ri.last = max(ri.last, h.ts);
+                }
+            }
+        }
+    }, ROOT::TSeqI(n_regions));
+
+    // 索引里有事件的 run（按 run 号）；有输入文件却不在索引里的 run 不动它的输出文件
+    vector<RunInfo> info;
+    vector<int> runs, run_index(n_slots, -1);
+    for (int s = 0; s < n_slots; ++s) {
+        RunInfo ri;
+        for (int r = 0; r < n_regions; ++r) {
+            const RunInfo& q = part[r][s];
+            ri.present = ri.present || q.present;
+            ri.n_implant += q.n_implant;
+            ri.n_decay += q.n_decay;
+            ri.first = min(ri.first, q.first);
+            ri.last = max(ri.last, q.last);
+        }
+        const int run = RUN_START + s;
+        if (!ri.present) {
+            if (!gSystem->AccessPathName(TString::Format(INPUT_DIR_PATTERN, run))) {
+                cerr << "[WARNING] run " << run << " has an input file but no events in the store (rebuild it with make Store)" << endl;
+            }
+            continue;
+        }
+        run_index[s] = static_cast<int>(runs.size());
+        runs.push_back(run);
+        info.push_back(ri);
+    }
+    if (runs.empty()) return 0;
+    const int n_runs = static_cast<int>(runs.size());
+
+    // 与 Run() 相同的 run 边界规则：不允许跨 run、或时钟回退（本 run 最早候选早于上一个有候选的 run 的最晚候选）时，
+    // 打开的链在本 run 开始前全部关闭并归上一个 run。时钟回退把索引分成几段，每段内 (ts, run) 顺序就是 run 顺序。
+    vector<char> flush(n_runs, 0), reset(n_runs, 0);
+    uint64_t last_ts = 0;
+    for (int i = 0; i < n_runs; ++i) {
+        const RunInfo& ri = info[i];
+        cout << "--> run " << runs[i] << ": " << ri.n_implant << " implant / " << ri.n_decay << " decay candidates" << endl;
+        reset[i] = ri.has_cand() && ri.first < last_ts;
+        flush[i] = !CHAIN_ACROSS_RUNS || reset[i];
+        if (ri.has_cand()) last_ts = ri.last;
+    }
+    vector<int> epoch_lo = {0};
+    for (int i = 1; i < n_runs; ++i) if (reset[i]) epoch_lo.push_back(i);
+    epoch_lo.push_back(n_runs);
+
+    // 2. 每个区域：本区域 ± win 的像素各自已按时间排序，每段时钟内小顶堆归并成一条时间流；
+    //    链进入它关闭时所在 run 的输出（run 结束时按全局最晚候选时间 Sweep，与 Correlate 相同）
+    vector<vector<vector<Chain>>> out(n_regions, vector<vector<Chain>>(n_runs));
+    pool.Foreach([&](int r) {
+        Correlator& corr = regions_[r];
+        vector<vector<Chain>>& ro = out[r];
+        auto emit_to = [&ro](int i) { return [&ro, i](const Chain& c) { ro[i].push_back(c); }; };
+        int cur = 0;
+        auto next_run = [&]() {
+            if (info[cur].has_cand()) corr.Sweep(info[cur].last, emit_to(cur));
+            ++cur;
+            if (flush[cur]) corr.Flush(emit_to(cur - 1));
+        };
+
+        struct Cursor { const StoreEvent* p; const StoreEvent* end; int x, y; };
+        auto later = [](const Cursor& a, const Cursor& b) { return StoreEventLess(*b.p, *a.p); };
+        for (size_t e = 0; e + 1 < epoch_lo.size(); ++e) {
+            const int lo = epoch_lo[e], hi = epoch_lo[e + 1];
+            auto index_of = [&](const StoreEvent& ev) {
+                const int s = slot_of(ev.run);
+                return s < 0 ? -1 : run_index[s];
+            };
+            // 只走本段的 run；只有一段时不跳过任何事件
+            auto skip = [&](Cursor& c) {
+                while (c.p != c.end) {
+                    const int i = index_of(*c.p);
+                    if (i >= lo && i < hi) break;
+                    ++c.p;
+                }
+            };
+            vector<Cursor> heap;
+            for (int x = max(0, region_lo_[r] - win); x < min(NUM_DSSDX_POS, region_hi_[r] + win); ++x) {
+                for (int y = 0; y < NUM_DSSDY_POS; ++y) {
+                    Cursor c{store.Begin(x, y), store.End(x, y), x, y};
+                    skip(c);
+                    if (c.p != c.end) heap.push_back(c);
+                }
+            }
+            make_heap(heap.begin(), heap.end(), later);
+
+            while (cur < lo) next_run();
+            while (!heap.empty()) {
+                pop_heap(heap.begin(), heap.end(), later);
+                Cursor& c = heap.back();
+                // 只有候选推进 run：其它事件的时间不受上面的时钟分段保证
+                ChainHit h;
+                if (FromStore(w_, c.x, c.y, *c.p, h)) {
+                    const int i = index_of(*c.p);
+                    while (cur < i) next_run();
+                    corr.Process(h, emit_to(cur));
+                }
+                ++c.p;
+                skip(c);
+                if (c.p == c.end) heap.pop_back();
+                else push_heap(heap.begin(), heap.end(), later);
+            }
+        }
+        while (cur < n_runs - 1) next_run();
+        if (info[cur].has_cand()) corr.Sweep(info[cur].last, emit_to(cur));
+        corr.Flush(emit_to(cur));
+    }, ROOT::TSeqI(n_regions));
+
+    // 3. 每个 run 都写（没有链的写空树），和 Run() 一样覆盖旧文件
+    long long n_total = 0;
+    for (int i = 0; i < n_runs; ++i) {
+        vector<Chain> chains;
+        for (auto& ro : out) {
+            chains.insert(chains.end(), ro[i].begin(), ro[i].end());
+            vector<Chain>().swap(ro[i]);
+        }
+        const string file = TString::Format(OUTPUT_PATTERN, runs[i]).Data();
+        if (!WriteRun(file, runs[i], chains)) {
+            cerr << "[ERROR] Cannot write " << file << endl;
+            continue;
+        }
+        cout << "--> " << file << ": " << chains.size() << " chains" << endl;
+        n_total += static_cast<long long>(chains.size());
+    }
+    return n_total;
+}
@@ -0,0 +1,46 @@
+#ifndef CHAIN_BUILDER_H
+#define CHAIN_BUILDER_H
+
+#include <string>
+#include <vector>
+#include "Correlator.h"
+
+class PixelEventStore;
+struct StoreEvent;
+
+// tr_map -> tr_chain：run 按顺序流式处理，每个 run 只读一遍
+//   1. ReadRun：RDataFrame 多线程读出 implant / decay 候选（只保留 ChainHit 的几个量），按时间排序
+//   2. Correlate：NUM_REGIONS 个 Correlator（按 X 条分区域）并行处理同一份有序 hit
+//   3. WriteRun：关闭的链按 ER 时间排序写成 tr_chain
+// 内存只与单个 run 的候选数和打开的链数有关（每像素最多 MAX_OPEN_PER_PIXEL 条）。
+// RunFromStore：同样的关联，hit 直接取自像素事件索引（../common/PixelEventStore.h），不读 tr_map；
+// run 边界（CHAIN_ACROSS_RUNS、时钟回退）和链写进哪个 run 的文件与 Run() 相同。
+class ChainBuilder {
+public:
+    explicit ChainBuilder(const ChainWindows& w, int n_regions);
+
+    // RUN_START..RUN_END，返回写出的链数；一个输入文件都没有时返回 -1
+    long long Run();
+    // 从像素事件索引重建：每个区域把自己（含 ±pos_win）的像素按时间归并后关联，结果与 Run() 相同；
+    // 只写索引里有事件的 run（有输入文件但不在索引里的 run 给出警告，不动它的输出文件）
+    long long RunFromStore(const PixelEventStore& store);
+
+    // 一个 run 的候选 hit：Preselect 的 implant/decay 划分 + 各窗口并集的粗能量筛选，按 (ts, entry) 排序
+    static std::vector<ChainHit> ReadRun(const std::string& file, int run, const ChainWindows& w);
+    // 索引中像素 (x, y) 的一个事件 -> 候选 hit（与 ReadRun 相同的选择）；不是候选时返回 false
+    static bool FromStore(const ChainWindows& w, int x, int y, const StoreEvent& ev, ChainHit& h);
+
+private:
+    // 按区域并行关联，关闭的链追加到 out；run 结束时关闭已经过期的链
+    void Correlate(const std::vector<ChainHit>& hits, std::vector<Chain>& out);
+    // 关闭所有打开的链（时钟回退 / 数据结束）
+    void FlushAll(std::vector<Chain>& out);
+    bool WriteRun(const std::string& file, int run, std::vector<Chain>& chains) const;
+
+    ChainWindows w_;
+    std::vector<Correlator> regions_;
+    std::vector<int> region_lo_, region_hi_; // 各区域负责的 X 条 [lo, hi)
+    std::vector<std::vector<Chain>> region_out_;
+};
+
+#endif
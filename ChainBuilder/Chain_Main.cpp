@@ -0,0 +1,50 @@
+#include "Config.h"
+#include "ChainBuilder.h"
+#include "PixelEventStore.h"
+#include "ROOT/RDataFrame.hxx"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// tr_map -> tr_chain：ER–α–α(–SF) 关联链（窗口见 Config.h）
+// 用法：./Chain_Build                 逐 run 读 tr_map
+//       ./Chain_Build --store [FILE]  从 Store_Build 生成的像素事件索引重建（默认 STORE_FILE），不读 tr_map；
+//                                     输出与逐 run 相同，只是不在索引里的 run 不写
+int main(int argc, char** argv) {
+    string store_file;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--store") == 0) store_file = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : STORE_FILE;
+        else { cerr << "[ERROR] unknown option " << argv[i] << endl; return 1; }
+    }
+    if (NUM_THREADS > 0) ROOT::EnableImplicitMT(NUM_THREADS);
+
+    const ChainWindows w = DefaultWindows();
+    cout << "=== Chain builder: runs " << RUN_START << "-" << RUN_END << ", " << w.steps.size() << " alpha step(s)"
+         << (w.allow_sf ? " + SF" : "") << ", position window +-" << w.pos_win << ", " << NUM_REGIONS << " regions ===" << endl;
+
+    ChainBuilder builder(w, NUM_REGIONS);
+    long long n = 0;
+    if (!store_file.empty()) {
+        auto store = PixelEventStore::Open(store_file);
+        if (!store) {
+            cerr << "[ERROR] Cannot open store " << store_file << " (run Store_Build first)" << endl;
+            return 1;
+        }
+        cout << "--> Reading " << store->Size() << " events from " << store_file << endl;
+        n = builder.RunFromStore(*store);
+        if (n < 0) {
+            cerr << "[ERROR] Store geometry does not match " << NUM_DSSDX_POS << "x" << NUM_DSSDY_POS << endl;
+            return 1;
+        }
+    } else {
+        n = builder.Run();
+        if (n < 0) {
+            cerr << "[ERROR] No input files found." << endl;
+            return 1;
+        }
+    }
+    cout << "=== Chain builder done: " << n << " chains written ===" << endl;
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <vector>
+#include "Correlator.h"
+
+// ===================================================================
+//              关联链构建 (tr_map -> tr_chain) 配置文件
+// ===================================================================
+
+// --- 1. 运行配置 ---
+inline constexpr int NUM_THREADS = 10;
+// X 方向切成的区域数：每个区域一个 Correlator，按区域并行关联（结果与区域数无关）
+inline constexpr int NUM_REGIONS = 16;
+
+// --- 2. 文件路径配置 ---
+// [输入] tr_map（建议用 DSSD_Apply 刻度写回后的文件，%05d = run 号）
+inline constexpr char INPUT_DIR_PATTERN[] = "/home/evalie/Project/Document/After/SS032%05d_map_recal.root";
+inline constexpr int RUN_START = 2;
+inline constexpr int RUN_END = 178;
+inline constexpr char TREE_NAME[] = "tr_map";
+
+// [输出] 每个 run 一个 tr_chain 文件（链写进它关闭时所在 run 的文件）
+inline constexpr char OUTPUT_PATTERN[] = "SS032%05d_chain.root";
+inline constexpr char CHAIN_TREE_NAME[] = "tr_chain";
+
+// [索引] 按像素、时间排序的事件索引（Store_Build 生成，Chain_Build --store / Store_Query 读）
+inline constexpr char STORE_FILE[] = "SS032_pixel_store.bin";
+
+// --- 3. 像素 ---
+inline constexpr int NUM_DSSDX_POS = 128;
+inline constexpr int NUM_DSSDY_POS = 48;
+
+// --- 4. 事件选择（与 DSSD_recal_all/Preselect_Main.cpp 相同的 implant/decay 划分）---
+// 公共：DSSDX_mul == 1 && DSSDY_mul == 1 && Veto_mul == 0
+// implant: MWPC_mul > 0 && SSD_mul == 0
+// decay  : MWPC_mul == 0（SSD 有信号的记为逃逸 α 候选，见 ALLOW_ESCAPE）
+// 相邻 run 的时间戳连续时，打开的链跨 run 继续；时间戳回退（时钟重置）时全部关闭
+inline constexpr bool CHAIN_ACROSS_RUNS = true;
+
+// --- 5. 关联窗口 ---
+// 时间单位 ns（与 DSSDX_Ts 相同），能量 keV（DSSDX_E[0]）
+inline constexpr double ER_E_MIN = 5000.0;
+inline constexpr double ER_E_MAX = 20000.0;
+// 每一代 α：{E_min, E_max, 距上一成员的最大时间}
+inline const std::vector<ChainStep> CHAIN_STEPS = {
+    {8000.0, 12000.0, 10e9},   // α1
+    {8000.0, 12000.0, 60e9},   // α2
+};
+// 逃逸 α（decay 事件 SSD 有信号）：只要求 DSSD 部分在窗口内
+inline constexpr bool ALLOW_ESCAPE = true;
+inline constexpr double ESC_E_MIN = 500.0;
+inline constexpr double ESC_E_MAX = 5000.0;
+// SF 可以终止任意一代
+inline constexpr bool ALLOW_SF = true;
+inline constexpr double SF_E_MIN = 40000.0;
+inline constexpr double SF_DT_MAX = 60e9;
+// 位置窗口：|dX| <= POS_WIN && |dY| <= POS_WIN（条）
+inline constexpr int POS_WIN = 1;
+// 输出的最少成员数（含 ER）：2 = ER–α 也输出
+inline constexpr int MIN_CHAIN_MUL = 2;
+// 每个像素最多同时打开的链（内存上限；超出时最早的 ER 先关闭）
+inline constexpr int MAX_OPEN_PER_PIXEL = 64;
+
+// --- 6. 随机关联概率 (Random_Build，读 STORE_FILE) ---
+inline constexpr char RANDOM_OUTPUT_FILE[] = "SS032_random_corr.root";
+// tr_chain 的友树：每条链每个成员的随机期望 μ 与概率，entry 与 OUTPUT_PATTERN 的文件一一对应
+inline constexpr char PROB_PATTERN[] = "SS032%05d_chain_prob.root";
+inline constexpr char PROB_TREE_NAME[] = "tr_chain_prob";
+// 计数率随时间变化的分箱 (s)；计数率模型 r(像素, t) = 像素平均计数率 × 整个探测器计数率随时间的相对变化
+inline constexpr double RATE_BIN_S = 600.0;
+// MC：每个 trial 注入一个 ER（时刻取一个实际 implant，像素取另一个实际 implant），随机数只由 trial 号决定
+inline constexpr long long MC_TRIALS = 10000000;
+inline constexpr uint64_t MC_SEED = 20240501ULL;
+inline constexpr int MC_THREADS = 0; // 0 = 全部核
+// 注入的真实衰变：每代 α 的半衰期 (ns)，能量取该代窗口中心；用来估计链被随机事件污染 / 丢失的比例
+inline const std::vector<double> MC_HALF_LIFE = {1e9, 5e9};
+
+inline ChainWindows DefaultWindows() {
+    ChainWindows w;
+    w.er_e_min = ER_E_MIN;  w.er_e_max = ER_E_MAX;
+    w.steps = CHAIN_STEPS;
+    w.allow_escape = ALLOW_ESCAPE; w.esc_e_min = ESC_E_MIN; w.esc_e_max = ESC_E_MAX;
+    w.allow_sf = ALLOW_SF; w.sf_e_min = SF_E_MIN; w.sf_dt_max = SF_DT_MAX;
+    w.pos_win = POS_WIN;
+    w.min_mul = MIN_CHAIN_MUL;
+    w.max_open = MAX_OPEN_PER_PIXEL;
+    return w;
+}
+
+#endif
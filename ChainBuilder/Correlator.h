@@ -0,0 +1,193 @@
+#ifndef CORRELATOR_H
+#define CORRELATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// 关联核心（不依赖 ROOT）：按时间顺序喂入 implant / decay hit，输出 ER–α–α(–SF) 链。
+// 链以 implant (ER) 为根：每个 ER 在自己的像素上开一条“打开的链”，之后位置窗口内的 decay
+// 依次填入下一代；链满、遇到 SF 或超过下一代的时间窗口时关闭，成员数够就输出。
+// 同一个 decay 可以进入多条链（多个 ER 都在窗口内时），每一代只取窗口内的第一个 decay。
+//
+// 按区域并行：一个 Correlator 只负责根在 [x_lo, x_hi) 的链（X 条号），decay 看
+// [x_lo - pos_win, x_hi + pos_win)。各区域互不相关，结果与单个关联器完全一致。
+
+// 一个候选 hit（实际事件或 MC 注入）
+struct ChainHit {
+    uint64_t ts;      // ns (DSSDX_Ts[0])
+    int64_t  entry;   // tr_map 中的 entry，MC 为 -1
+    float    e;       // DSSD 能量 (keV, DSSDX_E[0])
+    float    ssd_e;   // SSD_E[0]，无 SSD 为 0
+    int16_t  run;     // run 号
+    int8_t   ssd_pos; // SSD_Ch[0]，无 SSD 为 -1
+    uint8_t  x, y;    // 像素 (X 条 0-127, Y 条 0-47)
+    uint8_t  implant; // 1 = implant (MWPC_mul > 0), 0 = decay
+};
+
+// 链成员类型（tr_chain 的 type[]）
+enum ChainType : uint8_t { kER = 0, kAlpha = 1, kEscape = 2, kSF = 3 };
+
+// 一代 α：DSSD 能量窗口 (keV) 与距上一成员的最大时间 (ns)
+struct ChainStep {
+    double e_min, e_max;
+    double dt_max;
+};
+
+struct ChainWindows {
+    double er_e_min = 0, er_e_max = 0;  // ER 的 DSSD 能量 (keV)
+    std::vector<ChainStep> steps;       // α1, α2, ...
+    bool   allow_escape = false;        // SSD 有信号的逃逸 α：DSSD 部分在 [esc_e_min, esc_e_max] 即可
+    double esc_e_min = 0, esc_e_max = 0;
+    bool   allow_sf = false;            // SF 可以终止任意一代：DSSD 能量 >= sf_e_min，距上一成员 <= sf_dt_max
+    double sf_e_min = 0, sf_dt_max = 0;
+    int    pos_win = 0;                 // |dx| <= pos_win && |dy| <= pos_win
+    int    min_mul = 2;                 // 输出的最少成员数（含 ER）
+    int    max_open = 64;               // 每个像素最多同时打开的链，超出时最早的先关
+};
+
+inline constexpr int kMaxChain = 8; // ER + 最多 7 代
+
+struct Chain {
+    int n = 0;
+    ChainHit hit[kMaxChain];
+    uint8_t type[kMaxChain];
+};
+
+class Correlator {
+public:
+    Correlator(const ChainWindows& w, int nx, int ny, int x_lo, int x_hi)
+        : w_(w), nx_(nx), ny_(ny), x_lo_(x_lo), x_hi_(x_hi),
+          n_steps_(std::min<int>(static_cast<int>(w.steps.size()), kMaxChain - 1)),
+          open_(static_cast<size_t>(nx) * ny) {}
+
+    // 按时间顺序调用；关闭的链交给 emit(const Chain&)
+    template <class Emit>
+    void Process(const ChainHit& h, Emit&& emit) {
+        if (h.x >= nx_ || h.y >= ny_) return;
+        if (h.implant) {
+            if (h.x < x_lo_ || h.x >= x_hi_ || h.e < w_.er_e_min || h.e > w_.er_e_max) return;
+            std::vector<Open>& q = open_[Index(h.x, h.y)];
+            Expire(q, h.ts, emit);
+            if (static_cast<int>(q.size()) >= w_.max_open) {
+                Close(q.front(), emit);
+                q.erase(q.begin());
+            }
+            Open o;
+            o.c.n = 1;
+            o.c.hit[0] = h;
+            o.c.type[0] = kER;
+            o.deadline = Deadline(o.c);
+            q.push_back(o);
+            return;
+        }
+
+        if (h.x + w_.pos_win < x_lo_ || h.x >= x_hi_ + w_.pos_win) return;
+        const int x0 = std::max(0, h.x - w_.pos_win), x1 = std::min(nx_ - 1, h.x + w_.pos_win);
+        const int y0 = std::max(0, h.y - w_.pos_win), y1 = std::min(ny_ - 1, h.y + w_.pos_win);
+        for (int x = std::max(x0, x_lo_); x <= std::min(x1, x_hi_ - 1); ++x) {
+            for (int y = y0; y <= y1; ++y) {
+                std::vector<Open>& q = open_[Index(x, y)];
+                if (q.empty()) continue;
+                Expire(q, h.ts, emit);
+                for (size_t i = 0; i < q.size();) {
+                    const int n = q[i].c.n;
+                    if (Extend(q[i], h)) {
+                        Close(q[i], emit);
+                        q.erase(q.begin() + i);
+                        continue;
+                    }
+                    if (q[i].c.n != n) q[i].deadline = Deadline(q[i].c);
+                    ++i;
+                }
+            }
+        }
+    }
+
+    // now 之前已经不可能再延长的链全部关闭（run 结束时调用，链的输出不必等到像素再有事件）
+    template <class Emit>
+    void Sweep(uint64_t now, Emit&& emit) {
+        for (std::vector<Open>& q : open_) if (!q.empty()) Expire(q, now, emit);
+    }
+
+    // 关闭全部打开的链（时钟不连续 / 数据结束）
+    template <class Emit>
+    void Flush(Emit&& emit) {
+        for (std::vector<Open>& q : open_) {
+            for (Open& o : q) Close(o, emit);
+            q.clear();
+        }
+    }
+
+    size_t OpenCount() const {
+        size_t n = 0;
+        for (const std::vector<Open>& q : open_) n += q.size();
+        return n;
+    }
+
+private:
+    struct Open {
+        Chain c;
+        uint64_t deadline = 0; // 最后一个成员的时间 + 下一代可用的最大时间窗口
+    };
+
+    size_t Index(int x, int y) const { return static_cast<size_t>(x) * ny_ + y; }
+
+    uint64_t Deadline(const Chain& c) const {
+        const int k = c.n - 1; // 已有的 decay 代数
+        double dt = (k < n_steps_) ? w_.steps[k].dt_max : 0.0;
+        if (w_.allow_sf) dt = std::max(dt, w_.sf_dt_max);
+        return c.hit[c.n - 1].ts + static_cast<uint64_t>(dt);
+    }
+
+    template <class Emit>
+    void Close(const Open& o, Emit& emit) {
+        if (o.c.n >= w_.min_mul) emit(o.c);
+    }
+
+    template <class Emit>
+    void Expire(std::vector<Open>& q, uint64_t now, Emit& emit) {
+        size_t j = 0;
+        for (size_t i = 0; i < q.size(); ++i) {
+            if (q[i].deadline < now) Close(q[i], emit);
+            else q[j++] = q[i];
+        }
+        q.resize(j);
+    }
+
+    // decay h 能否作为链的下一代；能则追加。返回 true 表示链已完整（满或 SF），应关闭
+    bool Extend(Open& o, const ChainHit& h) const {
+        Chain& c = o.c;
+        const ChainHit& last = c.hit[c.n - 1];
+        if (h.ts < last.ts) return false;
+        const double dt = static_cast<double>(h.ts - last.ts);
+        const int k = c.n - 1;
+
+        uint8_t type = 0;
+        bool done = false;
+        if (k < n_steps_ && dt <= w_.steps[k].dt_max) {
+            const ChainStep& s = w_.steps[k];
+            if (h.ssd_pos < 0 && h.e >= s.e_min && h.e <= s.e_max) type = kAlpha;
+            else if (w_.allow_escape && h.ssd_pos >= 0 && h.e >= w_.esc_e_min && h.e <= w_.esc_e_max) type = kEscape;
+        }
+        if (!type && w_.allow_sf && h.e >= w_.sf_e_min && dt <= w_.sf_dt_max) {
+            type = kSF;
+            done = true;
+        }
+        if (!type) return false;
+
+        c.hit[c.n] = h;
+        c.type[c.n] = type;
+        ++c.n;
+        // α 代数用完后，允许 SF 时还要等一个 SF
+        return done || (c.n - 1 >= n_steps_ && !w_.allow_sf) || c.n >= kMaxChain;
+    }
+
+    ChainWindows w_;
+    int nx_, ny_;
+    int x_lo_, x_hi_;
+    int n_steps_;
+    std::vector<std::vector<Open>> open_; // [x * ny + y]，按 ER 时间排序
+};
+
+#endif
@@ -0,0 +1,411 @@
+#include "RandomCorr.h"
+#include "ChainBuilder.h"
+#include "Config.h"
+#include "PixelEventStore.h"
+#include "ROOT/TSeq.hxx"
+#include "ROOT/TThreadExecutor.hxx"
+#include "TFile.h"
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TTree.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+static constexpr int kMaxRateBins = 20000;
+static constexpr long long kTrialsPerBlock = 1 << 16;
+
+RandomCorr::RandomCorr(const PixelEventStore& store, const ChainWindows& w, double bin_s)
+    : store_(store), w_(w),
+      n_steps_(min<int>(static_cast<int>(w.steps.size()), kMaxChain - 1)), n_cls_(n_steps_ + 3),
+      nx_(store.NX()), ny_(store.NY()) {
+    t0_ = store.TMin();
+    const uint64_t range = (store.TMax() > t0_) ? store.TMax() - t0_ : 0;
+    bin_ns_ = max(bin_s * 1e9, static_cast<double>(range) / kMaxRateBins + 1.0);
+    nb_ = static_cast<int>(static_cast<double>(range) / bin_ns_) + 1;
+
+    for (int k = 0; k < n_steps_; ++k) {
+        span_ += static_cast<uint64_t>(w_.allow_sf ? max(w_.steps[k].dt_max, w_.sf_dt_max) : w_.steps[k].dt_max);
+    }
+    if (w_.allow_sf) span_ += static_cast<uint64_t>(w_.sf_dt_max);
+
+    // 一遍扫完索引：X 条分块并行，每块自己的时间箱计数与 implant 表，按块顺序合并
+    const size_t npix = static_cast<size_t>(nx_) * ny_;
+    pix_cnt_.assign(n_cls_ * npix, 0);
+    struct Part {
+        vector<long long> bin_cnt, bin_any;
+        vector<Implant> implants;
+    };
+    const int n_parts = min(nx_, 16);
+    vector<Part> parts(n_parts);
+    ROOT::TThreadExecutor pool(NUM_THREADS);
+    pool.Foreach([&](int ip) {
+        Part& part = parts[ip];
+        part.bin_cnt.assign(static_cast<size_t>(n_cls_) * nb_, 0);
+        part.bin_any.assign(nb_, 0);
+        for (int x = nx_ * ip / n_parts; x < nx_ * (ip + 1) / n_parts; ++x) {
+            for (int y = 0; y < ny_; ++y) {
+                long long* pc = &pix_cnt_[Pixel(x, y)];
+                for (const StoreEvent* ev = store_.Begin(x, y); ev != store_.End(x, y); ++ev) {
+                    const int b = Bin(ev->ts);
+                    ++part.bin_any[b];
+                    ChainHit h;
+                    if (!ChainBuilder::FromStore(w_, x, y, *ev, h)) continue;
+                    auto count = [&](int c) {
+                        pc[c * npix] += 1;
+                        ++part.bin_cnt[static_cast<size_t>(c) * nb_ + b];
+                    };
+                    // 与 Correlator::Extend 相同的归类；一个 decay 可以同时在几代 α 的窗口里
+                    if (h.implant) {
+                        count(0);
+                        part.implants.push_back({h.ts, h.e, h.x, h.y});
+                    } else if (h.ssd_pos >= 0) {
+                        if (w_.allow_escape && h.e >= w_.esc_e_min && h.e <= w_.esc_e_max) count(EscapeClass());
+                    } else {
+                        for (int k = 0; k < n_steps_; ++k) {
+                            if (h.e >= w_.steps[k].e_min && h.e <= w_.steps[k].e_max) count(AlphaClass(k));
+                        }
+                        if (w_.allow_sf && h.e >= w_.sf_e_min) count(SFClass());
+                    }
+                }
+            }
+        }
+    }, ROOT::TSeqI(n_parts));
+
+    bin_cnt_.assign(static_cast<size_t>(n_cls_) * nb_, 0);
+    vector<long long> bin_any(nb_, 0);
+    for (Part& part : parts) {
+        for (size_t i = 0; i < bin_cnt_.size(); ++i) bin_cnt_[i] += part.bin_cnt[i];
+        for (int b = 0; b < nb_; ++b) bin_any[b] += part.bin_any[b];
+        implants_.insert(implants_.end(), part.implants.begin(), part.implants.end());
+    }
+
+    // 活时间 = 有事件的箱；m_c(t) = 该箱 c 类计数 / 活箱平均计数
+    int n_live = 0;
+    for (int b = 0; b < nb_; ++b) n_live += (bin_any[b] > 0);
+    live_ns_ = n_live * bin_ns_;
+    mod_.assign(bin_cnt_.size(), 0.0);
+    for (int c = 0; c < n_cls_; ++c) {
+        long long total = 0;
+        for (int b = 0; b < nb_; ++b) total += bin_cnt_[static_cast<size_t>(c) * nb_ + b];
+        if (total == 0 || n_live == 0) continue;
+        const double mean = static_cast<double>(total) / n_live;
+        for (int b = 0; b < nb_; ++b) {
+            if (bin_any[b] > 0) mod_[static_cast<size_t>(c) * nb_ + b] = bin_cnt_[static_cast<size_t>(c) * nb_ + b] / mean;
+        }
+    }
+
+    // 位置窗口内求和，Rate() 只查表
+    nb_cnt_.assign(pix_cnt_.size(), 0.0);
+    const int win = w_.pos_win;
+    for (int c = 0; c < n_cls_; ++c) {
+        for (int x = 0; x < nx_; ++x) {
+            for (int y = 0; y < ny_; ++y) {
+                double sum = 0;
+                for (int xi = max(0, x - win); xi <= min(nx_ - 1, x + win); ++xi) {
+                    for (int yi = max(0, y - win); yi <= min(ny_ - 1, y + win); ++yi) sum += pix_cnt_[c * npix + Pixel(xi, yi)];
+                }
+                nb_cnt_[c * npix + Pixel(x, y)] = sum;
+            }
+        }
+    }
+}
+
+string RandomCorr::ClassName(int c) const {
+    if (c == 0) return "implant";
+    if (c == EscapeClass()) return "escape";
+    if (c == SFClass()) return "sf";
+    return "alpha" + to_string(c);
+}
+
+int RandomCorr::Bin(uint64_t t) const {
+    if (t <= t0_) return 0;
+    return min(nb_ - 1, static_cast<int>(static_cast<double>(t - t0_) / bin_ns_));
+}
+
+double RandomCorr::Rate(int c, int x, int y, uint64_t t) const {
+    if (live_ns_ <= 0 || c < 0 || c >= n_cls_ || x < 0 || x >= nx_ || y < 0 || y >= ny_) return 0.0;
+    const size_t npix = static_cast<size_t>(nx_) * ny_;
+    return nb_cnt_[c * npix + Pixel(x, y)] / live_ns_ * mod_[static_cast<size_t>(c) * nb_ + Bin(t)];
+}
+
+void RandomCorr::Analytic(int x, int y, uint64_t t, double* p_ge) const {
+    // 第 k 代在窗口内出现随机 α（或逃逸 α）的概率 q_k = 1 - exp(-μ_k)，每一代还可能被随机 SF 终止 (s)：
+    //   P(>= k+2) = Π_{j<k} q_j · [1 - (1 - q_k)(1 - s)]，α 代数用完后 P(>= n+2) = Π q_j · s
+    fill(p_ge, p_ge + kMaxChain + 1, 0.0);
+    p_ge[0] = p_ge[1] = 1.0;
+    const double s = w_.allow_sf ? -expm1(-Rate(SFClass(), x, y, t) * w_.sf_dt_max) : 0.0;
+    double prod = 1.0;
+    for (int k = 0; k < n_steps_; ++k) {
+        double r = Rate(AlphaClass(k), x, y, t);
+        if (w_.allow_escape) r += Rate(EscapeClass(), x, y, t);
+        const double q = -expm1(-r * w_.steps[k].dt_max);
+        p_ge[k + 2] = prod * (1.0 - (1.0 - q) * (1.0 - s));
+        prod *= q;
+    }
+    if (w_.allow_sf && n_steps_ + 2 <= kMaxChain) p_ge[n_steps_ + 2] = prod * s;
+}
+
+void RandomCorr::Expect(double* n_ge, vector<double>& per_bin) const {
+    fill(n_ge, n_ge + kMaxChain + 1, 0.0);
+    per_bin.assign(nb_, 0.0);
+    double p[kMaxChain + 1];
+    for (const Implant& im : implants_) {
+        Analytic(im.x, im.y, im.ts, p);
+        for (int m = 0; m <= kMaxChain; ++m) n_ge[m] += p[m];
+        per_bin[Bin(im.ts)] += p[2];
+    }
+}
+
+McResult RandomCorr::RunMC(long long n_trials, uint64_t seed, const vector<double>& half_life, int n_threads) const {
+    McResult res;
+    res.bin_trials.assign(nb_, 0);
+    res.bin_random.assign(nb_, 0);
+    if (implants_.empty() || n_trials <= 0) return res;
+    if (n_threads <= 0) n_threads = static_cast<int>(thread::hardware_concurrency());
+
+    // 局部几何：注入像素放在 (win, win)，只需要 (2·win + 1)^2 个像素的关联器
+    const int win = w_.pos_win;
+    const int nloc = 2 * win + 1;
+    ChainWindows wl = w_;
+    wl.min_mul = 1;  // 只有 ER 的链也交出来，才能统计成员数分布
+    vector<float> e_mid(n_steps_);
+    vector<double> tau(n_steps_, 0.0);
+    for (int k = 0; k < n_steps_; ++k) {
+        e_mid[k] = static_cast<float>(0.5 * (w_.steps[k].e_min + w_.steps[k].e_max));
+        if (k < static_cast<int>(half_life.size())) tau[k] = half_life[k] / log(2.0);
+    }
+
+    // trial 按固定大小的 block 分给线程；每个 block 的结果单独存，最后按 block 顺序合并
+    const long long n_blocks = (n_trials + kTrialsPerBlock - 1) / kTrialsPerBlock;
+    vector<McResult> blocks(n_blocks);
+    vector<atomic<long long>> bin_trials(nb_), bin_random(nb_);
+    const size_t n_impl = implants_.size();
+
+    ROOT::TThreadExecutor pool(n_threads);
+    pool.Foreach([&](int ib) {
+        McResult& br = blocks[ib];
+        Correlator corr(wl, nloc, nloc, 0, nloc);
+        Chain got;
+        auto emit = [&got](const Chain& c) { got = c; };
+        vector<ChainHit> bg, sig;
+        double p[kMaxChain + 1];
+
+        const long long first = ib * kTrialsPerBlock;
+        const long long last = min(n_trials, first + kTrialsPerBlock);
+        for (long long trial = first; trial < last; ++trial) {
+            CounterRng rng(seed, static_cast<uint64_t>(trial));
+            const Implant& at = implants_[rng.Next() % n_impl];  // 时刻
+            const Implant& px = implants_[rng.Next() % n_impl];  // 像素
+            const uint64_t t = at.ts;
+
+            // 注入像素附近 [t, t + span) 的实际 decay，坐标换成局部坐标
+            bg.clear();
+            for (int xi = max(0, px.x - win); xi <= min(nx_ - 1, px.x + win); ++xi) {
+                for (int yi = max(0, px.y - win); yi <= min(ny_ - 1, px.y + win); ++yi) {
+                    auto r = store_.Range(xi, yi, t, t + span_);
+                    for (const StoreEvent* ev = r.first; ev != r.second; ++ev) {
+                        ChainHit h;
+                        if (!ChainBuilder::FromStore(w_, xi - px.x + win, yi - px.y + win, *ev, h) || h.implant) continue;
+                        bg.push_back(h);
+                    }
+                }
+            }
+            sort(bg.begin(), bg.end(), [](const ChainHit& a, const ChainHit& b) {
+                return a.ts != b.ts ? a.ts < b.ts : a.entry < b.entry;
+            });
+
+            ChainHit er{};
+            er.ts = t;
+            er.entry = -1;
+            er.e = px.e;
+            er.run = -1;
+            er.ssd_pos = -1;
+            er.x = er.y = static_cast<uint8_t>(win);
+            er.implant = 1;
+
+            // 1. 只有随机事件
+            got.n = 0;
+            corr.Process(er, emit);
+            for (const ChainHit& h : bg) corr.Process(h, emit);
+            corr.Flush(emit);
+            const int mul = got.n;
+            ++br.mul_bg[mul];
+            Analytic(px.x, px.y, t, p);
+            for (int m = 0; m <= kMaxChain; ++m) br.ana_ge[m] += p[m];
+            const int b = Bin(t);
+            bin_trials[b].fetch_add(1, memory_order_relaxed);
+            if (mul >= 2) bin_random[b].fetch_add(1, memory_order_relaxed);
+
+            // 2. 再注入一条真实衰变链（同一像素，指数分布的衰变时间）
+            if (tau.empty() || tau[0] <= 0) continue;
+            sig = bg;
+            uint64_t tk = t;
+            for (int k = 0; k < n_steps_ && tau[k] > 0; ++k) {
+                tk += static_cast<uint64_t>(-tau[k] * log1p(-rng.Uniform()));
+                if (tk >= t + span_) break;
+                ChainHit d = er;
+                d.ts = tk;
+                d.e = e_mid[k];
+                d.implant = 0;
+                sig.insert(upper_bound(sig.begin(), sig.end(), d, [](const ChainHit& a, const ChainHit& h) {
+                    return a.ts < h.ts;
+                }), d);
+            }
+            got.n = 0;
+            corr.Process(er, emit);
+            for (const ChainHit& h : sig) corr.Process(h, emit);
+            corr.Flush(emit);
+            bool random_member = false;
+            for (int i = 1; i < got.n; ++i) random_member |= (got.hit[i].entry >= 0);
+            if (random_member) ++br.sig_contaminated;
+            else if (got.n == 1 + n_steps_) ++br.sig_clean;
+            else ++br.sig_incomplete;
+        }
+        br.n_trials = last - first;
+    }, ROOT::TSeqI(static_cast<int>(n_blocks)));
+
+    for (const McResult& br : blocks) {
+        res.n_trials += br.n_trials;
+        for (int m = 0; m <= kMaxChain; ++m) {
+            res.mul_bg[m] += br.mul_bg[m];
+            res.ana_ge[m] += br.ana_ge[m];
+        }
+        res.sig_clean += br.sig_clean;
+        res.sig_contaminated += br.sig_contaminated;
+        res.sig_incomplete += br.sig_incomplete;
+    }
+    for (int b = 0; b < nb_; ++b) {
+        res.bin_trials[b] = bin_trials[b].load();
+        res.bin_random[b] = bin_random[b].load();
+    }
+    return res;
+}
+
+long long RandomCorr::AnnotateChains(const string& chain_file, const string& out_file) const {
+    TFile fin(chain_file.c_str(), "READ");
+    if (fin.IsZombie()) return -1;
+    TTree* tin = dynamic_cast<TTree*>(fin.Get(CHAIN_TREE_NAME));
+    if (!tin) return -1;
+
+    UInt_t    mul = 0;
+    Double_t  xch[kMaxChain], ych[kMaxChain];
+    ULong64_t ts[kMaxChain];
+    Int_t     type[kMaxChain];
+    tin->SetBranchAddress("chain_mul", &mul);
+    tin->SetBranchAddress("DSSDX_Ch", xch);
+    tin->SetBranchAddress("DSSDY_Ch", ych);
+    tin->SetBranchAddress("Ts", ts);
+    tin->SetBranchAddress("type", type);
+
+    TFile fout(out_file.c_str(), "RECREATE");
+    if (fout.IsZombie()) return -1;
+    TTree tout(PROB_TREE_NAME, "random-correlation probability per chain member (friend of tr_chain)");
+    // mu_rand[k] / p_rand[k]：成员 k 是随机事件的期望数 / 概率（[0] 为 ER，记 0）；P_rand = 至少一个成员随机的概率
+    UInt_t   omul = 0;
+    Double_t mu[kMaxChain], pr[kMaxChain], p_chain = 0;
+    tout.Branch("chain_mul", &omul, "chain_mul/i");
+    tout.Branch("mu_rand", mu, "mu_rand[chain_mul]/D");
+    tout.Branch("p_rand", pr, "p_rand[chain_mul]/D");
+    tout.Branch("P_rand", &p_chain, "P_rand/D");
+
+    const Long64_t n = tin->GetEntries();
+    for (Long64_t i = 0; i < n; ++i) {
+        tin->GetEntry(i);
+        omul = min<UInt_t>(mul, kMaxChain);
+        const int x = static_cast<int>(xch[0]), y = static_cast<int>(ych[0]);
+        double p_none = 1.0;
+        mu[0] = pr[0] = 0.0;
+        for (UInt_t k = 1; k < omul; ++k) {
+            int c = -1;
+            if (type[k] == kAlpha && static_cast<int>(k) - 1 < n_steps_) c = AlphaClass(k - 1);
+            else if (type[k] == kEscape) c = EscapeClass();
+            else if (type[k] == kSF) c = SFClass();
+            const double dt = (ts[k] > ts[k - 1]) ? static_cast<double>(ts[k] - ts[k - 1]) : 0.0;
+            mu[k] = Rate(c, x, y, ts[k - 1]) * dt;
+            pr[k] = -expm1(-mu[k]);
+            p_none *= 1.0 - pr[k];
+        }
+        p_chain = 1.0 - p_none;
+        tout.Fill();
+    }
+    fout.cd();
+    tout.Write();
+    fout.Close();
+    return n;
+}
+
+bool RandomCorr::Write(const string& file, const double* n_ge, const vector<double>& per_bin, const McResult& mc) const {
+    TFile f(file.c_str(), "RECREATE");
+    if (f.IsZombie()) return false;
+    const size_t npix = static_cast<size_t>(nx_) * ny_;
+    const double t_max_s = nb_ * bin_ns_ * 1e-9;
+
+    // 计数率：逐像素 (全程平均) 与整个探测器随时间 (1/s)
+    for (int c = 0; c < n_cls_; ++c) {
+        const string name = ClassName(c);
+        TH2D h2(("h2_rate_" + name).c_str(), (name + " rate per pixel;X strip;Y strip;rate (1/s)").c_str(),
+                nx_, 0, nx_, ny_, 0, ny_);
+        TH1D ht(("h_rate_vs_t_" + name).c_str(), (name + " rate, whole DSSD;t - t_{0} (s);rate (1/s)").c_str(),
+                nb_, 0, t_max_s);
+        for (int x = 0; x < nx_; ++x) {
+            for (int y = 0; y < ny_; ++y) {
+                if (live_ns_ > 0) h2.SetBinContent(x + 1, y + 1, pix_cnt_[c * npix + Pixel(x, y)] / (live_ns_ * 1e-9));
+            }
+        }
+        for (int b = 0; b < nb_; ++b) ht.SetBinContent(b + 1, bin_cnt_[static_cast<size_t>(c) * nb_ + b] / (bin_ns_ * 1e-9));
+        h2.Write();
+        ht.Write();
+    }
+
+    // 解析期望
+    TH1D h_exp("h_expect_random", "expected random chains (analytic, all implants);chain_mul >= m;chains",
+               kMaxChain, 1.5, kMaxChain + 1.5);
+    for (int m = 2; m <= kMaxChain; ++m) h_exp.SetBinContent(m - 1, n_ge[m]);
+    h_exp.Write();
+    TH1D h_exp_t("h_expect_random_vs_t", "expected random ER-#alpha (analytic) per time bin;t - t_{0} (s);chains",
+                 nb_, 0, t_max_s);
+    for (int b = 0; b < nb_; ++b) h_exp_t.SetBinContent(b + 1, per_bin[b]);
+    h_exp_t.Write();
+
+    // MC 与同一批 trial 的解析值
+    if (mc.n_trials > 0) {
+        const double n = static_cast<double>(mc.n_trials);
+        TH1D h_mc("h_mc_prob_ge", "P(random chain_mul >= m), MC;m;probability", kMaxChain, 1.5, kMaxChain + 1.5);
+        TH1D h_ana("h_ana_prob_ge", "P(random chain_mul >= m), analytic (same trials);m;probability",
+                   kMaxChain, 1.5, kMaxChain + 1.5);
+        long long ge = 0;
+        for (int m = kMaxChain; m >= 2; --m) {
+            ge += mc.mul_bg[m];
+            h_mc.SetBinContent(m - 1, ge / n);
+            h_mc.SetBinError(m - 1, sqrt(static_cast<double>(ge)) / n);
+            h_ana.SetBinContent(m - 1, mc.ana_ge[m] / n);
+        }
+        h_mc.Write();
+        h_ana.Write();
+
+        TH1D h_mc_t("h_mc_prob_vs_t", "P(random ER-#alpha), MC, by injection time;t - t_{0} (s);probability",
+                    nb_, 0, t_max_s);
+        for (int b = 0; b < nb_; ++b) {
+            if (mc.bin_trials[b] == 0) continue;
+            h_mc_t.SetBinContent(b + 1, static_cast<double>(mc.bin_random[b]) / mc.bin_trials[b]);
+            h_mc_t.SetBinError(b + 1, sqrt(static_cast<double>(mc.bin_random[b])) / mc.bin_trials[b]);
+        }
+        h_mc_t.Write();
+
+        TH1D h_sig("h_mc_injected", "injected chains;;fraction", 3, 0, 3);
+        h_sig.GetXaxis()->SetBinLabel(1, "clean");
+        h_sig.GetXaxis()->SetBinLabel(2, "contaminated");
+        h_sig.GetXaxis()->SetBinLabel(3, "incomplete");
+        h_sig.SetBinContent(1, mc.sig_clean / n);
+        h_sig.SetBinContent(2, mc.sig_contaminated / n);
+        h_sig.SetBinContent(3, mc.sig_incomplete / n);
+        h_sig.Write();
+    }
+    f.Close();
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef RANDOM_CORR_H
+#define RANDOM_CORR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Correlator.h"
+
+class PixelEventStore;
+
+// 计数器型随机数流：第 i 个数 = Mix64(key + i·φ)（同 A80_fixedN_final_package/A80Types.h 的 Mix64），
+// key 只由 (种子, trial 号) 决定，结果与线程数、trial 的执行顺序无关
+struct CounterRng {
+    static uint64_t Mix64(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+    CounterRng(uint64_t seed, uint64_t trial) : key(Mix64(seed) ^ Mix64(trial + 1)) {}
+    uint64_t Next() { return Mix64(key + 0x9e3779b97f4a7c15ULL * ++ctr); }
+    double Uniform() { return static_cast<double>(Next() >> 11) * 0x1.0p-53; } // [0, 1)
+
+    uint64_t key;
+    uint64_t ctr = 0;
+};
+
+// MC 结果（整数计数与线程数无关；解析值按 block 顺序求和，同样可复现）
+struct McResult {
+    long long n_trials = 0;
+    long long mul_bg[kMaxChain + 1] = {};  // 只有随机事件时注入 ER 的链成员数（1 = 只有 ER）
+    double    ana_ge[kMaxChain + 1] = {};  // 同一批 trial 的解析 P(成员数 >= m) 之和
+    long long sig_clean = 0;               // 注入真实衰变：链完整且全部是注入的成员
+    long long sig_contaminated = 0;        //               链里有随机事件
+    long long sig_incomplete = 0;          //               没有随机事件，但真实衰变超出窗口、链不完整
+    std::vector<long long> bin_trials, bin_random; // 按注入时刻分箱：trial 数、随机成链 (>= 2) 数
+};
+
+// 随机关联：由像素事件索引得到随时间变化的逐像素计数率，给出
+//   - 解析期望：时刻 t、像素 p 上的一个 ER 被随机事件凑成 >= m 个成员的链的概率，以及整个数据集的随机链期望数
+//   - MC：注入合成 ER（及合成衰变），和实际事件一起重新走 Correlator 的窗口
+//   - 已有 tr_chain 每个成员的随机概率（友树）
+// 计数率模型 r_c(p, t) = N_c(p ± pos_win) / T_live × m_c(t)，m_c(t) 为整个探测器 c 类计数率在 RATE_BIN_S
+// 分箱里相对全程平均的比值（没有任何事件的箱算死时间）。c：implant、每代 α、逃逸 α、SF，选择同 ChainBuilder。
+class RandomCorr {
+public:
+    RandomCorr(const PixelEventStore& store, const ChainWindows& w, double bin_s);
+
+    int NumClasses() const { return n_cls_; }
+    std::string ClassName(int c) const;
+    long long NumImplants() const { return static_cast<long long>(implants_.size()); }
+    double LiveSeconds() const { return live_ns_ * 1e-9; }
+
+    // 像素 (x, y) ± pos_win 内 c 类事件在时刻 t 的计数率 (1/ns)
+    double Rate(int c, int x, int y, uint64_t t) const;
+    // 时刻 t 在 (x, y) 的一个 ER 被随机事件凑成 >= m 个成员的链的概率 p_ge[m]，m = 0..kMaxChain
+    void Analytic(int x, int y, uint64_t t, double* p_ge) const;
+    // 对每个实际 implant 求和：n_ge[m] = 随机凑成 >= m 个成员的链的期望数；per_bin = 每个时间箱的 n_ge[2]
+    void Expect(double* n_ge, std::vector<double>& per_bin) const;
+
+    McResult RunMC(long long n_trials, uint64_t seed, const std::vector<double>& half_life, int n_threads) const;
+
+    // chain_file 的 tr_chain -> out_file 的友树：成员 k 的 μ = r(ER 像素, Ts[k-1]) × Δt_k，p = 1 - exp(-μ)；
+    // 返回链数，文件打不开返回 -1
+    long long AnnotateChains(const std::string& chain_file, const std::string& out_file) const;
+
+    bool Write(const std::string& file, const double* n_ge, const std::vector<double>& per_bin, const McResult& mc) const;
+
+private:
+    struct Implant {
+        uint64_t ts;
+        float e;
+        uint8_t x, y;
+    };
+
+    int AlphaClass(int k) const { return 1 + k; }
+    int EscapeClass() const { return 1 + n_steps_; }
+    int SFClass() const { return 2 + n_steps_; }
+    int Bin(uint64_t t) const;
+    size_t Pixel(int x, int y) const { return static_cast<size_t>(x) * ny_ + y; }
+
+    const PixelEventStore& store_;
+    ChainWindows w_;
+    int n_steps_, n_cls_;
+    int nx_, ny_;
+    uint64_t t0_ = 0;
+    double bin_ns_ = 0;
+    int nb_ = 1;
+    double live_ns_ = 0;
+    uint64_t span_ = 0;                 // 一条链从 ER 开始最长可能的时间
+    std::vector<long long> pix_cnt_;    // [c * npix + p]
+    std::vector<double> nb_cnt_;        // [c * npix + p]，± pos_win 求和
+    std::vector<long long> bin_cnt_;    // [c * nb + b]
+    std::vector<double> mod_;           // [c * nb + b]，m_c(t)
+    std::vector<Implant> implants_;     // 全部实际 implant，按 (像素, 时间)
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "Config.h"
+#include "PixelEventStore.h"
+#include "ROOT/RDataFrame.hxx"
+#include "ROOT/RVec.hxx"
+#include "TString.h"
+#include "TSystem.h"
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace ROOT;
+
+// tr_map -> STORE_FILE（../common/PixelEventStore.h）：按像素分桶、桶内按时间排序的事件索引。
+// 每个 run 只读一遍、只在内存里放一个 run；之后 Chain_Build --store / Store_Query 不再扫 tr_map。
+// 用法：./Store_Build [输出文件]
+int main(int argc, char** argv) {
+    const string out = (argc > 1) ? argv[1] : STORE_FILE;
+    if (NUM_THREADS > 0) ROOT::EnableImplicitMT(NUM_THREADS);
+
+    cout << "=== Pixel event store: runs " << RUN_START << "-" << RUN_END << " -> " << out << " ===" << endl;
+    PixelEventStoreWriter writer(NUM_DSSDX_POS, NUM_DSSDY_POS, out + ".tmp");
+
+    int n_files = 0;
+    for (int run = RUN_START; run <= RUN_END; ++run) {
+        TString in = TString::Format(INPUT_DIR_PATTERN, run);
+        if (gSystem->AccessPathName(in)) continue;
+        ++n_files;
+
+        ROOT::RDataFrame df(TREE_NAME, in.Data());
+        vector<vector<pair<uint32_t, StoreEvent>>> slots(df.GetNSlots());
+        // 多线程下 rdfentry_ 不是 tr_map 的 entry：用任务区间起点 + 本槽计数还原（同一区间内按顺序读）
+        vector<pair<ULong64_t, ULong64_t>> cursor(df.GetNSlots(), {~0ULL, 0});
+        auto dfe = df.DefinePerSample("entry0", [](unsigned int, const RDF::RSampleInfo& id) { return id.EntryRange().first; });
+        dfe.ForeachSlot([&](unsigned int s, UShort_t xm, UShort_t ym, UShort_t vm, UShort_t mm, UShort_t sm,
+                           const RVec<double>& xe, const RVec<double>& xch, const RVec<double>& ych,
+                           const RVec<ULong64_t>& xts, const RVec<double>& se, const RVec<double>& sch,
+                           ULong64_t entry0) {
+            auto& c = cursor[s];
+            if (c.first != entry0) c = {entry0, entry0};
+            const ULong64_t entry = c.second++;
+            // 只要像素确定（X/Y 多重性 1）；其余条件留给查询方按 flags 选
+            if (xm != 1 || ym != 1 || xts.empty()) return;
+            if (xch[0] < 0 || xch[0] >= NUM_DSSDX_POS || ych[0] < 0 || ych[0] >= NUM_DSSDY_POS) return;
+            const bool ssd = (sm > 0 && !se.empty() && !sch.empty());
+            StoreEvent ev;
+            ev.ts      = xts[0];
+            ev.e       = static_cast<float>(xe[0]);
+            ev.ssd_e   = ssd ? static_cast<float>(se[0]) : 0.f;
+            ev.entry   = static_cast<uint32_t>(entry);
+            ev.run     = static_cast<uint16_t>(run);
+            ev.flags   = (mm > 0 ? kStoreMWPC : 0) | (sm > 0 ? kStoreSSD : 0) | (vm > 0 ? kStoreVeto : 0);
+            ev.ssd_pos = ssd ? static_cast<int8_t>(sch[0]) : -1;
+            slots[s].emplace_back(static_cast<uint32_t>(xch[0]) * NUM_DSSDY_POS + static_cast<uint32_t>(ych[0]), ev);
+        }, {"DSSDX_mul", "DSSDY_mul", "Veto_mul", "MWPC_mul", "SSD_mul",
+            "DSSDX_E", "DSSDX_Ch", "DSSDY_Ch", "DSSDX_Ts", "SSD_E", "SSD_Ch", "entry0"});
+
+        vector<pair<uint32_t, StoreEvent>> events;
+        for (auto& v : slots) { events.insert(events.end(), v.begin(), v.end()); vector<pair<uint32_t, StoreEvent>>().swap(v); }
+        if (!writer.AddRun(events)) {
+            cerr << "[ERROR] Cannot write temporary file " << out << ".tmp" << endl;
+            return 1;
+        }
+        cout << "--> run " << run << ": " << events.size() << " events" << endl;
+    }
+    if (n_files == 0) {
+        cerr << "[ERROR] No input files found." << endl;
+        return 1;
+    }
+
+    if (!writer.Finish(out, NUM_THREADS)) {
+        cerr << "[ERROR] Cannot write " << out << endl;
+        return 1;
+    }
+    cout << "=== Store done: " << writer.Count() << " events in " << out << " ===" << endl;
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "Config.h"
+#include "PixelEventStore.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// 从一个候选 α (X, Y, Ts) 往回找 implant（../common/PixelEventStore.h，mmap 读，不扫 tr_map）
+// 用法：./Store_Query X Y TS_NS [--store FILE] [--back NS] [--win N] [--all]
+//   --back  往回看的时间 (ns，默认 CHAIN_STEPS[0] 的时间窗口)
+//   --win   位置窗口 (条，默认 POS_WIN)
+//   --all   列出窗口内全部 implant（默认只给最近的一个）
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " X Y TS_NS [--store FILE] [--back NS] [--win N] [--all]" << endl;
+        return 1;
+    }
+    const int x = atoi(argv[1]), y = atoi(argv[2]);
+    const uint64_t t = strtoull(argv[3], nullptr, 10);
+    string file = STORE_FILE;
+    uint64_t back = static_cast<uint64_t>(CHAIN_STEPS.empty() ? 10e9 : CHAIN_STEPS[0].dt_max);
+    int win = POS_WIN;
+    bool all = false;
+    for (int i = 4; i < argc; ++i) {
+        if      (!strcmp(argv[i], "--store") && i + 1 < argc) file = argv[++i];
+        else if (!strcmp(argv[i], "--back") && i + 1 < argc)  back = static_cast<uint64_t>(atof(argv[++i]));
+        else if (!strcmp(argv[i], "--win") && i + 1 < argc)   win = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--all"))                   all = true;
+        else { cerr << "[ERROR] unknown option " << argv[i] << endl; return 1; }
+    }
+
+    auto store = PixelEventStore::Open(file);
+    if (!store) {
+        cerr << "[ERROR] Cannot open store " << file << " (run Store_Build first)" << endl;
+        return 1;
+    }
+
+    // implant 与 ChainBuilder 相同：MWPC 有、SSD/Veto 无，能量在 ER 窗口内
+    auto is_implant = [](const StoreEvent& ev) {
+        return (ev.flags & kStoreMWPC) && !(ev.flags & (kStoreSSD | kStoreVeto)) && ev.e >= ER_E_MIN && ev.e <= ER_E_MAX;
+    };
+    auto print = [&](int px, int py, const StoreEvent& ev) {
+        cout << "  run " << ev.run << " entry " << ev.entry << "  pixel (" << px << "," << py << ")  E = " << ev.e
+             << " keV  dT = " << (t - ev.ts) / 1e6 << " ms" << endl;
+    };
+
+    const auto t0 = chrono::steady_clock::now();
+    int n = 0;
+    if (all) {
+        store->ForEach(x, y, win, t > back ? t - back : 0, t, [&](int px, int py, const StoreEvent& ev) {
+            if (is_implant(ev)) { print(px, py, ev); ++n; }
+        });
+    } else {
+        int px = -1, py = -1;
+        const StoreEvent* ev = store->LookBack(x, y, win, t, back, is_implant, &px, &py);
+        if (ev) { print(px, py, *ev); ++n; }
+    }
+    const double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+    cout << "--> " << n << " implant(s) within " << back / 1e9 << " s and +-" << win << " strip(s); query " << us << " us" << endl;
+    return 0;
+}
@@ -1,17 +1,24 @@
 // PerChannelCalibrator.cpp (robust per-channel 3-peak calibration)
 // Build:
-//   g++ -O2 -std=c++17 PerChannelCalibrator.cpp $(root-config --cflags --libs) -lSpectrum -o PerChannelCalibrator
+//   g++ -O2 -std=c++17 -I../common PerChannelCalibrator.cpp $(root-config --cflags --libs) -lSpectrum -o PerChannelCalibrator
 //
 // Run:
 //   ./PerChannelCalibrator preselected.root tr_map originalSpectrum.root calibratedSpectrum.root ener_cal.dat
 
+#include "GausFit.h"
+#include "HistBank.h"
+#include "LineMatch.h"
+
 #include <ROOT/RDataFrame.hxx>
 #include <ROOT/RVec.hxx>
+#include <ROOT/TSeq.hxx>
+#include <ROOT/TThreadExecutor.hxx>
 
 #include <TFile.h>
 #include <TH1D.h>
 #include <TSpectrum.h>
-#include <TF1.h>
+#include <TString.h>
+#include <TTree.h>
 
 #include <algorithm>
 #include <array>
@@ -54,8 +61,11 @@ static constexpr double SIGMA_MAX  = 200.0;
 
 // peak selection constraints (ADC)
 static constexpr double MIN_PEAK_SEP = 10.0;   // min separation between picked peaks
-static constexpr double MAX_PEAK_SEP = 250.0;  // max separation (within dynamic window)
-static constexpr double RATIO_TOL    = 0.6;    // require d2/d1 in [1-0.6, 1+0.6]
+
+// peak identification (LineMatch.h): E = k*ADC + b with k in [K_MIN, K_MAX] (below)
+// a TSpectrum peak matches a line if |E_line - (k*x + b)| <= LM_TOL_KEV + k*LM_TOL_ADC
+static constexpr double LM_TOL_KEV = 10.0;
+static constexpr double LM_TOL_ADC = 3.0;
 
 // min counts in fit window (integral)
 static constexpr double MIN_WIN_COUNTS = 30.0;
@@ -89,133 +99,97 @@ struct PeakFitResult {
   double chi2ndf = 0.0;
 };
 
-static PeakFitResult FitPeakTwoStage(TH1D* h, double seed, double coarseWin) {
-  PeakFitResult r;
-  if (!h) return r;
-
-  // 1) coarse fit in [seed-coarseWin, seed+coarseWin]
-  double x1 = seed - coarseWin;
-  double x2 = seed + coarseWin;
-  if (x2 <= x1) return r;
-
-  int b1 = h->FindBin(x1);
-  int b2 = h->FindBin(x2);
-  double sum = h->Integral(b1, b2);
-  if (sum < MIN_WIN_COUNTS) return r;
-
-  TF1 f1("f1", "gaus(0)", x1, x2);
-  f1.SetParameters(h->GetMaximum(), seed, 8.0);
-  f1.SetParLimits(1, seed - coarseWin, seed + coarseWin);
-  f1.SetParLimits(2, SIGMA_MIN, SIGMA_MAX);
-
-  if (h->Fit(&f1, "QNR") != 0) return r;
-
-  double mu1 = f1.GetParameter(1);
-  double s1  = std::fabs(f1.GetParameter(2));
-  if (!std::isfinite(mu1) || !std::isfinite(s1) || s1 <= 0) return r;
-
-  // 2) refine fit in [mu1-1sigma, mu1+1sigma] (minimum 8 ADC half-window)
-  double w = std::max(8.0, 1.0 * s1);
-  double y1 = mu1 - w;
-  double y2 = mu1 + w;
-
-  TF1 f2("f2", "gaus(0)", y1, y2);
-  f2.SetParameters(f1.GetParameter(0), mu1, s1);
-  f2.SetParLimits(1, mu1 - w, mu1 + w);
-  f2.SetParLimits(2, SIGMA_MIN, SIGMA_MAX);
-
-  if (h->Fit(&f2, "QNR") != 0) return r;
-
-  double mu2 = f2.GetParameter(1);
-  double s2  = std::fabs(f2.GetParameter(2));
-  double chi2ndf = (f2.GetNDF() > 0) ? (f2.GetChisquare() / f2.GetNDF()) : 0.0;
-
-  if (!std::isfinite(mu2) || !std::isfinite(s2) || s2 <= 0) return r;
-
-  r.ok = true;
-  r.mu = mu2;
-  r.sigma = s2;
-  r.chi2ndf = chi2ndf;
-  return r;
+// Native fitter (GausFit.h): same Neyman chi2 / "R" bin selection as TH1::Fit "QNR", thread-safe.
+static GausFitTask HistTask(TH1D* h, double x1, double x2) {
+  GausFitTask t;
+  t.y   = h->GetArray() + 1;
+  t.n   = h->GetNbinsX();
+  t.xlo = h->GetXaxis()->GetXmin();
+  t.xhi = h->GetXaxis()->GetXmax();
+  t.lo  = x1;
+  t.hi  = x2;
+  t.sigmaMin = SIGMA_MIN;
+  t.sigmaMax = SIGMA_MAX;
+  return t;
 }
 
-struct CandPeak {
-  double x = 0.0;
-  double h = 0.0;
-};
-
-static bool ChooseBestTriplet(TH1D* hist,
-                              const std::vector<CandPeak>& cands,
-                              std::array<double,3>& seeds_out) {
-  if (!hist) return false;
-  if (cands.size() < 3) return false;
+// Two-stage fit of the three seeds; each stage is one batch of fits.
+static std::array<PeakFitResult,3> FitPeaksTwoStage(TH1D* h, const std::array<double,3>& seed, double coarseWin) {
+  std::array<PeakFitResult,3> r{};
+  if (!h || coarseWin <= 0) return r;
 
-  // Use top M candidates by height
-  std::vector<CandPeak> top = cands;
-  std::sort(top.begin(), top.end(), [](const CandPeak& a, const CandPeak& b){
-    return a.h > b.h;
-  });
-  const int M = std::min<int>((int)top.size(), 12);
-  top.resize(M);
-
-  double bestScore = -1e99;
-  std::array<double,3> best = {0,0,0};
-
-  for (int i=0;i<M;i++){
-    for (int j=i+1;j<M;j++){
-      for (int k=j+1;k<M;k++){
-        // sort by x
-        std::array<CandPeak,3> t = {top[i], top[j], top[k]};
-        std::sort(t.begin(), t.end(), [](const CandPeak& a, const CandPeak& b){ return a.x < b.x; });
-
-        double x1=t[0].x, x2=t[1].x, x3=t[2].x;
-        double d1=x2-x1, d2=x3-x2;
-        if (d1 < MIN_PEAK_SEP || d2 < MIN_PEAK_SEP) continue;
-        if (d1 > MAX_PEAK_SEP || d2 > MAX_PEAK_SEP) continue;
-
-        double ratio = d2/d1;
-        if (ratio < (1.0 - RATIO_TOL) || ratio > (1.0 + RATIO_TOL)) continue;
-
-        double sumH = t[0].h + t[1].h + t[2].h;
-        // prefer ratio close to 1
-        double penalty = std::fabs(ratio - 1.0);
-        double score = sumH / (1.0 + 5.0*penalty);
-
-        if (score > bestScore){
-          bestScore = score;
-          best = {x1,x2,x3};
-        }
-      }
-    }
+  // 1) coarse fit in [seed-coarseWin, seed+coarseWin]
+  std::vector<GausFitTask> tasks;
+  std::vector<int> idx;
+  const double hMax = h->GetMaximum();
+  for (int i = 0; i < 3; ++i) {
+    double x1 = seed[i] - coarseWin;
+    double x2 = seed[i] + coarseWin;
+    double sum = h->Integral(h->FindBin(x1), h->FindBin(x2));
+    if (sum < MIN_WIN_COUNTS) continue;
+
+    GausFitTask t = HistTask(h, x1, x2);
+    t.A0 = hMax; t.mu0 = seed[i]; t.sigma0 = 8.0;
+    t.muMin = seed[i] - coarseWin;
+    t.muMax = seed[i] + coarseWin;
+    tasks.push_back(t);
+    idx.push_back(i);
   }
+  std::vector<GausFitResult> f1 = FitGausBatch(tasks);
 
-  if (bestScore < -1e50) return false;
-  seeds_out = best;
-  return true;
+  // 2) refine fit in [mu1-1sigma, mu1+1sigma] (minimum 8 ADC half-window)
+  std::vector<GausFitTask> tasks2;
+  std::vector<int> idx2;
+  for (size_t k = 0; k < f1.size(); ++k) {
+    if (!f1[k].ok()) continue;
+    double mu1 = f1[k].mu;
+    double s1  = std::fabs(f1[k].sigma);
+    if (!std::isfinite(mu1) || !std::isfinite(s1) || s1 <= 0) continue;
+
+    double w = std::max(8.0, 1.0 * s1);
+    GausFitTask t = HistTask(h, mu1 - w, mu1 + w);
+    t.A0 = f1[k].A; t.mu0 = mu1; t.sigma0 = s1;
+    t.muMin = mu1 - w;
+    t.muMax = mu1 + w;
+    tasks2.push_back(t);
+    idx2.push_back(idx[k]);
+  }
+  std::vector<GausFitResult> f2 = FitGausBatch(tasks2);
+
+  for (size_t k = 0; k < f2.size(); ++k) {
+    if (!f2[k].ok()) continue;
+    double mu2 = f2[k].mu;
+    double s2  = std::fabs(f2[k].sigma);
+    if (!std::isfinite(mu2) || !std::isfinite(s2) || s2 <= 0) continue;
+
+    PeakFitResult& p = r[idx2[k]];
+    p.ok = true;
+    p.mu = mu2;
+    p.sigma = s2;
+    p.chi2ndf = f2[k].chi2ndf();
+  }
+  return r;
 }
 
-static bool FindTop3PeaksRobust(TH1D* h, std::array<double,3>& seeds_out) {
+// TSpectrum candidates over the whole spectrum -> LineMatch (k, b) Hough search against EREF.
+// No search window or spacing heuristic: the three lines must line up under one gain/offset.
+static bool FindTop3PeaksRobust(TH1D* h, std::array<double,3>& seeds_out, double& conf) {
   seeds_out = {0,0,0};
+  conf = 0.0;
   if (!h) return false;
   if (h->GetEntries() < 200) return false;
 
-  // Dynamic search window centered at maximum bin
-  double xMax = h->GetXaxis()->GetBinCenter(h->GetMaximumBin());
-  double winL = std::max(RAW_MIN, xMax - 250.0);
-  double winR = std::min(RAW_MAX, xMax + 250.0);
-  if (winR <= winL) return false;
-
   TSpectrum sp(TS_MAX_PEAKS);
-  int nfound = sp.Search(h, TS_SIGMA_BINS, "nobackground", TS_THRESHOLD);
+  // goff: no polymarker/drawing on h, so channels can be searched on worker threads
+  int nfound = sp.Search(h, TS_SIGMA_BINS, "nobackground goff", TS_THRESHOLD);
   if (nfound <= 0) return false;
 
-  std::vector<CandPeak> cands;
+  std::vector<LinePeak> cands;
   cands.reserve(nfound);
 
   double* xpos = sp.GetPositionX();
   for (int i=0;i<nfound;i++){
     double x = xpos[i];
-    if (x < winL || x > winR) continue;
     double hh = h->GetBinContent(h->FindBin(x));
     if (hh <= 0) continue;
     cands.push_back({x, hh});
@@ -223,8 +197,18 @@ static bool FindTop3PeaksRobust(TH1D* h, std::array<double,3>& seeds_out) {
 
   if (cands.size() < 3) return false;
 
-  // choose best triplet
-  if (!ChooseBestTriplet(h, cands, seeds_out)) return false;
+  std::vector<RefLine> lines;
+  for (double e : EREF) lines.push_back({e, LM_TOL_KEV});
+  LineMatchOptions opt;
+  opt.kMin = K_MIN;
+  opt.kMax = K_MAX;
+  opt.tolX = LM_TOL_ADC;
+  opt.minMatched = 3;
+  LineMatchResult m = MatchLines(cands, lines, opt);
+  if (!m.ok) return false;
+
+  seeds_out = {m.x[0], m.x[1], m.x[2]};
+  conf = m.confidence;
 
   // ensure ascending
   std::sort(seeds_out.begin(), seeds_out.end());
@@ -264,6 +248,7 @@ struct CalibRow {
   double b = FAIL_B;
   double fwhm = FAIL_FWHM;
   double chi2ndf = FAIL_CHI2; // use chi2/ndf of refined 5804.8 peak fit
+  double match_conf = 0.0;    // LineMatch confidence of the peak identification
   int ok = 0;
 };
 
@@ -271,6 +256,85 @@ static void WriteFail(std::ofstream& out, CalibRow& row){
   out << row.ch << " " << FAIL_B << " " << FAIL_K << " " << FAIL_FWHM << " " << FAIL_CHI2 << "\n";
 }
 
+// One channel: seeds -> two-stage fits -> line -> FWHM -> calibrated spectrum.
+// Only reads h and builds its own TSpectrum/fit objects, so channels can run in parallel.
+// On failure the returned row keeps the FAIL_* defaults (ok = 0) and hcal stays empty.
+static CalibRow CalibrateChannel(int ch, TH1D* h, std::unique_ptr<TH1D>& hcal) {
+  CalibRow row;
+  row.ch = ch;
+
+  if (!h || h->GetEntries() < 300) return row;
+
+  // 1) robust peak seeds (line matching against EREF)
+  std::array<double,3> seed{};
+  if (!FindTop3PeaksRobust(h, seed, row.match_conf)) return row;
+
+  // 2) two-stage gaussian refine
+  std::array<PeakFitResult,3> pf = FitPeaksTwoStage(h, seed, COARSE_WIN);
+  bool okPeaks = pf[0].ok && pf[1].ok && pf[2].ok;
+  if (!okPeaks) return row;
+
+  // 3) sort refined peaks by mu asc
+  std::array<double,3> adc = {pf[0].mu, pf[1].mu, pf[2].mu};
+  std::sort(adc.begin(), adc.end());
+
+  // spacing sanity (avoid duplicate/shoulder)
+  if ((adc[1]-adc[0] < MIN_PEAK_SEP) || (adc[2]-adc[1] < MIN_PEAK_SEP)) return row;
+
+  // 4) line fit E = k*ADC + b + residual sanity
+  double k=FAIL_K, b=FAIL_B, maxResid=1e9;
+  if (!FitLine3pt(adc, k, b, maxResid)) return row;
+
+  // k sanity
+  if (!std::isfinite(k) || k < K_MIN || k > K_MAX) return row;
+  // residual sanity
+  if (maxResid > MAX_RESID_KEV) return row;
+
+  // 5) choose the highest-ADC refined peak as 5804.8 reference
+  int i_hi = 0;
+  for (int i=1;i<3;i++){
+    if (pf[i].mu > pf[i_hi].mu) i_hi = i;
+  }
+  double sigma_adc = pf[i_hi].sigma;
+
+  // sigma sanity (treat as bad channel)
+  if (!std::isfinite(sigma_adc) || sigma_adc <= 0 || sigma_adc > SIGMA_MAX) return row;
+
+  row.k = k;
+  row.b = b;
+  row.chi2ndf = pf[i_hi].chi2ndf;
+
+  // FWHM in keV
+  double fwhm = 2.355 * (k * sigma_adc);
+
+  if (!std::isfinite(fwhm) || fwhm <= 0) {
+    fwhm = 0.0; // problematic -> 0
+  } else if (fwhm > FWHM_MAX_OK) {
+    fwhm = -1.0; // >300 -> -1
+  }
+  row.fwhm = fwhm;
+
+  // 6) build calibrated histogram by bin-mapping
+  hcal = std::make_unique<TH1D>(
+    TString::Format("h_cal_ch%03d", ch),
+    TString::Format("calibrated ch %03d;Energy (keV);Counts", ch),
+    E_BINS, E_MIN, E_MAX
+  );
+  hcal->SetDirectory(nullptr);
+
+  for (int ib=1; ib<=h->GetNbinsX(); ib++){
+    double c = h->GetBinContent(ib);
+    if (c <= 0) continue;
+    double x = h->GetBinCenter(ib);
+    double e = k*x + b;
+    int be = hcal->FindBin(e);
+    if (be>=1 && be<=hcal->GetNbinsX()) hcal->AddBinContent(be, c);
+  }
+
+  row.ok = 1;
+  return row;
+}
+
 int main(int argc, char** argv) {
   if (argc < 6) {
     std::cerr << "Usage: " << argv[0]
@@ -292,19 +356,8 @@ int main(int argc, char** argv) {
 
   const unsigned int nSlots = ROOT::GetThreadPoolSize() > 0 ? ROOT::GetThreadPoolSize() : 1;
 
-  // slot-local hists
-  std::vector<std::vector<std::unique_ptr<TH1D>>> hSlot(nSlots);
-  for (unsigned int s=0;s<nSlots;s++){
-    hSlot[s].resize(TOTAL_CH);
-    for (int ch=0; ch<TOTAL_CH; ch++){
-      hSlot[s][ch] = std::make_unique<TH1D>(
-        Form("h_raw_s%u_ch%03d", s, ch),
-        Form("raw ch %03d;ADC;Counts", ch),
-        RAW_BINS, RAW_MIN, RAW_MAX
-      );
-      hSlot[s][ch]->SetDirectory(nullptr);
-    }
-  }
+  // slot-local counts: one contiguous TOTAL_CH x RAW_BINS array per slot (HistBank.h)
+  HistBank raw(TOTAL_CH, RAW_BINS, RAW_MIN, RAW_MAX, nSlots);
 
   // NOTE: your branches are: mul is unsigned short, Ch is double array
   auto fillRaw = [&](unsigned int slot,
@@ -313,15 +366,15 @@ int main(int argc, char** argv) {
                      const RVec<double>& yhE,const RVec<double>& yhCh,unsigned short yhMul){
     if (xMul==1 && xE.size()>0 && xCh.size()>0){
       int ch = chX((int)llround(xCh[0]));
-      if (0<=ch && ch<TOTAL_CH) hSlot[slot][ch]->Fill(xE[0]);
+      if (0<=ch && ch<TOTAL_CH) raw.Fill(slot, ch, xE[0]);
     }
     if (yMul==1 && yE.size()>0 && yCh.size()>0){
       int ch = chY((int)llround(yCh[0]));
-      if (0<=ch && ch<TOTAL_CH) hSlot[slot][ch]->Fill(yE[0]);
+      if (0<=ch && ch<TOTAL_CH) raw.Fill(slot, ch, yE[0]);
     }
     if (yhMul==1 && yhE.size()>0 && yhCh.size()>0){
       int ch = chYH((int)llround(yhCh[0]));
-      if (0<=ch && ch<TOTAL_CH) hSlot[slot][ch]->Fill(yhE[0]);
+      if (0<=ch && ch<TOTAL_CH) raw.Fill(slot, ch, yhE[0]);
     }
   };
 
@@ -330,18 +383,13 @@ int main(int argc, char** argv) {
      "DSSDY_E","DSSDY_Ch","DSSDY_mul",
      "DSSDYH_E","DSSDYH_Ch","DSSDYH_mul"});
 
-  // merge slots
+  // merge slots (parallel tree reduction), then one TH1D per channel (all are written)
+  raw.Merge();
   std::vector<std::unique_ptr<TH1D>> hRaw(TOTAL_CH);
   for (int ch=0; ch<TOTAL_CH; ch++){
-    hRaw[ch] = std::make_unique<TH1D>(
-      Form("h_raw_ch%03d", ch),
-      Form("raw ch %03d;ADC;Counts", ch),
-      RAW_BINS, RAW_MIN, RAW_MAX
-    );
-    hRaw[ch]->SetDirectory(nullptr);
-    for (unsigned int s=0;s<nSlots;s++){
-      hRaw[ch]->Add(hSlot[s][ch].get());
-    }
+    hRaw[ch] = raw.ToTH1D(ch,
+      TString::Format("h_raw_ch%03d", ch),
+      TString::Format("raw ch %03d;ADC;Counts", ch));
   }
 
   // write originalSpectrum.root
@@ -363,137 +411,42 @@ int main(int argc, char** argv) {
   t.Branch("fwhm",&row.fwhm,"fwhm/D");
   t.Branch("chi2ndf",&row.chi2ndf,"chi2ndf/D");
   t.Branch("ok",&row.ok,"ok/I");
+  t.Branch("match_conf",&row.match_conf,"match_conf/D");
 
   std::ofstream out(outDat);
   out << "# ch  b  k  FWHM_keV  chi2ndf\n";
 
+  // per-channel stage: one task per channel on the IMT pool, results kept by channel index
+  std::vector<CalibRow> rows(TOTAL_CH);
+  std::vector<std::unique_ptr<TH1D>> hCal(TOTAL_CH);
+  // histograms made on the pool threads (h_cal_chNNN, TSpectrum's own) must not register in gROOT:
+  // its list is not locked, so auto-registration is off for the parallel stage
+  const bool addDir = TH1::AddDirectoryStatus();
+  TH1::AddDirectory(false);
+  ROOT::TThreadExecutor pool;
+  pool.Foreach([&](int ch){
+    rows[ch] = CalibrateChannel(ch, hRaw[ch].get(), hCal[ch]);
+  }, ROOT::TSeqI(TOTAL_CH));
+  TH1::AddDirectory(addDir);
+
+  // write in channel order (same ener_cal.dat / tCalib / key order as the serial loop)
+  fCal.cd();
   for (int ch=0; ch<TOTAL_CH; ch++){
-    row = CalibRow{};
-    row.ch = ch;
-
-    TH1D* h = hRaw[ch].get();
-    if (!h || h->GetEntries() < 300) {
-      WriteFail(out, row);
-      hFWHM.SetBinContent(ch+1, 0.0);
-      t.Fill();
-      continue;
-    }
-
-    // 1) robust peak seeds (windowed + best-triplet)
-    std::array<double,3> seed{};
-    if (!FindTop3PeaksRobust(h, seed)) {
-      WriteFail(out, row);
-      hFWHM.SetBinContent(ch+1, 0.0);
-      t.Fill();
-      continue;
-    }
-
-    // 2) two-stage gaussian refine
-    std::array<PeakFitResult,3> pf;
-    bool okPeaks = true;
-    for (int i=0;i<3;i++){
-      pf[i] = FitPeakTwoStage(h, seed[i], COARSE_WIN);
-      if (!pf[i].ok) { okPeaks = false; break; }
-    }
-    if (!okPeaks) {
-      WriteFail(out, row);
-      hFWHM.SetBinContent(ch+1, 0.0);
-      t.Fill();
-      continue;
-    }
-
-    // 3) sort refined peaks by mu asc
-    std::array<double,3> adc = {pf[0].mu, pf[1].mu, pf[2].mu};
-    std::sort(adc.begin(), adc.end());
-
-    // spacing sanity (avoid duplicate/shoulder)
-    if ((adc[1]-adc[0] < MIN_PEAK_SEP) || (adc[2]-adc[1] < MIN_PEAK_SEP)) {
-      WriteFail(out, row);
-      hFWHM.SetBinContent(ch+1, 0.0);
-      t.Fill();
-      continue;
-    }
-
-    // 4) line fit E = k*ADC + b + residual sanity
-    double k=FAIL_K, b=FAIL_B, maxResid=1e9;
-    if (!FitLine3pt(adc, k, b, maxResid)) {
+    row = rows[ch];
+    if (!row.ok) {
       WriteFail(out, row);
       hFWHM.SetBinContent(ch+1, 0.0);
       t.Fill();
       continue;
     }
 
-    // k sanity
-    if (!std::isfinite(k) || k < K_MIN || k > K_MAX) {
-      WriteFail(out, row);
-      hFWHM.SetBinContent(ch+1, 0.0);
-      t.Fill();
-      continue;
-    }
-    // residual sanity
-    if (maxResid > MAX_RESID_KEV) {
-      WriteFail(out, row);
-      hFWHM.SetBinContent(ch+1, 0.0);
-      t.Fill();
-      continue;
-    }
-
-    row.k = k;
-    row.b = b;
-
-    // 5) choose the highest-ADC refined peak as 5804.8 reference
-    int i_hi = 0;
-    for (int i=1;i<3;i++){
-      if (pf[i].mu > pf[i_hi].mu) i_hi = i;
-    }
-    double sigma_adc = pf[i_hi].sigma;
-    row.chi2ndf = pf[i_hi].chi2ndf;
-
-    // sigma sanity
-    if (!std::isfinite(sigma_adc) || sigma_adc <= 0 || sigma_adc > SIGMA_MAX) {
-      // treat as bad channel
-      row.k = FAIL_K; row.b = FAIL_B; row.fwhm = 0.0; row.chi2ndf = FAIL_CHI2; row.ok = 0;
-      out << ch << " " << row.b << " " << row.k << " " << row.fwhm << " " << row.chi2ndf << "\n";
-      hFWHM.SetBinContent(ch+1, 0.0);
-      t.Fill();
-      continue;
-    }
-
-    // FWHM in keV
-    double fwhm = 2.355 * (k * sigma_adc);
-
-    if (!std::isfinite(fwhm) || fwhm <= 0) {
-      fwhm = 0.0; // problematic -> 0
-    } else if (fwhm > FWHM_MAX_OK) {
-      fwhm = -1.0; // >300 -> -1
-    }
-    row.fwhm = fwhm;
-
-    // 6) build calibrated histogram by bin-mapping
-    auto hcal = std::make_unique<TH1D>(
-      Form("h_cal_ch%03d", ch),
-      Form("calibrated ch %03d;Energy (keV);Counts", ch),
-      E_BINS, E_MIN, E_MAX
-    );
-    hcal->SetDirectory(&fCal);
-
-    for (int ib=1; ib<=h->GetNbinsX(); ib++){
-      double c = h->GetBinContent(ib);
-      if (c <= 0) continue;
-      double x = h->GetBinCenter(ib);
-      double e = k*x + b;
-      int be = hcal->FindBin(e);
-      if (be>=1 && be<=hcal->GetNbinsX()) hcal->AddBinContent(be, c);
-    }
-
-    row.ok = 1;
     out << ch << " " << row.b << " " << row.k << " " << row.fwhm << " " << row.chi2ndf << "\n";
 
     // store FWHM vs ch (store 0 / -1 as you requested)
     hFWHM.SetBinContent(ch+1, row.fwhm);
 
     t.Fill();
-    hcal->Write();
+    hCal[ch]->Write();
   }
 
   hFWHM.Write();
@@ -0,0 +1,58 @@
+#include "Config.h"
+#include "CalibApply.h"
+#include "DriftTable.h"
+#include "TString.h"
+#include "TSystem.h"
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Step 3：把 ener_cal_Recal.dat（有 DRIFT_TABLE_FILE 时再乘该 run 的漂移修正）写回每个 run 的 tr_map
+// （只重写 DSSDX_E / DSSDY_E / DSSDYH_E，其余分支原样快速拷贝）
+int main() {
+    cout << "=== Step 3: Apply " << OUTPUT_DAT_FILE << " to tr_map ===" << endl;
+
+    CalibTable table;
+    if (!table.Load(OUTPUT_DAT_FILE, CalibTable::Columns::kIdBK) || table.Count() == 0) {
+        cerr << "[ERROR] Cannot read calibration table: " << OUTPUT_DAT_FILE << endl;
+        return 1;
+    }
+    cout << "--> Read " << table.Count() << " channels" << endl;
+
+    // 按 run 的漂移修正（DRIFT_TABLE_FILE，Calibrator 写出）：k, b 逐 run 乘 g(run, plane)
+    DriftTable drift;
+    const bool use_drift = ENABLE_DRIFT && drift.Load(DRIFT_TABLE_FILE);
+    if (use_drift) cout << "--> Per-run drift correction from " << DRIFT_TABLE_FILE << endl;
+
+    // strip id：X 0-127, Y 128-175, YH 176-223（与 ener_cal_Recal.dat 一致）
+    const vector<CalibTarget> targets = {
+        {"DSSDX_E",  "DSSDX_Ch",  0},
+        {"DSSDY_E",  "DSSDY_Ch",  NUM_DSSDX_POS},
+        {"DSSDYH_E", "DSSDYH_Ch", NUM_DSSDX_POS + NUM_DSSDY_POS},
+    };
+    CalibApplyOptions opt;
+    opt.nThreads = NUM_THREADS;
+
+    int n_ok = 0, n_fail = 0;
+    for (int run = RUN_START; run <= RUN_END; ++run) {
+        TString in  = TString::Format(INPUT_DIR_PATTERN, run);
+        TString out = TString::Format(APPLY_OUTPUT_PATTERN, run);
+        if (gSystem->AccessPathName(in)) continue;
+
+        CalibApplyStats st;
+        const CalibTable run_table = use_drift ? drift.Scaled(table, run) : table;
+        const CalibApplyStatus status = ApplyCalibrationTable(in.Data(), TREE_NAME, out.Data(), run_table, targets, opt, &st);
+        if (status != CalibApplyStatus::kOk) {
+            cerr << "[ERROR] run " << run << ": "
+                 << (status == CalibApplyStatus::kVerifyError ? "read-back check failed for " : "cannot rewrite ")
+                 << (status == CalibApplyStatus::kVerifyError ? out : in) << endl;
+            ++n_fail;
+            continue;
+        }
+        cout << "--> " << out << ": " << st.entries << " entries, " << st.calibrated << "/" << st.hits << " hits calibrated" << endl;
+        ++n_ok;
+    }
+    cout << "=== Apply done: " << n_ok << " run(s) written, " << n_fail << " failed ===" << endl;
+    return n_fail > 0 ? 1 : 0;
+}
@@ -1,5 +1,10 @@
 #include "Calibrator.h"
 #include "Config.h"
+#include "GausFit.h"
+#include "HistBank.h"
+#include "LineMatch.h"
+#include "PixelGainMap.h"
+#include "TH2D.h"
 #include "TSystem.h"
 #include "TF1.h"
 #include "TGraph.h"
@@ -28,6 +33,7 @@ Calibrator::Calibrator() {
 
 Calibrator::~Calibrator() {
     delete h_tot_X; delete h_tot_Y; delete h_tot_YH; delete h_fwhm_summary;
+    delete strip_norm_;
 }
 
 void Calibrator::LoadNormParams() {
@@ -45,8 +51,6 @@ void Calibrator::LoadNormParams() {
 }
 
 void Calibrator::Run() {
-    LoadNormParams(); 
-
     TChain chain(TREE_NAME);
     if (!gSystem->AccessPathName(DECAY_ONLY_FILE)) {
         chain.Add(DECAY_ONLY_FILE);
@@ -56,7 +60,28 @@ void Calibrator::Run() {
     }
 
     ROOT::RDataFrame df(chain);
-    FillSpectra(df); 
+    Run(LoadDecayHits(df));
+}
+
+DecayHits Calibrator::LoadDecayHits(ROOT::RDF::RNode df) {
+    // RunNo：DSSD_Pre / DSSD_Fused 写入；旧 decay 文件没有这一列时记为 -1（不做漂移跟踪）
+    ROOT::RDF::RNode d = df.HasColumn("RunNo") ? df : df.Define("RunNo", [] { return -1; });
+    vector<DecayHits> slots(d.GetNSlots());
+    d.ForeachSlot([&](unsigned int s, const RVec<double>& xe, const RVec<double>& xch,
+                      const RVec<double>& ye, const RVec<double>& ych,
+                      const RVec<double>& yhe, const RVec<double>& yhch, UShort_t yhm, int run) {
+        slots[s].AddEvent(xe, xch, ye, ych, yhe, yhch, yhm, run);
+    }, {"DSSDX_E","DSSDX_Ch","DSSDY_E","DSSDY_Ch","DSSDYH_E","DSSDYH_Ch","DSSDYH_mul","RunNo"});
+
+    DecayHits hits;
+    for (auto& h : slots) { hits.Append(h); h = DecayHits{}; }
+    cout << "--> Decay hits in memory: " << hits.size() << endl;
+    return hits;
+}
+
+void Calibrator::Run(const DecayHits& hits) {
+    LoadNormParams(); 
+    FillSpectra(hits); 
 
     TFile* f_diag = new TFile(CALIB_DIAG_ROOT, "RECREATE");
     f_diag->cd(); 
@@ -83,13 +108,19 @@ void Calibrator::Run() {
     out_txt.close();
     cout << "--> Peaks saved to peaks_list.txt" << endl;
 
+    // 3b. 按 run 的漂移修正（重填 strip_norm_，下面的逐条 FWHM 用修正后的谱）
+    if (ENABLE_DRIFT) TrackDrift(hits, rX, rY, rYH, f_diag);
+
     // 4. 逐条计算 FWHM 并保存每一条的图
     cout << "--> Calculating FWHM and Saving Individual Spectra..." << endl;
-    CalculateStripFWHM(df, rX, rY, rYH, f_diag);
+    CalculateStripFWHM(rX, rY, rYH, f_diag);
 
     // 5. 输出最终参数
     WriteOutput(rX, rY, rYH);
 
+    // 6. 像素增益图
+    if (ENABLE_PIXEL_MAP) BuildPixelMap(hits, rX, f_diag);
+
     f_diag->cd();
     h_fwhm_summary->SetLineWidth(2);
     h_fwhm_summary->SetLineColor(kBlue);
@@ -99,58 +130,36 @@ void Calibrator::Run() {
 }
 
 // [优化版] CalculateStripFWHM: 移除了 YH 冗余计算，增加了 Unzoom
-void Calibrator::CalculateStripFWHM(ROOT::RDataFrame& df, const PlaneResult& rX, const PlaneResult& rY, const PlaneResult& rYH, TFile* diag) {
-    unsigned int nSlots = df.GetNSlots();
-    
+// 不再遍历事件：细分的归一化 ADC 谱逐 bin 按 E = K*ADC + B 换算到刻度谱（同 ApplyCalibration）
+void Calibrator::CalculateStripFWHM(const PlaneResult& rX, const PlaneResult& rY, const PlaneResult& rYH, TFile* diag) {
     // 处理 X 和 Y 通道 (0-175)，YH (176+) 直接忽略
     
     int max_ch = NUM_DSSDX_POS + NUM_DSSDY_POS; // 128 + 48 = 176
 
-    vector<vector<TH1D*>> h_slots(nSlots, vector<TH1D*>(max_ch, nullptr));
-    
-    // 1. 初始化
-    for(unsigned int s=0; s<nSlots; ++s) {
-        for(int i=0; i<max_ch; ++i) {
-            h_slots[s][i] = new TH1D(Form("h_tmp_%d_%d", s, i), "", 500, 5000, 7500); 
-            h_slots[s][i]->SetDirectory(0);
-        }
-    }
-
-    // 2. 填充 (仅 X 和 Y)
-    df.ForeachSlot([&](unsigned int s, const RVec<double>& xe, const RVec<double>& xch,
-                       const RVec<double>& ye, const RVec<double>& ych,
-                       const RVec<double>& yhe, const RVec<double>& yhch, UShort_t yhm) {
-        // X Plane
-        if(!xch.empty() && xch[0] < 128) {
-            int c = (int)xch[0];
-            double e_cal = rX.K * (xe[0]*norm_params_[c].k + norm_params_[c].b) + rX.B;
-            h_slots[s][c]->Fill(e_cal);
-        }
-        // Y Plane
-        if(!ych.empty() && ych[0] < 48) {
-            int c = 128 + (int)ych[0];
-            double e_cal = rY.K * (ye[0]*norm_params_[c].k + norm_params_[c].b) + rY.B;
-            h_slots[s][c]->Fill(e_cal);
-        }
-        // [修改] YH 填充逻辑已移除，因为不需要计算 FWHM 也不需要画图
-    }, {"DSSDX_E","DSSDX_Ch","DSSDY_E","DSSDY_Ch","DSSDYH_E","DSSDYH_Ch","DSSDYH_mul"});
-
-    // 3. 处理 X 和 Y
     TDirectory *dir = diag->mkdir("Strips_Calib");
     dir->cd();
 
-   
-
+    const double fine_w = (HIST_MAX - HIST_MIN) / STRIP_FINE_BINS;
     for(int i=0; i<max_ch; ++i) {
-        TH1D* h_sum = h_slots[0][i];
-        for(unsigned int s=1; s<nSlots; ++s) {
-            h_sum->Add(h_slots[s][i]);
-            delete h_slots[s][i];
-        }
-
-        h_sum->SetName(Form("h_strip_%d", i));
         const char* type_name = (i < 128) ? "X" : "Y";
-        h_sum->SetTitle(Form("%s-Strip %d Calibrated;Energy (keV);Counts", type_name, i));
+        const PlaneResult& r = (i < 128) ? rX : rY;
+        TH1D* h_sum = new TH1D(TString::Format("h_strip_%d", i),
+                               TString::Format("%s-Strip %d Calibrated;Energy (keV);Counts", type_name, i),
+                               STRIP_CAL_BINS, STRIP_CAL_MIN, STRIP_CAL_MAX);
+        h_sum->SetDirectory(0);
+
+        // 细分谱的 underflow/overflow 落到刻度谱对应一侧的 underflow/overflow
+        const uint32_t* c = strip_norm_->Cells(i);
+        const bool flip = (r.K < 0);
+        if(c[0])                   h_sum->AddBinContent(flip ? STRIP_CAL_BINS+1 : 0, c[0]);
+        if(c[STRIP_FINE_BINS + 1]) h_sum->AddBinContent(flip ? 0 : STRIP_CAL_BINS+1, c[STRIP_FINE_BINS + 1]);
+        for(int b=1; b<=STRIP_FINE_BINS; ++b) {
+            if(!c[b]) continue;
+            double adc = HIST_MIN + (b - 0.5) * fine_w;
+            h_sum->AddBinContent(h_sum->GetXaxis()->FindFixBin(r.K * adc + r.B), c[b]);
+        }
+        h_sum->ResetStats();
+        h_sum->SetEntries(static_cast<double>(strip_norm_->Entries(i)));
 
         if(h_sum->GetEntries() < 20) {
             strip_fwhms_[i] = 0.0;
@@ -177,45 +186,50 @@ void Calibrator::CalculateStripFWHM(ROOT::RDataFrame& df, const PlaneResult& rX,
     diag->cd();
 }
 
-void Calibrator::FillSpectra(ROOT::RDataFrame& df) {
-    auto nSlots = df.GetNSlots();
-    vector<TH1D*> vX(nSlots), vY(nSlots), vYH(nSlots);
-    for(unsigned i=0; i<nSlots; ++i) {
-        vX[i] = (TH1D*)h_tot_X->Clone(); vX[i]->Reset(); vX[i]->SetDirectory(0);
-        vY[i] = (TH1D*)h_tot_Y->Clone(); vY[i]->Reset(); vY[i]->SetDirectory(0);
-        vYH[i]= (TH1D*)h_tot_YH->Clone();vYH[i]->Reset();vYH[i]->SetDirectory(0);
+// 唯一一次遍历 decay hit：平面总谱 + 逐条细分谱 (均为归一化 ADC)
+void Calibrator::FillSpectra(const DecayHits& hits) {
+    const int max_ch = NUM_DSSDX_POS + NUM_DSSDY_POS;
+    delete strip_norm_;
+    strip_norm_ = new HistBank(max_ch, STRIP_FINE_BINS, HIST_MIN, HIST_MAX, 1);
+
+    for(size_t i=0; i<hits.size(); ++i) {
+        int c = hits.strip[i];
+        double e_norm = hits.e[i]*norm_params_[c].k + norm_params_[c].b;
+        if(c < 128)      h_tot_X->Fill(e_norm);
+        else if(c < 176) h_tot_Y->Fill(e_norm);
+        else             h_tot_YH->Fill(e_norm);
+        if(c < max_ch) strip_norm_->Fill(0, c, e_norm);
     }
-
-    df.ForeachSlot([&](unsigned int s, const RVec<double>& xe, const RVec<double>& xch,
-                       const RVec<double>& ye, const RVec<double>& ych,
-                       const RVec<double>& yhe, const RVec<double>& yhch, UShort_t yhm) {
-        if(!xch.empty() && xch[0] < 128) {
-            int c = (int)xch[0]; 
-            vX[s]->Fill(xe[0]*norm_params_[c].k + norm_params_[c].b);
-        }
-        if(!ych.empty() && ych[0] < 48) {
-            int c = 128 + (int)ych[0]; 
-            vY[s]->Fill(ye[0]*norm_params_[c].k + norm_params_[c].b);
-        }
-        if(yhm==1 && !yhch.empty() && yhch[0] < 48) {
-            int c = 176 + (int)yhch[0]; 
-            vYH[s]->Fill(yhe[0]*norm_params_[c].k + norm_params_[c].b);
-        }
-    }, {"DSSDX_E","DSSDX_Ch","DSSDY_E","DSSDY_Ch","DSSDYH_E","DSSDYH_Ch","DSSDYH_mul"});
-
-    for(auto h : vX) { h_tot_X->Add(h); delete h; }
-    for(auto h : vY) { h_tot_Y->Add(h); delete h; }
-    for(auto h : vYH){ h_tot_YH->Add(h); delete h; }
+    strip_norm_->Merge();
 }
 
 PlaneResult Calibrator::CalibratePlane(TH1D* h_raw, const char* name, TFile* diag, ofstream& out) {
     TH1D* h_sub = SubtractBackground(h_raw);
     
+    // 参考峰识别：整谱 TSpectrum 候选峰 + LineMatch (k,b) 投票 (LineMatch.h)，
+    // 不再假定归一化 ADC ≈ keV 后在 REF_PEAKS 能量附近开窗；window 作为匹配容差
+    h_sub->GetXaxis()->SetRange(0, 0);
+    TSpectrum s(200);
+    int nFound = s.Search(h_sub, 4, "nobackground goff", 0.02);
+    vector<LinePeak> cands;
+    for(int i=0; i<nFound; ++i) cands.push_back({s.GetPositionX()[i], s.GetPositionY()[i]});
+    vector<RefLine> lines;
+    for(auto& p : REF_PEAKS) lines.push_back({p.energy, p.window});
+    LineMatchOptions opt;
+    opt.kMin = LINE_MATCH_K_MIN;
+    opt.kMax = LINE_MATCH_K_MAX;
+    opt.tolX = LINE_MATCH_TOL_ADC;
+    LineMatchResult m = MatchLines(cands, lines, opt);
+    out << "[LineMatch " << name << "] k=" << m.k << " b=" << m.b << " matched " << m.nMatched << "/" << lines.size()
+        << " rms=" << m.rms << " keV confidence=" << m.confidence << endl << endl;
+
+    // 匹配到的候选峰再做高斯精修 (窗口 window 换算成 ADC)
     vector<double> meas, ref;
-    for(auto& p : REF_PEAKS) {
+    for(size_t j=0; j<REF_PEAKS.size(); ++j) {
+        if(!m.ok || m.cand[j] < 0) continue;
         double pos, sig;
-        if(FindPeakGaussian(h_sub, p.energy, p.window * 2.0, pos, sig)) { 
-            meas.push_back(pos); ref.push_back(p.energy);
+        if(FindPeakGaussian(h_sub, m.x[j], REF_PEAKS[j].window / std::abs(m.k), pos, sig)) { 
+            meas.push_back(pos); ref.push_back(REF_PEAKS[j].energy);
         }
     }
     delete h_sub; 
@@ -357,8 +371,6 @@ bool Calibrator::FindPeakGaussian(TH1D* h, double center, double win, double &pe
     
     h->GetXaxis()->SetRangeUser(fit_min, fit_max);
 
-    TF1 func("f_comb", "gaus(0) + pol1(3)", fit_min, fit_max);
-    
     int bin = h->FindBin(peakPos);
     double height = h->GetBinContent(bin);
     double bg_left  = h->GetBinContent(h->FindBin(fit_min));
@@ -366,18 +378,29 @@ bool Calibrator::FindPeakGaussian(TH1D* h, double center, double win, double &pe
     double bg_const = (bg_left + bg_right) / 2.0;
     if (bg_const >= height) bg_const = 0;
 
-    func.SetParameter(0, height - bg_const); 
-    func.SetParameter(1, peakPos);           
-    func.SetParameter(2, 12.0);          
-    func.SetParLimits(2, 2.0, 100.0);
-
-    func.SetParameter(3, bg_const);
-    func.SetParameter(4, 0);
-
-    TFitResultPtr r = h->Fit(&func, "RQNS");
-    if (int(r) == 0 && r->IsValid()) {
-        peakPos = func.GetParameter(1); 
-        sigma   = func.GetParameter(2); 
+    // gaus + pol1, 原生拟合器（GausFit.h，与 TH1::Fit "RQNS" 同样的 chi2/取 bin 规则，线程安全）；
+    // 扣本底后的谱带 Sumw2，误差用 Sumw2 而不是计数（与 TH1::Fit 相同）
+    GausFitTask t;
+    t.y   = h->GetArray() + 1;
+    t.e2  = (h->GetSumw2N() > 0) ? h->GetSumw2()->GetArray() + 1 : nullptr;
+    t.n   = h->GetNbinsX();
+    t.xlo = h->GetXaxis()->GetXmin();
+    t.xhi = h->GetXaxis()->GetXmax();
+    t.lo  = fit_min;
+    t.hi  = fit_max;
+    t.A0  = height - bg_const;
+    t.mu0 = peakPos;
+    t.sigma0   = 12.0;
+    t.sigmaMin = 2.0;
+    t.sigmaMax = 100.0;
+    t.background = true;
+    t.b00 = bg_const;
+    t.b10 = 0;
+
+    GausFitResult r = FitGaus(t);
+    if (r.ok()) {
+        peakPos = r.mu; 
+        sigma   = r.sigma; 
         return true;
     }
     return false;
@@ -414,4 +437,155 @@ void Calibrator::WriteOutput(const PlaneResult& rX, const PlaneResult& rY, const
     w(128, 176, rY);
     w(176, 224, rYH);
     out.close();
-}
\ No newline at end of file
+}
+
+void Calibrator::TrackDrift(const DecayHits& hits, const PlaneResult& rX, const PlaneResult& rY, const PlaneResult& rYH, TFile* diag) {
+    const PlaneResult* planes[DriftTable::kPlanes] = {&rX, &rY, &rYH};
+    const char* plane_names[DriftTable::kPlanes] = {"X", "Y", "YH"};
+
+    size_t n_tagged = 0;
+    for(size_t i=0; i<hits.size(); ++i) if(DriftTable::InRange(hits.run[i])) ++n_tagged;
+    if(n_tagged == 0) {
+        cout << "--> Drift tracking skipped: decay data has no RunNo (rerun DSSD_Pre or use DSSD_Fused)" << endl;
+        return;
+    }
+    cout << "--> Tracking drift per run (" << DriftTable::kRuns << " runs x " << DriftTable::kPlanes
+         << " planes, line " << DRIFT_LINE.energy << " keV)..." << endl;
+
+    // 与 ener_cal_Recal.dat 相同的静态刻度
+    auto e_static = [&](size_t i) {
+        const int c = hits.strip[i];
+        const PlaneResult& r = *planes[DriftTable::Plane(c)];
+        return r.K * (hits.e[i]*norm_params_[c].k + norm_params_[c].b) + r.B;
+    };
+
+    // run × 平面 当作 PixelGainBuilder 的 nx × ny：只累计计数直方（内存与事件数无关），
+    // 所有 run 一次批量拟合，统计少的 run 向 g = 1 收缩
+    PixelGainBuilder builder(DriftTable::kRuns, DriftTable::kPlanes, {{DRIFT_LINE.energy, DRIFT_LINE.window}}, 1);
+    for(size_t i=0; i<hits.size(); ++i) {
+        if(!DriftTable::InRange(hits.run[i])) continue;
+        builder.Fill(0, hits.run[i] - RUN_START, DriftTable::Plane(hits.strip[i]), e_static(i));
+    }
+    PixelGainMap map = builder.Build(DRIFT_MIN_FIT, NUM_THREADS);
+    cout << "    fitted run x plane: " << builder.NFitted() << ", prior width: " << builder.PriorWidth() << endl;
+
+    ofstream out(DRIFT_TABLE_FILE);
+    out << fixed << setprecision(6);
+    out << "# run\tgX\t\teX\t\tnX\tgY\t\teY\t\tnY\tgYH\t\teYH\t\tnYH" << endl;
+    for(int r=0; r<DriftTable::kRuns; ++r) {
+        uint32_t n_run = 0;
+        for(int p=0; p<DriftTable::kPlanes; ++p) {
+            drift_.Set(RUN_START + r, p, map.Gain(r, p));
+            n_run += map.Counts(r, p);
+        }
+        if(n_run == 0) continue;
+        out << RUN_START + r;
+        for(int p=0; p<DriftTable::kPlanes; ++p) out << "\t" << map.Gain(r, p) << "\t" << map.Error(r, p) << "\t" << map.Counts(r, p);
+        out << endl;
+    }
+    out.close();
+    cout << "--> Drift table saved to " << DRIFT_TABLE_FILE << endl;
+
+    // 诊断：增益随 run 的变化 + 同一批 hit 静态刻度 / 逐 run 修正后的平面谱
+    TDirectory* dir = diag->mkdir("Drift");
+    dir->cd();
+    TH1D* h_static[DriftTable::kPlanes];
+    TH1D* h_drift[DriftTable::kPlanes];
+    for(int p=0; p<DriftTable::kPlanes; ++p) {
+        TH1D h_gain(TString::Format("h_drift_gain_%s", plane_names[p]),
+                    TString::Format("%s drift gain;Run;Gain", plane_names[p]),
+                    DriftTable::kRuns, RUN_START - 0.5, RUN_END + 0.5);
+        for(int r=0; r<DriftTable::kRuns; ++r) {
+            if(map.Counts(r, p) == 0) continue;
+            h_gain.SetBinContent(r+1, map.Gain(r, p));
+            h_gain.SetBinError(r+1, map.Error(r, p));
+        }
+        h_gain.Write();
+        h_static[p] = new TH1D(TString::Format("h_%s_static_cal", plane_names[p]),
+                               TString::Format("%s (static calibration);Energy (keV);Counts", plane_names[p]), HIST_BINS, HIST_MIN, HIST_MAX);
+        h_drift[p]  = new TH1D(TString::Format("h_%s_drift_cal", plane_names[p]),
+                               TString::Format("%s (per-run drift corrected);Energy (keV);Counts", plane_names[p]), HIST_BINS, HIST_MIN, HIST_MAX);
+        h_static[p]->SetDirectory(0); h_drift[p]->SetDirectory(0);
+    }
+    for(size_t i=0; i<hits.size(); ++i) {
+        if(!DriftTable::InRange(hits.run[i])) continue;
+        const int p = DriftTable::Plane(hits.strip[i]);
+        const double e = e_static(i);
+        h_static[p]->Fill(e);
+        h_drift[p]->Fill(drift_.Gain(hits.run[i], p) * e);
+    }
+    for(int p=0; p<DriftTable::kPlanes; ++p) {
+        double pos, sig_static = 0, sig_drift = 0;
+        FindPeakGaussian(h_static[p], DRIFT_LINE.energy, fit_win, pos, sig_static);
+        FindPeakGaussian(h_drift[p], DRIFT_LINE.energy, fit_win, pos, sig_drift);
+        cout << "    " << plane_names[p] << " FWHM @" << DRIFT_LINE.energy << " keV: static " << 2.355*sig_static
+             << " -> per-run " << 2.355*sig_drift << " keV" << endl;
+        h_static[p]->GetXaxis()->SetRange(0, 0); h_static[p]->Write();
+        h_drift[p]->GetXaxis()->SetRange(0, 0);  h_drift[p]->Write();
+        delete h_static[p]; delete h_drift[p];
+    }
+    diag->cd();
+
+    // 逐条 FWHM 改用修正后的细分谱：E' = g·(K·adc + B)  =>  adc' = g·adc + (g-1)·B/K
+    const int max_ch = NUM_DSSDX_POS + NUM_DSSDY_POS;
+    delete strip_norm_;
+    strip_norm_ = new HistBank(max_ch, STRIP_FINE_BINS, HIST_MIN, HIST_MAX, 1);
+    for(size_t i=0; i<hits.size(); ++i) {
+        const int c = hits.strip[i];
+        if(c >= max_ch) continue;
+        const PlaneResult& r = *planes[DriftTable::Plane(c)];
+        const double g = drift_.Gain(hits.run[i], DriftTable::Plane(c));
+        const double adc = hits.e[i]*norm_params_[c].k + norm_params_[c].b;
+        strip_norm_->Fill(0, c, g*adc + (g - 1.0)*r.B/r.K);
+    }
+    strip_norm_->Merge();
+}
+
+void Calibrator::BuildPixelMap(const DecayHits& hits, const PlaneResult& rX, TFile* diag) {
+    cout << "--> Building pixel gain map (" << NUM_DSSDX_POS << "x" << NUM_DSSDY_POS << ")..." << endl;
+
+    vector<PixelGainLine> lines;
+    for(auto& p : REF_PEAKS) lines.push_back({p.energy, p.window});
+    PixelGainBuilder builder(NUM_DSSDX_POS, NUM_DSSDY_POS, lines, 1);
+
+    // 与 ener_cal_Recal.dat 相同的最终条刻度（再乘该 run 的漂移修正，与 DSSD_Apply 写回的能量一致）
+    auto e_strip = [&](size_t i) {
+        const NormParams& np = norm_params_[hits.strip[i]];
+        return drift_.Gain(hits.run[i], 0) * (rX.K * (hits.e[i]*np.k + np.b) + rX.B);
+    };
+    for(size_t i=0; i<hits.size(); ++i) {
+        if(hits.strip[i] >= NUM_DSSDX_POS || hits.ypix[i] < 0) continue;
+        builder.Fill(0, hits.strip[i], hits.ypix[i], e_strip(i));
+    }
+    PixelGainMap map = builder.Build(PIXEL_MIN_FIT, NUM_THREADS);
+    cout << "    fitted pixels: " << builder.NFitted() << ", prior width: " << builder.PriorWidth() << endl;
+
+    if(!map.Save(PIXEL_MAP_FILE)) {
+        cerr << "[ERROR] Cannot write " << PIXEL_MAP_FILE << endl;
+        return;
+    }
+    cout << "--> Pixel gain map saved to " << PIXEL_MAP_FILE << endl;
+
+    // 诊断：增益图 + 同一批 X hit 只做条刻度 / 再加像素修正的能谱
+    diag->cd();
+    TH2D h_gain("h2_pixel_gain", "Pixel gain;X strip;Y strip", NUM_DSSDX_POS, -0.5, NUM_DSSDX_POS-0.5, NUM_DSSDY_POS, -0.5, NUM_DSSDY_POS-0.5);
+    for(int x=0; x<NUM_DSSDX_POS; ++x)
+        for(int y=0; y<NUM_DSSDY_POS; ++y) h_gain.SetBinContent(x+1, y+1, map.Gain(x, y));
+    h_gain.Write();
+
+    TH1D h_strip("h_X_strip_cal", "X (strip calibration);Energy (keV);Counts", HIST_BINS, HIST_MIN, HIST_MAX);
+    TH1D h_pixel("h_X_pixel_cal", "X (strip + pixel gain);Energy (keV);Counts", HIST_BINS, HIST_MIN, HIST_MAX);
+    h_strip.SetDirectory(0); h_pixel.SetDirectory(0);
+    for(size_t i=0; i<hits.size(); ++i) {
+        if(hits.strip[i] >= NUM_DSSDX_POS || hits.ypix[i] < 0) continue;
+        const double e = e_strip(i);
+        h_strip.Fill(e);
+        h_pixel.Fill(map.Apply(hits.strip[i], hits.ypix[i], e));
+    }
+    double pos, sig_strip = 0, sig_pixel = 0;
+    FindPeakGaussian(&h_strip, target_E, fit_win, pos, sig_strip);
+    FindPeakGaussian(&h_pixel, target_E, fit_win, pos, sig_pixel);
+    cout << "    FWHM @" << target_E << " keV: strip " << 2.355*sig_strip << " -> pixel " << 2.355*sig_pixel << " keV" << endl;
+    h_strip.GetXaxis()->SetRange(0, 0); h_strip.Write();
+    h_pixel.GetXaxis()->SetRange(0, 0); h_pixel.Write();
+}
@@ -4,9 +4,11 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <cstdint>
 #include "TH1D.h"
 #include "TFile.h"
 #include "ROOT/RDataFrame.hxx"
+#include "DriftTable.h"
 
 struct NormParams { double k=1.0, b=0.0; };
 
@@ -17,6 +19,40 @@ struct PlaneResult {
     double Res_RMS=0.0; 
 };
 
+// decay 事件的紧凑内存缓存：每个 hit 一条 (strip, 原始 E)。
+// strip: X 0-127, Y 128-175, YH 176-223（YH 仅 DSSDYH_mul==1）。FillSpectra 只遍历它一次，
+// 不再重读 decay 文件；DSSD_Fused 直接从原始 tr_map 填它。
+// ypix: X hit 所在像素的 Y 条号 (0-47)，同一事件没有 Y 时以及 Y/YH hit 为 -1（像素增益图用）。
+// run: 所在 run 号（RunNo 列，漂移跟踪用），未知为 -1。
+struct DecayHits {
+    std::vector<uint8_t> strip;
+    std::vector<int8_t>  ypix;
+    std::vector<int16_t> run;
+    std::vector<double>  e;
+
+    size_t size() const { return e.size(); }
+    void Add(int s, double v, int y = -1, int r = -1) {
+        strip.push_back((uint8_t)s); ypix.push_back((int8_t)y); run.push_back((int16_t)r); e.push_back(v);
+    }
+    // 一个 decay 事件 -> 0~3 个 hit
+    void AddEvent(const ROOT::RVec<double>& xe, const ROOT::RVec<double>& xch,
+                  const ROOT::RVec<double>& ye, const ROOT::RVec<double>& ych,
+                  const ROOT::RVec<double>& yhe, const ROOT::RVec<double>& yhch, UShort_t yhm, int r = -1) {
+        const bool has_y = !ych.empty() && ych[0] >= 0 && ych[0] < 48;
+        if(!xch.empty() && xch[0] >= 0 && xch[0] < 128)   Add((int)xch[0], xe[0], has_y ? (int)ych[0] : -1, r);
+        if(has_y)                                          Add(128 + (int)ych[0], ye[0], -1, r);
+        if(yhm==1 && !yhch.empty() && yhch[0] >= 0 && yhch[0] < 48) Add(176 + (int)yhch[0], yhe[0], -1, r);
+    }
+    void Append(const DecayHits& o) {
+        strip.insert(strip.end(), o.strip.begin(), o.strip.end());
+        ypix.insert(ypix.end(), o.ypix.begin(), o.ypix.end());
+        run.insert(run.end(), o.run.begin(), o.run.end());
+        e.insert(e.end(), o.e.begin(), o.e.end());
+    }
+};
+
+class HistBank;
+
 struct PeakInfo {
     double pos;    
     double height; 
@@ -26,7 +62,11 @@ class Calibrator {
 public:
     Calibrator();
     ~Calibrator();
-    void Run(); 
+    void Run();                      // 读 DECAY_ONLY_FILE（只读一遍）
+    void Run(const DecayHits& hits); // 从内存里的 decay hit 刻度（DSSD_Fused）
+
+    // decay 事件流 -> 内存缓存（ForeachSlot 各 slot 各自缓存，最后拼接）
+    static DecayHits LoadDecayHits(ROOT::RDF::RNode df);
 
 private:
     std::vector<NormParams> norm_params_; 
@@ -34,17 +74,25 @@ private:
     
     TH1D *h_tot_X, *h_tot_Y, *h_tot_YH;
     TH1D *h_fwhm_summary; 
+    HistBank *strip_norm_ = nullptr; // 逐条归一化 ADC 细分谱（X/Y，FillSpectra 同一遍填充）
+    DriftTable drift_;               // 按 run 的增益修正（TrackDrift 之前全为 1）
 
     void LoadNormParams(); 
-    void FillSpectra(ROOT::RDataFrame& df); 
+    void FillSpectra(const DecayHits& hits); 
     
-    // [修改] 增加 TFile* diag 参数
-    void CalculateStripFWHM(ROOT::RDataFrame& df, const PlaneResult& rX, const PlaneResult& rY, const PlaneResult& rYH, TFile* diag);
+    // [修改] 增加 TFile* diag 参数；逐条刻度谱由 strip_norm_ 按 K/B 换算得到，不再遍历事件
+    void CalculateStripFWHM(const PlaneResult& rX, const PlaneResult& rY, const PlaneResult& rYH, TFile* diag);
 
     PlaneResult CalibratePlane(TH1D* h_raw, const char* name, TFile* diag, std::ofstream& out); 
     
     void WriteOutput(const PlaneResult& rX, const PlaneResult& rY, const PlaneResult& rYH); 
 
+    // 按 run 漂移跟踪：每个 run × 平面拟合 DRIFT_LINE，写 DRIFT_TABLE_FILE，并用修正后的能量重填 strip_norm_
+    void TrackDrift(const DecayHits& hits, const PlaneResult& rX, const PlaneResult& rY, const PlaneResult& rYH, TFile* diag);
+
+    // 像素增益图 (128x48，X 能量)：在条刻度之上逐像素修正，写 PIXEL_MAP_FILE（PixelGainMap.h）
+    void BuildPixelMap(const DecayHits& hits, const PlaneResult& rX, TFile* diag);
+
     void FindAndListPeaks(TH1D* h, const char* title, std::ofstream& out);
 
     // 工具
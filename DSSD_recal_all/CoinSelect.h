@@ -0,0 +1,28 @@
+#ifndef COIN_SELECT_H
+#define COIN_SELECT_H
+
+#include "CoinWindowTable.h"
+#include "ROOT/RDataFrame.hxx"
+#include "ROOT/RVec.hxx"
+
+// 符合时间窗（coin_window/CoinWindow_Opt 生成的 COIN_WINDOW_FILE）：
+//   MWPC_coin / SSD_coin / Veto_coin = ΔT = DSSDX_Ts[0] - T 落在该通道窗口内的 hit 数
+// 没有表、或表里没有某个探测器的可用窗口时，对应的 *_coin 就是 *_mul（与原来的选择相同）。
+inline ROOT::RDF::RNode DefineCoincidence(ROOT::RDF::RNode df, const CoinWindowTable* table) {
+    using ROOT::VecOps::RVec;
+    auto define = [table](ROOT::RDF::RNode d, const char* name, const char* mul, const char* ch, const char* ts,
+                          int pair) -> ROOT::RDF::RNode {
+        if (!table || !table->Has(pair)) return d.Define(name, [](UShort_t m) { return m; }, {mul});
+        return d.Define(name, [table, pair](UShort_t m, const RVec<ULong64_t>& xts, const RVec<double>& c,
+                                            const RVec<ULong64_t>& t) -> UShort_t {
+            if (xts.empty()) return m;
+            return static_cast<UShort_t>(table->CountInWindow(pair, c, t, xts[0]));
+        }, {mul, "DSSDX_Ts", ch, ts});
+    };
+    df = define(df, "MWPC_coin", "MWPC_mul", "MWPC_Ch", "MWPC_Ts", CoinWindowTable::kMWPC);
+    df = define(df, "SSD_coin",  "SSD_mul",  "SSD_Ch",  "SSD_Ts",  CoinWindowTable::kSSD);
+    df = define(df, "Veto_coin", "Veto_mul", "Veto_Ch", "Veto_Ts", CoinWindowTable::kVeto);
+    return df;
+}
+
+#endif
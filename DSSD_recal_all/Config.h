@@ -35,6 +35,9 @@ inline constexpr char CALIB_DIAG_ROOT[] = "Diagnose_Calibration.root";
 // [最终输出]
 inline constexpr char OUTPUT_DAT_FILE[] = "ener_cal_Recal.dat";
 
+// [Step 3 输出] 刻度写回后的 tr_map（每个 run 一个文件，%05d = run 号）
+inline constexpr char APPLY_OUTPUT_PATTERN[] = "SS032%05d_map_recal.root";
+
 // --- 3. 物理通道定义 ---
 #define TOTAL_CH 224
 inline constexpr int NUM_DSSDX_POS = 128; // 0-127
@@ -50,20 +53,30 @@ inline constexpr int NORM_REF_MIN_COUNTS = 2000;
 // 手动指定归一化参考条：
 #define REF_STRIP_X 10  //一定检查最热的条分辨如何,与Veto否决情况
 #define REF_STRIP_Y 23  //小心X:40，90的Veto缝隙
+// 求解方式：false = 对参考条拟合 + 桥接；true = 全部 X-Y 条对同时求解（交替最小二乘，不用参考条）
+inline constexpr bool NORM_GLOBAL_SOLVER = false;
+inline constexpr int NORM_ALS_MAX_ITER = 1000;
+inline constexpr double NORM_ALS_TOL = 1e-3; // 收敛：各条在 NORM_MAX_E 处的归一化能量变化 < TOL (ADC)
 
 // --- 5. 绝对刻度 (Step 2) 参数 ---
 struct PeakDef {
     double energy;   // keV
     double window;   // keV (搜峰范围)
 };
-double target_E = 6113.0; 
-double fit_win  = 100.0; //仅仅搜索范围，double fit_radius = (win < 60.0) ? win/1.5 : 40.0;
+inline double target_E = 6113.0; 
+inline double fit_win  = 100.0; //仅仅搜索范围，double fit_radius = (win < 60.0) ? win/1.5 : 40.0;
 // 刻度参考峰
 inline const std::vector<PeakDef> REF_PEAKS = {
    // {8784, 30.0}, {7065, 30.0}, {7128, 30.0}
     {8783, 30.0}, {7065, 30.0}, {7128, 30.0}
 };
 
+// 参考峰识别 (LineMatch.h)：平面谱的候选峰与 REF_PEAKS 按 E = k*ADC + b 投票匹配，
+// k 的搜索范围如下；匹配容差 = REF_PEAKS 的 window + k*LINE_MATCH_TOL_ADC
+inline constexpr double LINE_MATCH_K_MIN = 0.5;
+inline constexpr double LINE_MATCH_K_MAX = 2.0;
+inline constexpr double LINE_MATCH_TOL_ADC = 2.0;
+
 // 诊断参考峰
 inline const std::vector<PeakDef> DIAG_PEAKS = {
     {6113, 40.0}, {7686, 40.0}, {5304, 40.0}
@@ -75,5 +88,31 @@ inline constexpr double HIST_MIN = 4000.0;
 inline constexpr double HIST_MAX = 14000.0;
 inline constexpr bool ENABLE_BKG_SUB = false;
 inline constexpr int BKG_ITERATIONS = 30;
+// 逐条 FWHM：先按归一化 ADC 细分存谱 (HIST_MIN~HIST_MAX, 0.5 ADC/bin)，拿到平面 K/B 后换算成刻度谱
+inline constexpr int STRIP_FINE_BINS = 20000;
+inline constexpr int STRIP_CAL_BINS = 500;
+inline constexpr double STRIP_CAL_MIN = 5000.0;
+inline constexpr double STRIP_CAL_MAX = 7500.0;
+
+// --- 6. 像素增益图 (X×Y = 128×48) ---
+// 条刻度之后，用 REF_PEAKS 三条线逐像素估计 X 能量的增益修正 E_pix = g(x,y)·E_strip（A80 用 --pixel-gain 读入）
+inline constexpr bool ENABLE_PIXEL_MAP = true;
+inline constexpr char PIXEL_MAP_FILE[] = "pixel_gain_map.dat";
+inline constexpr int PIXEL_MIN_FIT = 50;   // 像素计数 >= 该值才做高斯拟合，否则用均值（两者都向条刻度收缩）
+
+// --- 7. 刻度漂移跟踪 (按 run) ---
+// 平面刻度之后，按 run × 平面 (X/Y/YH) 拟合 DRIFT_LINE 的位置，得到增益修正 E_run = g(run, plane)·E
+// （DriftTable.h），写 DRIFT_TABLE_FILE；DSSD_Apply 写回 tr_map 时叠加在 ener_cal_Recal.dat 之上，
+// 逐条 FWHM (h_fwhm) 也用修正后的谱。需要 decay 数据带 RunNo 列（DSSD_Pre / DSSD_Fused 写入），没有则跳过
+inline constexpr bool ENABLE_DRIFT = true;
+inline constexpr char DRIFT_TABLE_FILE[] = "ener_drift_Recal.dat";
+inline const PeakDef DRIFT_LINE = {6113.0, 60.0}; // 统计最多的线
+inline constexpr int DRIFT_MIN_FIT = 200;  // run×平面计数 >= 该值才做高斯拟合，否则用均值（两者都向 g = 1 收缩）
+
+// --- 8. 符合时间窗 (coin_window/CoinWindow_Opt 生成) ---
+// 表存在时，implant / decay 选择里的 MWPC / SSD / Veto 只计 ΔT = DSSDX_Ts[0] - T 在该通道窗口内的 hit
+// （CoinSelect.h 的 *_coin 列），取代 *_mul；表不存在或 USE_COIN_WINDOWS = false 时与原来相同
+inline constexpr bool USE_COIN_WINDOWS = true;
+inline constexpr char COIN_WINDOW_FILE[] = "../coin_window/coin_windows.dat";
 
 #endif
\ No newline at end of file
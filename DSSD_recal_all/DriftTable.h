@@ -0,0 +1,90 @@
+#ifndef DRIFT_TABLE_H
+#define DRIFT_TABLE_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Config.h"
+#include "CalibApply.h"
+#include "TChain.h"
+#include "TString.h"
+#include "TSystem.h"
+#include "ROOT/RDataFrame.hxx"
+
+// 按 run 的刻度漂移修正：E_run = g(run, plane) · E，叠加在 ener_cal_Recal.dat 之上。
+// plane: 0 = X (0-127), 1 = Y (128-175), 2 = YH (176-223)；表里没有的 run / 平面 g = 1。
+// Calibrator 写 DRIFT_TABLE_FILE，DSSD_Apply 逐 run 读入。
+// 文件格式：每行 "run gX eX nX gY eY nY gYH eYH nYH"，'#' 开头为注释。
+struct DriftTable {
+    static constexpr int kPlanes = 3;
+    static constexpr int kRuns = RUN_END - RUN_START + 1;
+
+    std::vector<double> gain = std::vector<double>(kRuns * kPlanes, 1.0);
+
+    static int Plane(int strip) {
+        return strip < NUM_DSSDX_POS ? 0 : (strip < NUM_DSSDX_POS + NUM_DSSDY_POS ? 1 : 2);
+    }
+    static bool InRange(int run) { return run >= RUN_START && run <= RUN_END; }
+
+    double Gain(int run, int plane) const {
+        return InRange(run) ? gain[(run - RUN_START) * kPlanes + plane] : 1.0;
+    }
+    void Set(int run, int plane, double g) {
+        if (InRange(run)) gain[(run - RUN_START) * kPlanes + plane] = g;
+    }
+
+    bool Load(const char* path) {
+        std::ifstream in(path);
+        if (!in.is_open()) return false;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::stringstream ss(line);
+            int run;
+            if (!(ss >> run)) continue;
+            for (int p = 0; p < kPlanes; ++p) {
+                double g, e, n;
+                if (ss >> g >> e >> n && g > 0) Set(run, p, g);
+            }
+        }
+        return true;
+    }
+
+    // ener_cal_Recal.dat (id: k, b) 乘上某个 run 的增益：k, b 同乘 g
+    CalibTable Scaled(const CalibTable& t, int run) const {
+        CalibTable out = t;
+        for (int id = 0; id < out.Size(); ++id) {
+            const double g = Gain(run, Plane(id));
+            out.k[id] *= g;
+            out.b[id] *= g;
+        }
+        return out;
+    }
+};
+
+// RUN_START..RUN_END 中存在的输入文件加入 chain，返回 (run 号, 文件名)
+inline std::vector<std::pair<int, std::string>> AddRunFiles(TChain& chain) {
+    std::vector<std::pair<int, std::string>> files;
+    for (int run = RUN_START; run <= RUN_END; ++run) {
+        TString fname = TString::Format(INPUT_DIR_PATTERN, run);
+        if (!gSystem->AccessPathName(fname)) {
+            chain.Add(fname);
+            files.emplace_back(run, fname.Data());
+        }
+    }
+    return files;
+}
+
+// RunNo 列：每个输入文件只按文件名查一次 run 号（DefinePerSample），未知为 -1
+inline ROOT::RDF::RNode DefineRunNo(ROOT::RDF::RNode df, const std::vector<std::pair<int, std::string>>& files) {
+    return df.DefinePerSample("RunNo", [files](unsigned int, const ROOT::RDF::RSampleInfo& id) {
+        for (const auto& f : files) {
+            if (id.Contains(f.second)) return f.first;
+        }
+        return -1;
+    });
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "Config.h"
+#include "CoinSelect.h"
+#include "DriftTable.h"
+#include "Normalizer.h"
+#include "Calibrator.h"
+#include "ROOT/RDataFrame.hxx"
+#include "ROOT/RVec.hxx"
+#include "TApplication.h"
+#include "TChain.h"
+#include "TSystem.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace ROOT;
+
+// Step 0+1+2 合并：原始 tr_map 只读一遍
+//   - 归一化的 hits / 二维图在同一次事件循环里填充
+//   - 衰变事件只保留 (条号, 原始能量) 存在内存，刻度与 FWHM 直接从内存做
+//   - 加 --snapshot 时顺带写出 implant/decay 两个中间文件（与 DSSD_Pre 相同），供单独重跑 Norm/Cali
+int main(int argc, char** argv) {
+    bool write_snapshot = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--snapshot") == 0) write_snapshot = true;
+    }
+
+    TApplication app("app", &argc, argv);
+    if (NUM_THREADS > 0) ROOT::EnableImplicitMT(NUM_THREADS);
+
+    cout << "=== DSSD Fused Pipeline (Preselect + Normalize + Calibrate, single raw pass) ===" << endl;
+
+    TChain chain(TREE_NAME);
+    const auto run_files = AddRunFiles(chain);
+
+    if (run_files.empty()) {
+        cerr << "[ERROR] No input files found." << endl;
+        return 1;
+    }
+
+    CoinWindowTable coin;
+    const bool use_coin = USE_COIN_WINDOWS && coin.Load(COIN_WINDOW_FILE);
+    cout << "--> Coincidence: " << (use_coin ? string("windows from ") + COIN_WINDOW_FILE : string("multiplicities")) << endl;
+
+    ROOT::RDataFrame df(chain);
+
+    // 与 Preselect 相同的公共条件；evClass: 1 = implant, 2 = decay, 0 = 其它
+    auto df_sel = DefineCoincidence(DefineRunNo(df, run_files), use_coin ? &coin : nullptr)
+                    .Filter("DSSDX_mul == 1 && DSSDY_mul == 1 && Veto_coin == 0 && SSD_coin == 0")
+                    .Define("evClass", "MWPC_coin > 0 ? 1 : (MWPC_coin == 0 ? 2 : 0)")
+                    .Define("normOK", Normalizer::EnergyCut());
+
+    // 可选的中间文件：lazy Snapshot，和下面的 ForeachSlot 共用同一次事件循环
+    if (write_snapshot) {
+        vector<string> columns = {
+            "DSSDX_Ch", "DSSDX_E", "DSSDX_mul",
+            "DSSDY_Ch", "DSSDY_E", "DSSDY_mul",
+            "DSSDYH_Ch","DSSDYH_E","DSSDYH_mul",
+            "MWPC_mul", "Veto_mul", "SSD_mul", "RunNo",
+            "MWPC_coin", "Veto_coin", "SSD_coin"
+        };
+        ROOT::RDF::RSnapshotOptions opts;
+        opts.fLazy = true;
+        cout << "--> Will write implant-only file: " << IMPLANT_ONLY_FILE << endl;
+        df_sel.Filter("evClass == 1").Snapshot(TREE_NAME, IMPLANT_ONLY_FILE, columns, opts);
+        cout << "--> Will write decay-only file:   " << DECAY_ONLY_FILE << endl;
+        df_sel.Filter("evClass == 2").Snapshot(TREE_NAME, DECAY_ONLY_FILE, columns, opts);
+    }
+
+    Normalizer norm(df.GetNSlots());
+    vector<DecayHits> slot_hits(df.GetNSlots());
+
+    cout << "--> Streaming raw data (single pass)..." << endl;
+    df_sel.ForeachSlot([&](unsigned int slot,
+                           const RVec<double>& xe, const RVec<double>& xch,
+                           const RVec<double>& ye, const RVec<double>& ych,
+                           const RVec<double>& yhe, const RVec<double>& yhch,
+                           UShort_t yhm, int cls, bool normOK, int run) {
+        if (cls == 0) return;
+        if (normOK) norm.Fill(slot, (int)xch[0], xe[0], (int)ych[0], ye[0]);
+        if (cls == 2) slot_hits[slot].AddEvent(xe, xch, ye, ych, yhe, yhch, yhm, run);
+    }, {"DSSDX_E", "DSSDX_Ch", "DSSDY_E", "DSSDY_Ch", "DSSDYH_E", "DSSDYH_Ch", "DSSDYH_mul", "evClass", "normOK", "RunNo"});
+
+    // Step 1：拟合、桥接修正，写 NORM_PARAM_FILE（Calibrator 从这里读 k, b）
+    cout << "=== Step 1: DSSD Normalization ===" << endl;
+    if (!norm.Finish()) return 1;
+
+    DecayHits hits;
+    for (auto& h : slot_hits) { hits.Append(h); h = DecayHits{}; }
+    cout << "--> Decay hits in memory: " << hits.size() << endl;
+
+    try {
+        cout << "=== Step 2: DSSD Calibration ===" << endl;
+        Calibrator cal;
+        cal.Run(hits);
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,403 @@
+#include "Normalizer.h"
+#include "Config.h"
+#include "TFile.h"
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TProfile.h"
+#include "TF1.h"
+#include "TFitResult.h"
+#include "ROOT/TSeq.hxx"
+#include "ROOT/TThreadExecutor.hxx"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+
+// Config.h 里手动指定的参考条，-1 = 自动
+static int ConfigRefX() {
+#ifdef REF_STRIP_X
+    return REF_STRIP_X;
+#else
+    return -1;
+#endif
+}
+static int ConfigRefY() {
+#ifdef REF_STRIP_Y
+    return REF_STRIP_Y;
+#else
+    return -1;
+#endif
+}
+
+Normalizer::Normalizer(unsigned nSlots)
+    : global_(NORM_GLOBAL_SOLVER),
+      ref_X_(ConfigRefX()), ref_Y_(ConfigRefY()), auto_ref_(!global_ && (ref_X_ < 0 || ref_Y_ < 0)),
+      hits_X_(1, NUM_DSSDX_POS, -0.5, NUM_DSSDX_POS-0.5, nSlots),
+      hits_Y_(1, NUM_DSSDY_POS, -0.5, NUM_DSSDY_POS-0.5, nSlots),
+      // 每个条一张 200x200 计数图，全部放在一个连续 uint32 数组里，多线程原子累加（HistBank.h）；全局模式不需要
+      bank_X_(global_ ? 0 : NUM_DSSDX_POS, 200, NORM_MIN_E, NORM_MAX_E, 200, NORM_MIN_E, NORM_MAX_E, 1, HistBank::Mode::kAtomic),
+      bank_Y_(global_ ? 0 : NUM_DSSDY_POS, 200, NORM_MIN_E, NORM_MAX_E, 200, NORM_MIN_E, NORM_MAX_E, 1, HistBank::Mode::kAtomic) {
+    if (nSlots == 0) nSlots = 1;
+    if (auto_ref_) buffer_.resize(nSlots);
+    if (global_) pairs_.assign(nSlots, vector<PairStat>(NUM_DSSDX_POS * NUM_DSSDY_POS));
+}
+
+std::string Normalizer::EnergyCut() {
+    return TString::Format(
+        "DSSDX_E[0]>%f && DSSDX_E[0]<%f && "
+        "DSSDY_E[0]>%f && DSSDY_E[0]<%f && "
+        "abs(DSSDX_E[0]-DSSDY_E[0])<%f",
+        NORM_MIN_E, NORM_MAX_E,
+        NORM_MIN_E, NORM_MAX_E,
+        NORM_E_DIFF).Data();
+}
+
+void Normalizer::Fill(unsigned slot, int cx, double ex, int cy, double ey) {
+    hits_X_.Fill(slot, 0, cx);
+    hits_Y_.Fill(slot, 0, cy);
+    if (global_) {
+        if (cx < 0 || cx >= NUM_DSSDX_POS || cy < 0 || cy >= NUM_DSSDY_POS) return;
+        PairStat& p = pairs_[slot][cx * NUM_DSSDY_POS + cy];
+        p.n += 1; p.sx += ex; p.sy += ey;
+        p.sxx += ex*ex; p.syy += ey*ey; p.sxy += ex*ey;
+    }
+    else if (auto_ref_) buffer_[slot].push_back({cx, ex, cy, ey});
+    else FillMaps(slot, cx, ex, cy, ey);
+}
+
+// 填充逻辑：
+// X条校准：看它和 Ref_Y 的符合 (X_i vs Ref_Y)
+// Y条校准：看它和 Ref_X 的符合 (Y_i vs Ref_X)
+void Normalizer::FillMaps(unsigned slot, int cx, double ex, int cy, double ey) {
+    if(cy == ref_Y_ && cx >= 0 && cx < NUM_DSSDX_POS) bank_X_.Fill(slot, cx, ex, ey);
+    if(cx == ref_X_ && cy >= 0 && cy < NUM_DSSDY_POS) bank_Y_.Fill(slot, cy, ey, ex);
+}
+
+bool Normalizer::Finish() {
+    hits_X_.Merge(); hits_Y_.Merge();
+    auto h_x_hits = hits_X_.ToTH1D(0, "h_x_hits", "X hits");
+    auto h_y_hits = hits_Y_.ToTH1D(0, "h_y_hits", "Y hits");
+
+    // 参考道 (Ref Strips)：未指定时取统计量最大的条，再用缓存的候选事件填图
+    if (auto_ref_) {
+        if (ref_X_ < 0) ref_X_ = h_x_hits->GetMaximumBin() - 1;
+        if (ref_Y_ < 0) ref_Y_ = h_y_hits->GetMaximumBin() - 1;
+        for (auto& buf : buffer_) {
+            for (const Cand& c : buf) FillMaps(0, c.cx, c.ex, c.cy, c.ey);
+            vector<Cand>().swap(buf);
+        }
+    }
+
+    TFile *f_diag = new TFile(NORM_DIAG_ROOT, "RECREATE");
+    h_x_hits->Write(); h_y_hits->Write();
+
+    vector<NormResult> x_res(NUM_DSSDX_POS), y_res(NUM_DSSDY_POS);
+    vector<int> bad_x, bad_y;
+    if (global_) SolveGlobal(x_res, y_res, bad_x, bad_y);
+    else         SolveRef(x_res, y_res, bad_x, bad_y);
+
+    f_diag->Close();
+    delete f_diag;
+
+    return WriteParams(x_res, y_res, bad_x, bad_y);
+}
+
+void Normalizer::SolveRef(vector<NormResult>& x_res, vector<NormResult>& y_res,
+                          vector<int>& bad_x, vector<int>& bad_y) {
+    cout << "--> Ref X: " << ref_X_ << ", Ref Y: " << ref_Y_ << endl;
+
+    // 转成 TH2D 并拟合
+    cout << "--> Fitting..." << endl;
+
+    // --- 处理 X 面 ---
+    for(int i=0; i<NUM_DSSDX_POS; ++i) {
+        TH2D* h_final = bank_X_.ToTH2D(i, TString::Format("h2_X_%d", i), TString::Format("X%d vs RefY%d;EX;RefEY", i, ref_Y_)).release();
+        
+        // 确保 Ref_X 本身能被拟合（放宽一点统计量要求）
+        int min_entries = (i == ref_X_) ? 100 : NORM_MIN_ENTRIES;
+
+        if(h_final->GetEntries() < min_entries) {
+            bad_x.push_back(i);
+        } else {
+            // ProfileX 转为 1D 并拟合直线
+            TProfile *p = h_final->ProfileX(Form("pX_%d", i));
+            TFitResultPtr r = p->Fit("pol1", "QS0");
+            if(r->IsValid() && abs(r->Parameter(1)) > 0.1) {
+                // 存储参数: E_cal = k * E_raw + b
+                x_res[i] = {r->Parameter(1), r->Parameter(0)};
+            } else {
+                bad_x.push_back(i);
+            }
+            p->Write(); delete p;
+        }
+        h_final->Write(); delete h_final;
+    }
+
+    // --- 处理 Y 面 ---
+    for(int i=0; i<NUM_DSSDY_POS; ++i) {
+        TH2D* h_final = bank_Y_.ToTH2D(i, TString::Format("h2_Y_%d", i), TString::Format("Y%d vs RefX%d;EY;RefEX", i, ref_X_)).release();
+
+        if(h_final->GetEntries() < NORM_MIN_ENTRIES) {
+            bad_y.push_back(i);
+        } else {
+            TProfile *p = h_final->ProfileX(Form("pY_%d", i));
+            TFitResultPtr r = p->Fit("pol1", "QS0");
+            if(r->IsValid() && abs(r->Parameter(1)) > 0.1) {
+                y_res[i] = {r->Parameter(1), r->Parameter(0)};
+            } else {
+                bad_y.push_back(i);
+            }
+            p->Write(); delete p;
+        }
+        h_final->Write(); delete h_final;
+    }
+
+    // 桥接修正 (Bridge Correction)
+    // 目前：所有 X 条都对齐到了 Ref_Y，所有 Y 条都对齐到了 Ref_X。
+    // 目标：把所有 Y 条的参数转换一下，让它们也对齐到 Ref_Y (即 X面的标准)。
+    // 桥梁：Ref_X 和 Ref_Y 的交叉点。
+    
+    cout << "------------------------------------------------" << endl;
+    cout << "--> Checking Bridge Correction (Ref_X <-> Ref_Y)..." << endl;
+
+    double k_bridge = 1.0;
+    double b_bridge = 0.0;
+    bool bridge_ok = true;
+
+    // 检查 Ref_X 是否在坏条列表中
+    for(int bad : bad_x) { 
+        if(bad == ref_X_) {
+            bridge_ok = false;
+            break;
+        }
+    }
+
+    if(bridge_ok && abs(x_res[ref_X_].k) > 0.01) {  
+        // x_res[ref_X] 存的是: E_refX_cal = k * E_refX_raw + b = E_refY_raw
+        // 这里的关系稍微有点绕，本质是利用 Ref_X 在 "X vs RefY" 图里的拟合参数
+        // 实际上 x_res[ref_X] 描述了: Ref_X 读数 -> Ref_Y 读数 的关系
+        
+        // 我们需要把 Y面的 "对齐RefX" 转为 "对齐RefY"
+        // 已知 Y[i]: E_Yi_cal = k_y * E_Yi_raw + b_y = E_refX_raw
+        // 桥梁关系 (由 x_res[ref_X] 提供): E_refX_raw = (E_refY_raw - b_br) / k_br
+        // ...这里采用直接数学倒推的逻辑:
+        
+        // 修正逻辑：
+        // 1. 我们拟合得到 X_i vs Ref_Y => X 对齐到了 Ref_Y
+        // 2. 我们拟合得到 Y_i vs Ref_X => Y 对齐到了 Ref_X
+        // 3. 我们需要 Y_i vs Ref_Y
+        // 4. 关键点：在 X_i vs Ref_Y 的循环中，当 i = Ref_X 时，
+        //    我们得到了 Ref_X vs Ref_Y 的关系: Ref_X_val = k_ref * Ref_X_raw + b_ref ~ Ref_Y_raw
+        //    Wait, 这里的 x_res[i] 含义是：将 Ch_i 的原始值 映射到 参考轴的值。
+        //    对于 bank_X 的 ref_X 道, X轴是 Ref_X_raw, Y轴是 Ref_Y_raw
+        //    所以 x_res[ref_X] 确实是: Ref_Y_raw = k * Ref_X_raw + b
+        
+        //    对于 bank_Y 的第 i 道, X轴是 Y_i_raw, Y轴是 Ref_X_raw
+        //    y_res[i] 是: Ref_X_raw = k_y * Y_i_raw + b_y
+        
+        //    联立：
+        //    Ref_Y_raw = k_bridge * (k_y * Y_i_raw + b_y) + b_bridge
+        //              = (k_bridge * k_y) * Y_i_raw + (k_bridge * b_y + b_bridge)
+        
+        //    所以修正系数很简单：
+        k_bridge = x_res[ref_X_].k;
+        b_bridge = x_res[ref_X_].b;
+        
+        cout << "    [OK] Bridge parameters (Ref_X -> Ref_Y): k=" << k_bridge << ", b=" << b_bridge << endl;
+
+        for(int i=0; i<NUM_DSSDY_POS; ++i) {
+            bool is_bad = false;
+            for(int bad : bad_y) if(bad == i) { is_bad = true; break; }
+            if(is_bad) continue;
+
+            double k_old = y_res[i].k;
+            double b_old = y_res[i].b;
+            
+            // 应用修正公式
+            y_res[i].k = k_bridge * k_old;
+            y_res[i].b = k_bridge * b_old + b_bridge;
+        }
+        cout << "--> Y-plane parameters have been aligned to Ref_Y scale." << endl;
+
+    } else {
+        cout << "    [WARNING] Bridge calculation failed (Ref_X bad or k too small)." << endl;
+        cout << "    Y parameters will NOT be corrected and may mismatch X scale." << endl;
+    }
+    cout << "------------------------------------------------" << endl;
+}
+
+// 全局模式：对全部 X-Y 符合事件最小化 Σ (k_x·EX + b_x − k_y·EY − b_y)²。
+// 交替最小二乘：固定 Y 面时每个 X 条是独立的两参数线性回归（只用它的 48 个条对统计量），反之亦然；
+// 每半步在条之间并行。整体的仿射自由度 (E -> αE+β) 每轮后固定为：好 Y 条平均 k = 1、平均 b = 0。
+// 代价只和条对数有关，与事件数无关。
+void Normalizer::SolveGlobal(vector<NormResult>& x_res, vector<NormResult>& y_res,
+                             vector<int>& bad_x, vector<int>& bad_y) {
+    const int nX = NUM_DSSDX_POS, nY = NUM_DSSDY_POS;
+
+    // 合并各 slot 的条对统计量
+    vector<PairStat> P(nX * nY);
+    for (auto& slot : pairs_) {
+        for (int i = 0; i < nX * nY; ++i) {
+            const PairStat& q = slot[i];
+            PairStat& p = P[i];
+            p.n += q.n; p.sx += q.sx; p.sy += q.sy;
+            p.sxx += q.sxx; p.syy += q.syy; p.sxy += q.sxy;
+        }
+        vector<PairStat>().swap(slot);
+    }
+
+    TH2D h_pairs("h2_pairs", "X-Y pair counts;X strip;Y strip", nX, -0.5, nX-0.5, nY, -0.5, nY-0.5);
+    vector<double> nx(nX, 0.0), ny(nY, 0.0);
+    int n_pairs = 0;
+    for (int i = 0; i < nX; ++i) {
+        for (int j = 0; j < nY; ++j) {
+            const double n = P[i*nY + j].n;
+            if (n <= 0) continue;
+            nx[i] += n; ny[j] += n; ++n_pairs;
+            h_pairs.SetBinContent(i+1, j+1, n);
+        }
+    }
+    h_pairs.Write();
+    cout << "--> Global solver (ALS): " << n_pairs << " X-Y pairs with data" << endl;
+
+    // 统计量不足的条直接算坏条，不参与求解
+    vector<char> okX(nX), okY(nY);
+    for (int i = 0; i < nX; ++i) okX[i] = nx[i] >= NORM_MIN_ENTRIES;
+    for (int j = 0; j < nY; ++j) okY[j] = ny[j] >= NORM_MIN_ENTRIES;
+
+    vector<double> kx(nX, 1.0), bx(nX, 0.0), ky(nY, 1.0), by(nY, 0.0);
+
+    // 一个条的回归 Σ (k·u + b − t)²：u 为本条原始能量，t 为对面条当前的归一化能量
+    auto fitX = [&](int i) {
+        if (!okX[i]) return;
+        double n = 0, Su = 0, Suu = 0, St = 0, Sut = 0;
+        for (int j = 0; j < nY; ++j) {
+            const PairStat& p = P[i*nY + j];
+            if (!okY[j] || p.n <= 0) continue;
+            n += p.n; Su += p.sx; Suu += p.sxx;
+            St  += ky[j]*p.sy  + by[j]*p.n;
+            Sut += ky[j]*p.sxy + by[j]*p.sx;
+        }
+        const double det = n*Suu - Su*Su;
+        if (n < 2 || det <= 0) { okX[i] = 0; return; }
+        kx[i] = (n*Sut - Su*St) / det;
+        bx[i] = (Suu*St - Su*Sut) / det;
+    };
+    auto fitY = [&](int j) {
+        if (!okY[j]) return;
+        double n = 0, Su = 0, Suu = 0, St = 0, Sut = 0;
+        for (int i = 0; i < nX; ++i) {
+            const PairStat& p = P[i*nY + j];
+            if (!okX[i] || p.n <= 0) continue;
+            n += p.n; Su += p.sy; Suu += p.syy;
+            St  += kx[i]*p.sx  + bx[i]*p.n;
+            Sut += kx[i]*p.sxy + bx[i]*p.sy;
+        }
+        const double det = n*Suu - Su*Su;
+        if (n < 2 || det <= 0) { okY[j] = 0; return; }
+        ky[j] = (n*Sut - Su*St) / det;
+        by[j] = (Suu*St - Su*Sut) / det;
+    };
+
+    ROOT::TThreadExecutor pool;
+    int iter = 0;
+    double max_change = 0.0;
+    bool no_scale = false;  // 没有可用的 Y 条固定整体标度：求解失败
+    for (;;) {
+        for (iter = 0; iter < NORM_ALS_MAX_ITER; ++iter) {
+            const vector<double> kx0 = kx, bx0 = bx, ky0 = ky, by0 = by;
+            pool.Foreach(fitX, ROOT::TSeqI(nX));
+            pool.Foreach(fitY, ROOT::TSeqI(nY));
+
+            // 固定整体标度：好 Y 条的平均 (k, b) = (1, 0)
+            double mk = 0, mb = 0; int m = 0;
+            for (int j = 0; j < nY; ++j) if (okY[j]) { mk += ky[j]; mb += by[j]; ++m; }
+            if (m == 0 || mk == 0) { no_scale = true; break; }
+            const double alpha = m / mk, beta = -alpha * mb / m;
+            for (int i = 0; i < nX; ++i) { kx[i] *= alpha; bx[i] = alpha*bx[i] + beta; }
+            for (int j = 0; j < nY; ++j) { ky[j] *= alpha; by[j] = alpha*by[j] + beta; }
+
+            // 收敛判据：量程上端 NORM_MAX_E 处的归一化能量变化
+            max_change = 0.0;
+            for (int i = 0; i < nX; ++i) if (okX[i])
+                max_change = max(max_change, abs((kx[i]-kx0[i])*NORM_MAX_E + bx[i]-bx0[i]));
+            for (int j = 0; j < nY; ++j) if (okY[j])
+                max_change = max(max_change, abs((ky[j]-ky0[j])*NORM_MAX_E + by[j]-by0[j]));
+            if (max_change < NORM_ALS_TOL) break;
+        }
+
+        if (no_scale) break;
+
+        // 斜率异常的条剔除后重解（与参考条模式同样的 |k| > 0.1 判据）
+        bool removed = false;
+        for (int i = 0; i < nX; ++i) if (okX[i] && abs(kx[i]) <= 0.1) { okX[i] = 0; removed = true; }
+        for (int j = 0; j < nY; ++j) if (okY[j] && abs(ky[j]) <= 0.1) { okY[j] = 0; removed = true; }
+        if (!removed) break;
+    }
+
+    if (no_scale) {
+        // 标度不定的解没有意义：全部条按坏条处理
+        cout << "    [ERROR] ALS failed: no usable Y strips to fix the overall scale; all strips marked bad" << endl;
+        fill(okX.begin(), okX.end(), 0);
+        fill(okY.begin(), okY.end(), 0);
+    } else if (iter >= NORM_ALS_MAX_ITER) {
+        cout << "    [WARNING] ALS not converged after " << NORM_ALS_MAX_ITER
+             << " iterations (max change " << max_change << ")" << endl;
+    } else {
+        cout << "    [OK] ALS converged in " << iter+1 << " iterations" << endl;
+    }
+
+    // 每条的残差 RMS：Σ (a·EX + c − d·EY − f)² 由条对统计量直接展开
+    TH1D h_res("h_res_rms", "Normalized X-Y residual RMS;Strip ID (Y = 128+);RMS (ADC)", nX+nY, -0.5, nX+nY-0.5);
+    vector<double> r2x(nX, 0.0), r2y(nY, 0.0), nrx(nX, 0.0), nry(nY, 0.0);
+    for (int i = 0; i < nX; ++i) {
+        if (!okX[i]) continue;
+        for (int j = 0; j < nY; ++j) {
+            const PairStat& p = P[i*nY + j];
+            if (!okY[j] || p.n <= 0) continue;
+            const double a = kx[i], d = ky[j], u = bx[i] - by[j];
+            const double r2 = a*a*p.sxx + d*d*p.syy + p.n*u*u - 2*a*d*p.sxy + 2*a*u*p.sx - 2*d*u*p.sy;
+            r2x[i] += r2; nrx[i] += p.n;
+            r2y[j] += r2; nry[j] += p.n;
+        }
+    }
+    for (int i = 0; i < nX; ++i) if (nrx[i] > 0) h_res.SetBinContent(i+1, sqrt(max(0.0, r2x[i]/nrx[i])));
+    for (int j = 0; j < nY; ++j) if (nry[j] > 0) h_res.SetBinContent(nX+j+1, sqrt(max(0.0, r2y[j]/nry[j])));
+    h_res.Write();
+
+    for (int i = 0; i < nX; ++i) {
+        if (okX[i]) x_res[i] = {kx[i], bx[i]};
+        else bad_x.push_back(i);
+    }
+    for (int j = 0; j < nY; ++j) {
+        if (okY[j]) y_res[j] = {ky[j], by[j]};
+        else bad_y.push_back(j);
+    }
+}
+
+bool Normalizer::WriteParams(const vector<NormResult>& x_res, const vector<NormResult>& y_res,
+                             const vector<int>& bad_x, const vector<int>& bad_y) const {
+    // 输出结果
+    ofstream out(NORM_PARAM_FILE, ios::trunc); 
+    if(!out.is_open()) {
+        cerr << "[ERROR] Cannot open output file: " << NORM_PARAM_FILE << endl;
+        return false;
+    }
+
+    out << fixed << setprecision(6);
+    out << "# ID\tk\t\tb" << endl;
+    for (int i : bad_x) out << "# Bad X: " << i << endl;
+    for (int i : bad_y) out << "# Bad Y: " << i << endl;
+    
+    // 输出
+    for (int i = 0; i < NUM_DSSDX_POS; ++i) out << i << "\t" << x_res[i].k << "\t" << x_res[i].b << endl;
+    for (int i = 0; i < NUM_DSSDY_POS; ++i) out << (128+i) << "\t" << y_res[i].k << "\t" << y_res[i].b << endl;
+    
+    out.close();
+    cout << "--> Normalization Parameters saved to " << NORM_PARAM_FILE << endl;
+    return true;
+}
+
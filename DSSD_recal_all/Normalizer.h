@@ -0,0 +1,56 @@
+#ifndef NORMALIZER_H
+#define NORMALIZER_H
+
+#include "HistBank.h"
+#include <string>
+#include <vector>
+
+struct NormResult {
+    double k = 1.0;
+    double b = 0.0;
+};
+
+// Step 1 核心，两种模式（Config.h 的 NORM_GLOBAL_SOLVER）：
+//   参考条模式：条 vs 参考条的 2D 图累加 -> ProfileX 直线拟合 -> 桥接修正
+//   全局模式  ：每个 (X,Y) 条对累加充分统计量 -> 交替最小二乘同时解出 176 条的 (k, b)，不需要参考条
+// 两种模式最后都输出同样格式的参数表。
+// 事件来源由调用者决定：DSSD_Norm 读 Step 0 的小文件，DSSD_Fused 直接读原始 tr_map。
+class Normalizer {
+public:
+    // 参考条模式：参考条取 Config.h 的 REF_STRIP_X / REF_STRIP_Y；未定义的取 hits 最多的条
+    // （此时候选事件先缓存在内存，Finish 时再填图）
+    explicit Normalizer(unsigned nSlots);
+
+    // 归一化事件筛选的能量部分（多重性/反符合条件由调用者给出）
+    static std::string EnergyCut();
+
+    // 一个已通过筛选的 X/Y 符合事件；可在 ForeachSlot 里多线程调用
+    void Fill(unsigned slot, int cx, double ex, int cy, double ey);
+
+    // 求解，写 NORM_DIAG_ROOT 与 NORM_PARAM_FILE；参数表写不出时返回 false
+    bool Finish();
+
+private:
+    struct Cand { int cx; double ex; int cy; double ey; };
+    // 一个 (X,Y) 条对的充分统计量：n, Σex, Σey, Σex², Σey², Σex·ey
+    struct PairStat { double n = 0, sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0; };
+
+    void FillMaps(unsigned slot, int cx, double ex, int cy, double ey);
+    // 结果写入 x_res / y_res，坏条写入 bad_x / bad_y；诊断对象写到当前目录
+    void SolveRef(std::vector<NormResult>& x_res, std::vector<NormResult>& y_res,
+                  std::vector<int>& bad_x, std::vector<int>& bad_y);
+    void SolveGlobal(std::vector<NormResult>& x_res, std::vector<NormResult>& y_res,
+                     std::vector<int>& bad_x, std::vector<int>& bad_y);
+    bool WriteParams(const std::vector<NormResult>& x_res, const std::vector<NormResult>& y_res,
+                     const std::vector<int>& bad_x, const std::vector<int>& bad_y) const;
+
+    bool global_;
+    int ref_X_, ref_Y_;
+    bool auto_ref_;
+    HistBank hits_X_, hits_Y_;
+    HistBank bank_X_, bank_Y_;
+    std::vector<std::vector<Cand>> buffer_;
+    std::vector<std::vector<PairStat>> pairs_; // [slot][cx * NUM_DSSDY_POS + cy]，仅全局模式
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "Config.h"
+#include "CoinSelect.h"
+#include "DriftTable.h"
 #include "ROOT/RDataFrame.hxx"
 #include "TChain.h"
 #include "TSystem.h"
@@ -15,19 +17,20 @@ int main() {
     cout << "=== Step 0: Preselect decay/implant events ===" << endl;
 
     TChain chain(TREE_NAME);
-    for (int run = RUN_START; run <= RUN_END; ++run) {
-        TString fname = TString::Format(INPUT_DIR_PATTERN, run);
-        if (!gSystem->AccessPathName(fname)) {
-            chain.Add(fname);
-        }
-    }
+    const auto run_files = AddRunFiles(chain);
 
-    if (chain.GetListOfFiles()->GetEntries() == 0) {
+    if (run_files.empty()) {
         cerr << "[ERROR] No input files found." << endl;
         return 1;
     }
 
-    ROOT::RDataFrame df(chain);
+    CoinWindowTable coin;
+    const bool use_coin = USE_COIN_WINDOWS && coin.Load(COIN_WINDOW_FILE);
+    cout << "--> Coincidence: " << (use_coin ? string("windows from ") + COIN_WINDOW_FILE : string("multiplicities")) << endl;
+
+    ROOT::RDataFrame rdf(chain);
+    // RunNo：每个事件所在的 run（漂移跟踪按 run 切片用）；*_coin：窗口内的 MWPC / SSD / Veto hit 数
+    auto df = DefineCoincidence(DefineRunNo(rdf, run_files), use_coin ? &coin : nullptr);
     auto n_total = df.Count();
     cout << "--> Total entries in raw data: " << n_total.GetValue() << endl;
 
@@ -35,19 +38,20 @@ int main() {
         "DSSDX_Ch", "DSSDX_E", "DSSDX_mul",
         "DSSDY_Ch", "DSSDY_E", "DSSDY_mul",
         "DSSDYH_Ch","DSSDYH_E","DSSDYH_mul",
-        "MWPC_mul", "Veto_mul", "SSD_mul"
+        "MWPC_mul", "Veto_mul", "SSD_mul", "RunNo",
+        "MWPC_coin", "Veto_coin", "SSD_coin"
     };
 
     // [修改] 注入/植入事件筛选 (Implant)
     auto df_implant = df.Filter(
-        "MWPC_mul > 0 && DSSDX_mul == 1 && DSSDY_mul == 1 && "
-        "Veto_mul == 0 && SSD_mul == 0"
+        "MWPC_coin > 0 && DSSDX_mul == 1 && DSSDY_mul == 1 && "
+        "Veto_coin == 0 && SSD_coin == 0"
     );
 
     // 衰变事件筛选
     auto df_decay = df.Filter(
-        "MWPC_mul == 0 && DSSDX_mul == 1 && DSSDY_mul == 1 && "
-        "Veto_mul == 0 && SSD_mul == 0"
+        "MWPC_coin == 0 && DSSDX_mul == 1 && DSSDY_mul == 1 && "
+        "Veto_coin == 0 && SSD_coin == 0"
     );
 
     // [修改] 输出文件
@@ -1,5 +1,6 @@
 // 编译命令:
-// g++ SSD_calibration.cpp `root-config --cflags --libs` -lSpectrum -lRDataFrame -lTreePlayer -o SSD_calibration
+// g++ SSD_calibration.cpp -I../common `root-config --cflags --libs` -lSpectrum -lRDataFrame -lTreePlayer -o SSD_calibration
+// 用法: ./SSD_calibration [--png]    (--png: 输出 output_plot_dir 下的诊断图，同 config.h 的 save_diagnostic_plots)
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -11,12 +12,15 @@
 #include <stdexcept> 
 #include <numeric> 
 #include <thread> // 引入 thread 头文件
+#include <cmath>
 
 // RDataFrame 相关的头文件
 #include "ROOT/RDataFrame.hxx"
 #include "ROOT/RResultPtr.hxx"
 #include "ROOT/RVec.hxx"
-#include "ROOT/RDFHelpers.hxx" // For AddProgressBar, RunGraphs
+#include "ROOT/RDFHelpers.hxx" // For AddProgressBar
+#include "ROOT/TThreadExecutor.hxx"
+#include "ROOT/TSeq.hxx"
 
 #include "TChain.h"
 #include "TFile.h"
@@ -42,6 +46,8 @@
 
 // --- 包含项目配置文件 ---
 #include "config.h"
+#include "HistBank.h"
+#include "LineMatch.h"
 
 /* 函数：验证 config.h 中的参数是否合理 (保持不变)
 void validate_config() {
@@ -57,10 +63,209 @@ void validate_config() {
 }
 */
 
+// --- 单个位置的刻度结果 ---
+// 并行阶段每个任务只写自己位置的元素；诊断图和参数文件在主线程按位置顺序输出。
+struct PosResult {
+    double entries = 0;
+    double k = 1.0, b = 0.0;
+    double k_err = 0.0, b_err = 0.0, chi2 = 0.0;
+    int ndf = 0;
+    int confidence = -1;
+    double match_conf = 0.0;                    // LineMatch 置信度 (0-1)
+    std::unique_ptr<TH1> h_bg;                  // TSpectrum 背景 (enable_background_subtraction)
+    std::unique_ptr<TH1D> h_sub;                // 扣除背景后的能谱
+    std::vector<double> peaks_x;                // TSpectrum 找到的全部峰
+    std::vector<bool> peak_used;                // 是否用于刻度
+    std::vector<double> cal_points, ref_points; // 最终参与拟合的点
+};
+
+// 等权最小二乘直线 E = k * Ch + b。
+// 解析求解，不经过 TF1/TGraph::Fit 的全局函数表，可在工作线程中调用；
+// 参数误差按 sqrt(chi2/ndf) 缩放，与 TGraph::Fit("pol1") 对无误差数据点的处理一致。
+static bool FitLine(const std::vector<double>& x, const std::vector<double>& y, PosResult& r) {
+    const size_t n = x.size();
+    if (n < 2) return false;
+    double Sx = 0, Sy = 0, Sxx = 0, Sxy = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Sx += x[i]; Sy += y[i]; Sxx += x[i] * x[i]; Sxy += x[i] * y[i];
+    }
+    const double denom = n * Sxx - Sx * Sx;
+    if (std::fabs(denom) < 1e-12) return false;
+    const double k = (n * Sxy - Sx * Sy) / denom;
+    const double b = (Sy - k * Sx) / n;
+    if (!std::isfinite(k) || !std::isfinite(b)) return false;
+
+    double chi2 = 0;
+    for (size_t i = 0; i < n; ++i) chi2 += (y[i] - k * x[i] - b) * (y[i] - k * x[i] - b);
+    r.k = k; r.b = b;
+    r.chi2 = chi2;
+    r.ndf = static_cast<int>(n) - 2;
+    const double s2 = (r.ndf > 0) ? chi2 / r.ndf : 1.0;
+    r.k_err = std::sqrt(n / denom * s2);
+    r.b_err = std::sqrt(Sxx / denom * s2);
+    return true;
+}
+
+// 一个位置: 背景扣除 -> 寻峰 -> 选峰 -> 线性拟合。
+// 只读 h_sum_E，TSpectrum 和直方图都是任务自己的 (goff，不画图)，所以 48 个位置可以并行。
+static void CalibratePosition(int pos, const TH1D* h_sum_E, PosResult& r) {
+    r.entries = h_sum_E->GetEntries();
+    if (r.entries < MIN_HIST_ENTRIES) {
+        r.confidence = -1;
+        return;
+    }
+    TSpectrum s;
+
+    // --- 步骤 4.1: 背景扣除 ---
+    r.h_sub.reset((TH1D*)h_sum_E->Clone(TString::Format("h_sub_pos%d", pos)));
+    if (enable_background_subtraction) {
+        r.h_bg.reset(s.Background(h_sum_E, background_iterations, ""));
+        r.h_sub->Add(r.h_bg.get(), -1);
+    }
+
+    // --- 步骤 4.2: 自动寻峰 ---
+    Int_t n_found = s.Search(r.h_sub.get(), peak_search_sigma, "goff", peak_search_threshold);
+    Double_t* found_peaks_x = s.GetPositionX();
+    r.peaks_x.assign(found_peaks_x, found_peaks_x + std::max(n_found, 0));
+    r.peak_used.assign(r.peaks_x.size(), false);
+
+    // --- 步骤 4.2b: 峰识别 ---
+    // 所有峰与参考能量按 E = k*Ch + b 整体匹配 (LineMatch.h)，取代每个峰的固定搜索窗口
+    std::vector<LinePeak> cands;
+    for (double x : r.peaks_x) cands.push_back({x, r.h_sub->GetBinContent(r.h_sub->FindBin(x))});
+    std::vector<RefLine> lines;
+    for (const auto& p_interest : peaks_of_interest) lines.push_back({p_interest.ref_E, p_interest.tol});
+    LineMatchOptions opt;
+    opt.kMin = match_k_min;
+    opt.kMax = match_k_max;
+    opt.tolX = match_tol_ch;
+    LineMatchResult m = MatchLines(cands, lines, opt);
+    r.match_conf = m.confidence;
+
+    std::vector<double>& cal_points = r.cal_points;
+    std::vector<double>& ref_points = r.ref_points;
+    for (size_t j = 0; j < lines.size(); ++j) {
+        if (!m.ok || m.cand[j] < 0) continue;
+        cal_points.push_back(m.x[j]);
+        ref_points.push_back(lines[j].energy);
+        r.peak_used[m.cand[j]] = true;
+    }
+
+    // --- 步骤 4.3: 线性拟合 ---
+    if (cal_points.size() < 2) {
+        r.k = 1.0; r.b = 0.0;
+        r.confidence = cal_points.size();
+        return;
+    }
+    // --- POS % 8 >= 3 拟合逻辑: 先用全部点拟合，只保留残差最小的两个点 ---
+    if (pos % 8 >= 3 && cal_points.size() >= 3) {
+        PosResult full;
+        if (FitLine(cal_points, ref_points, full)) {
+            std::vector<std::pair<double, int>> residuals;
+            for (size_t i = 0; i < cal_points.size(); ++i) {
+                double E_cal = full.k * cal_points[i] + full.b;
+                residuals.push_back({TMath::Abs(ref_points[i] - E_cal), (int)i});
+            }
+            std::sort(residuals.begin(), residuals.end());
+            const int idx1 = residuals[0].second;
+            const int idx2 = residuals[1].second;
+            cal_points = {cal_points[idx1], cal_points[idx2]};
+            ref_points = {ref_points[idx1], ref_points[idx2]};
+        }
+    }
+    if (FitLine(cal_points, ref_points, r)) {
+        r.confidence = cal_points.size();
+    } else {
+        r.k = 1.0; r.b = 0.0;
+        r.confidence = 0;
+    }
+}
+
+// 诊断图 (仅在 save_diagnostic_plots / --png 时调用，主线程)
+static void DrawPosition(int pos, TH1D* h_sum_E, PosResult& r, TCanvas* canvas) {
+    if (!r.h_sub) return;
+
+    // --- 1. 原始能谱 + 背景 ---
+    if (r.h_bg) {
+        canvas->Clear();
+        h_sum_E->Draw();
+        r.h_bg->SetLineColor(kRed);
+        r.h_bg->Draw("same");
+        auto leg_bg = std::make_unique<TLegend>(0.7, 0.75, 0.9, 0.9);
+        leg_bg->AddEntry(h_sum_E, "Original Spectrum", "l");
+        leg_bg->AddEntry(r.h_bg.get(), "Estimated Background", "l");
+        leg_bg->Draw();
+        canvas->SaveAs(TString::Format("%s/pos_%d_1_background.png", output_plot_dir, pos));
+    }
+
+    // --- 2. 寻峰结果 ---
+    canvas->Clear();
+    r.h_sub->SetTitle(TString::Format("Peak Search for Pos %d (Found %d peaks)", pos, (int)r.peaks_x.size()));
+    r.h_sub->Draw();
+    std::vector<std::unique_ptr<TMarker>> markers;
+    TMarker* used_marker_proxy = nullptr;
+    TMarker* other_marker_proxy = nullptr;
+    for (size_t i = 0; i < r.peaks_x.size(); ++i) {
+        double peak_x = r.peaks_x[i];
+        double peak_y = r.h_sub->GetBinContent(r.h_sub->FindBin(peak_x));
+        auto m = std::make_unique<TMarker>(peak_x, peak_y, 20);
+        if (r.peak_used[i]) {
+            m->SetMarkerColor(kRed); m->SetMarkerStyle(29); m->SetMarkerSize(2.0);
+            if (!used_marker_proxy) used_marker_proxy = m.get();
+        } else {
+            m->SetMarkerColor(kGreen); m->SetMarkerStyle(3); m->SetMarkerSize(1.5);
+            if (!other_marker_proxy) other_marker_proxy = m.get();
+        }
+        m->Draw("same");
+        markers.push_back(std::move(m));
+    }
+    auto leg_peaks = std::make_unique<TLegend>(0.7, 0.75, 0.9, 0.9);
+    if (used_marker_proxy) leg_peaks->AddEntry(used_marker_proxy, "Peaks for Calibration", "p");
+    if (other_marker_proxy) leg_peaks->AddEntry(other_marker_proxy, "Other Found Peaks", "p");
+    leg_peaks->Draw();
+    canvas->SaveAs(TString::Format("%s/pos_%d_2_peak_search.png", output_plot_dir, pos));
+
+    // --- 3. 线性拟合 ---
+    if (r.confidence < 2) return;
+    canvas->Clear();
+    auto gr = std::make_unique<TGraph>(r.cal_points.size(), r.cal_points.data(), r.ref_points.data());
+    gr->SetTitle(TString::Format("Linear Fit for Pos %d", pos));
+    gr->GetXaxis()->SetTitle("Measured Peak Position (channels)");
+    gr->GetYaxis()->SetTitle("Reference Energy (keV)");
+    gr->SetMarkerStyle(20); gr->SetMarkerSize(1.5);
+    gr->Draw("AP");
+    auto line = std::make_unique<TF1>(TString::Format("f_line_pos%d", pos), "pol1",
+                                      gr->GetXaxis()->GetXmin(), gr->GetXaxis()->GetXmax());
+    line->SetParameters(r.b, r.k);
+    line->SetLineColor(kRed);
+    line->Draw("same");
+
+    auto pt = std::make_unique<TPaveText>(0.2, 0.65, 0.6, 0.85, "NDC");
+    pt->SetFillColor(0); pt->SetBorderSize(1); pt->SetTextAlign(12);
+    pt->AddText(TString::Format("Fit: E = k * Ch + b"));
+    pt->AddText(TString::Format("k = %.5f #pm %.5f", r.k, r.k_err));
+    pt->AddText(TString::Format("b = %.2f #pm %.2f keV", r.b, r.b_err));
+    pt->AddText(TString::Format("#chi^{2} / NDF = %.2f / %d", r.chi2, r.ndf));
+    pt->Draw();
+
+    // --- 能量信息显示 ---
+    auto pt_E = std::make_unique<TPaveText>(0.65, 0.2, 0.9, 0.45, "NDC");
+    pt_E->SetFillColor(0); pt_E->SetBorderSize(1); pt_E->SetTextAlign(12);
+    pt_E->AddText("Calibration Points:");
+    pt_E->AddText("Ch | Ref E -> Cal E (keV)");
+    for (size_t i = 0; i < r.cal_points.size(); ++i) {
+        double Channel = r.cal_points[i];
+        pt_E->AddText(TString::Format("%.0f | %.2f -> %.2f", Channel, r.ref_points[i], r.k * Channel + r.b));
+    }
+    pt_E->Draw();
+    canvas->SaveAs(TString::Format("%s/pos_%d_3_linear_fit.png", output_plot_dir, pos));
+}
+
 ErrorCode calibrate_ssd_professional() {
     gROOT->SetBatch(kTRUE);
     gStyle->SetOptStat(0);
-    gSystem->mkdir(output_plot_dir, kTRUE);
+    TH1::AddDirectory(kFALSE); // 背景/克隆直方图由各任务自己持有，不挂到 gDirectory
+    if (save_diagnostic_plots) gSystem->mkdir(output_plot_dir, kTRUE);
 
     // --- 步骤 0: 启用多核并行 ---
     // 修正错误 1: 避免 GetImplicitMTRuntime() 的兼容性问题
@@ -71,261 +276,74 @@ ErrorCode calibrate_ssd_professional() {
 
     // --- 1. RDataFrame 准备 ---
     ROOT::RDataFrame df(tree_name, input_root_file);
-    auto n_entries = df.Count();
+    auto n_entries = df.Count(); // lazy: 与下面的填充在同一次事件循环中完成
+
+    // 全局事件削减只做一次 (config.h 的 global_event_cut)
+    ROOT::RDF::RNode df_sel(df);
+    if (!std::string(global_event_cut).empty()) {
+        df_sel = df.Filter(global_event_cut, "Global Cut");
+    }
+
+    // --- 2. 单遍填充 48 个位置的能谱 ---
+    // 每个 hit 按 Nint(SSD_Pos) 直接落到对应位置的直方图 (HistBank，每个 slot 一块连续数组)，
+    // 取代原来的 48 组 Define/Filter/Histo1D (每个事件要构造 48 个 RVec)。
+    HistBank bank(NUM_SSD_POS, SUM_E_BINS, SUM_E_MIN, SUM_E_MAX, df.GetNSlots());
+    auto fill = [&](unsigned int slot, const ROOT::RVec<double>& dssd_e, const ROOT::RVec<double>& ssd_e,
+                    const ROOT::RVec<double>& ssd_pos, UInt_t chain_mul) {
+        // 确保索引有效
+        const size_t n = std::min<size_t>({(size_t)chain_mul, dssd_e.size(), ssd_e.size(), ssd_pos.size()});
+        for (size_t i = 0; i < n; ++i) {
+            if (dssd_e[i] <= 0 || ssd_e[i] <= 0) continue; // 无效 hits
+            const int pos = TMath::Nint(ssd_pos[i]);
+            if (pos < 0 || pos >= NUM_SSD_POS) continue;
+            bank.Fill(slot, pos, dssd_e[i] + ssd_e[i]);
+        }
+    };
+
+    // --- 3. 运行 RDataFrame (多核) ---
+    std::cout << "\n    Executing RDataFrame event loop (filling " << NUM_SSD_POS << " histograms in one pass)..." << std::endl;
+    ROOT::RDF::Experimental::AddProgressBar(df);
+    df_sel.ForeachSlot(fill, {"DSSD_E", "SSD_E", "SSD_Pos", "chain_mul"});
+    std::cout << "    RDataFrame execution finished." << std::endl;
     std::cout << "    Total entries in TTree: " << *n_entries << std::endl;
     if (*n_entries == 0) {
         std::cerr << "Error: No entries found in TTree." << std::endl;
         return FILE_NOT_FOUND;
     }
 
-    // 定义一个 Lambda 函数，用于计算 Energy_Sum
-    auto df_base = df.Define("Energy_Sum", [](const ROOT::RVec<double>& dssd_e, const ROOT::RVec<double>& ssd_e, UInt_t chain_mul) {
-        ROOT::RVec<double> sum_e;
-        for (UInt_t i = 0; i < chain_mul; ++i) {
-             if (dssd_e[i] > 0 && ssd_e[i] > 0) {
-                 sum_e.push_back(dssd_e[i] + ssd_e[i]);
-             } else {
-                 sum_e.push_back(-999.0); // 标记无效 hits
-             }
-        }
-        return sum_e;
-    }, {"DSSD_E", "SSD_E", "chain_mul"});
-
-    // --- 2. 并行绘制 48 个能谱 (TH1D) ---
-    std::vector<ROOT::RDF::RResultPtr<TH1D>> hists;
+    bank.Merge(num_threads);
+    std::vector<std::unique_ptr<TH1D>> hists(NUM_SSD_POS);
     for (int pos = 0; pos < NUM_SSD_POS; ++pos) {
-        
-        // --- 修正错误 3 和 4 的逻辑 ---
-        // 步骤 1: 根据 SSD_Pos 筛选出对应的 Energy_Sum 和 SSD_Pos 数组元素
-        auto df_pos_data = df_base.Define(TString::Format("Pos%d_Energy", pos), [pos](const ROOT::RVec<double>& energy_sum, const ROOT::RVec<double>& ssd_pos_vec, UInt_t chain_mul) {
-            ROOT::RVec<double> pos_energy;
-            for (UInt_t i = 0; i < chain_mul; ++i) {
-                // 确保索引有效，且 Pos 匹配
-                if (i < ssd_pos_vec.size() && TMath::Nint(ssd_pos_vec[i]) == pos && energy_sum[i] > 0) {
-                    pos_energy.push_back(energy_sum[i]);
-                }
-            }
-            return pos_energy;
-        }, {"Energy_Sum", "SSD_Pos", "chain_mul"});
-
-        // 步骤 2: 应用全局时间削减 (修正错误 2: global_event_cut 检查)
-        // 注意：这里需要确保 global_event_cut 已经被正确包含在 config.h 并定义
-       ROOT::RDF::RNode df_to_plot(df_pos_data);
-        if (!std::string(global_event_cut).empty()) {
-        df_to_plot = df_pos_data.Filter(global_event_cut, TString::Format("Global Cut for Pos %d", pos));
-        }
-
-
-
-        // 步骤 3: 仅对包含至少一个目标 Pos hit 的事件进行绘图
-        hists.push_back(
-    // 调用 .Data() 将 TString 转换为 const char*，让 RDataFrame 识别为表达式
-    df_to_plot.Filter(TString::Format("Pos%d_Energy.size() > 0", pos).Data()) 
-    .Histo1D(
-        {TString::Format("h_sum_E_pos%d", pos),
-         TString::Format("Energy Spectrum for Pos %d;Energy Sum (channels);Counts", pos),
-         700, 3000, 10000},
-        TString::Format("Pos%d_Energy", pos)
-    )
-);
+        hists[pos] = bank.ToTH1D(pos,
+            TString::Format("h_sum_E_pos%d", pos),
+            TString::Format("Energy Spectrum for Pos %d;Energy Sum (channels);Counts", pos));
     }
-    
-    // --- 3. 运行 RDataFrame (多核) ---
-    std::cout << "\n    Executing RDataFrame tasks (plotting " << NUM_SSD_POS << " histograms)..." << std::endl;
-
-    // 修正错误 5: 将 RResultPtr 转换为 RResultHandle 的 vector
-    std::vector<ROOT::RDF::RResultHandle> tasks;
-    tasks.reserve(hists.size());
-    for (auto& h : hists) {
-        tasks.push_back(h);
-    }
-    
-    // 添加进度条并触发事件循环
-    ROOT::RDF::Experimental::AddProgressBar(df); 
-    ROOT::RDF::RunGraphs(tasks);
-    std::cout << "    RDataFrame execution finished." << std::endl;
-
-
-    // --- 4. 单核寻峰和拟合 ---
-    std::map<int, double> k_params, b_params;
-    std::map<int, int> confidence;
-    auto canvas = std::make_unique<TCanvas>("canvas", "Calibration Canvas", 1200, 900);
-    auto s = std::make_unique<TSpectrum>();
 
-    std::cout << "\n--> Starting single-core fitting process (TSpectrum + TGraph)..." << std::endl;
+    // --- 4. 并行寻峰和拟合: 每个位置一个任务，结果按位置下标保存 ---
+    std::cout << "\n--> Starting parallel fitting process (TSpectrum + line fit, one task per position)..." << std::endl;
+    std::vector<PosResult> results(NUM_SSD_POS);
+    ROOT::TThreadExecutor pool;
+    pool.Foreach([&](int pos) {
+        CalibratePosition(pos, hists[pos].get(), results[pos]);
+    }, ROOT::TSeqI(NUM_SSD_POS));
 
+    // 按位置顺序输出日志 (及诊断图)
+    std::unique_ptr<TCanvas> canvas;
+    if (save_diagnostic_plots) canvas = std::make_unique<TCanvas>("canvas", "Calibration Canvas", 1200, 900);
     for (int pos = 0; pos < NUM_SSD_POS; ++pos) {
-        TH1D* h_sum_E = hists[pos].GetPtr(); // 从 RResultPtr 获取指针
-        
-        std::cout << "    Processing Pos " << pos << " (Entries: " << h_sum_E->GetEntries() << ")..." << std::endl;
-
-        if (h_sum_E->GetEntries() < MIN_HIST_ENTRIES) {
+        PosResult& r = results[pos];
+        std::cout << "    Processing Pos " << pos << " (Entries: " << r.entries << ", matched "
+                  << r.cal_points.size() << " peaks, match confidence " << r.match_conf << ")..." << std::endl;
+        if (r.confidence == -1) {
             std::cerr << "    Warning: Insufficient data for Pos " << pos << ". Skipping." << std::endl;
-            k_params[pos] = 1.0; b_params[pos] = 0.0; confidence[pos] = -1; 
-            continue;
-        }
-
-        // --- 步骤 4.1: 背景扣除 ---
-        std::unique_ptr<TH1D> h_sub; 
-        if (enable_background_subtraction) {
-            canvas->Clear();
-            TH1 *h_bg_raw = s->Background(h_sum_E, background_iterations, "same");
-            auto h_bg = std::unique_ptr<TH1>(h_bg_raw); 
-            
-            h_sum_E->Draw();
-            h_bg->SetLineColor(kRed);  
-            h_bg->Draw("same"); 
-            auto leg_bg = std::make_unique<TLegend>(0.7, 0.75, 0.9, 0.9);
-            leg_bg->AddEntry(h_sum_E, "Original Spectrum", "l");
-            leg_bg->AddEntry(h_bg.get(), "Estimated Background", "l");
-            leg_bg->Draw();
-            canvas->SaveAs(TString::Format("%s/pos_%d_1_background.png", output_plot_dir, pos));
-            
-            h_sub.reset((TH1D*)h_sum_E->Clone(TString::Format("h_sub_pos%d", pos)));
-            h_sub->Add(h_bg.get(), -1);
-        } else {
-            h_sub.reset((TH1D*)h_sum_E->Clone(TString::Format("h_sub_pos%d", pos)));
-        }
-
-
-        // --- 步骤 4.2: 自动寻峰 ---
-        Int_t n_found = s->Search(h_sub.get(), peak_search_sigma, "", peak_search_threshold);
-        Double_t *found_peaks_x = s->GetPositionX();
-        
-        std::vector<double> cal_points, ref_points;
-        std::vector<std::unique_ptr<TMarker>> used_markers, other_markers;
-        std::vector<bool> is_peak_used(n_found, false);
-
-        for(const auto& p_interest : peaks_of_interest) {
-            double best_peak_x = -1;
-            double max_peak_y = 0;
-            int best_peak_idx = -1;
-            for (int i = 0; i < n_found; ++i) {
-                if (found_peaks_x[i] > p_interest.win_min && found_peaks_x[i] < p_interest.win_max) {
-                    double current_peak_y = h_sub->GetBinContent(h_sub->FindBin(found_peaks_x[i]));
-                    if (current_peak_y > max_peak_y) {
-                        max_peak_y = current_peak_y;
-                        best_peak_x = found_peaks_x[i];
-                        best_peak_idx = i;
-                    }
-                }
-            }
-            if (best_peak_x > 0) {
-                cal_points.push_back(best_peak_x);
-                ref_points.push_back(p_interest.ref_E);
-                if (best_peak_idx != -1) is_peak_used[best_peak_idx] = true;
-            }
-        }
-        
-        canvas->Clear();
-        h_sub->SetTitle(TString::Format("Peak Search for Pos %d (Found %d peaks)", pos, n_found));
-        h_sub->Draw();
-        TMarker* used_marker_proxy = nullptr;
-        TMarker* other_marker_proxy = nullptr;
-        for (int i = 0; i < n_found; ++i) {
-            double peak_x = found_peaks_x[i];
-            double peak_y = h_sub->GetBinContent(h_sub->FindBin(peak_x));
-            auto m = std::make_unique<TMarker>(peak_x, peak_y, 20);
-            if (is_peak_used[i]) {
-                m->SetMarkerColor(kRed); m->SetMarkerStyle(29); m->SetMarkerSize(2.0);
-                m->Draw("same");
-                if (!used_marker_proxy) used_marker_proxy = m.get();
-                used_markers.push_back(std::move(m));
-            } else {
-                m->SetMarkerColor(kGreen); m->SetMarkerStyle(3); m->SetMarkerSize(1.5);
-                m->Draw("same");
-                if (!other_marker_proxy) other_marker_proxy = m.get();
-                other_markers.push_back(std::move(m));
-            }
-        }
-
-        auto leg_peaks = std::make_unique<TLegend>(0.7, 0.75, 0.9, 0.9);
-        if (used_marker_proxy) leg_peaks->AddEntry(used_marker_proxy, "Peaks for Calibration", "p");
-        if (other_marker_proxy) leg_peaks->AddEntry(other_marker_proxy, "Other Found Peaks", "p");
-        leg_peaks->Draw();
-        canvas->SaveAs(TString::Format("%s/pos_%d_2_peak_search.png", output_plot_dir, pos));
-
-
-        // --- 步骤 4.3: 线性拟合 ---
-        if (cal_points.size() < 2) {
+        } else if (r.cal_points.size() < 2) {
             std::cerr << "    Warning: Fewer than 2 peaks found for Pos " << pos << ". Cannot perform fit. Using default parameters." << std::endl;
-            k_params[pos] = 1.0; b_params[pos] = 0.0;
-            confidence[pos] = cal_points.size();
-        }
-         else {
-            // --- POS % 8 >= 3 拟合逻辑 ---
-            if (pos % 8 >= 3 && cal_points.size() >= 3) {
-                auto gr_temp = std::make_unique<TGraph>(cal_points.size(), cal_points.data(), ref_points.data());
-                TFitResultPtr r_temp = gr_temp->Fit("pol1", "S Q");
-                
-                if (r_temp.Get()) {
-                    double k_full = r_temp->Parameter(1);
-                    double b_full = r_temp->Parameter(0);
-                    std::vector<std::pair<double, int>> residuals; 
-                    for (size_t i = 0; i < cal_points.size(); ++i) {
-                        double E_cal = k_full * cal_points[i] + b_full; 
-                        double residual = TMath::Abs(ref_points[i] - E_cal); 
-                        residuals.push_back({residual, (int)i});
-                    }
-                    std::sort(residuals.begin(), residuals.end());
-                    int idx1 = residuals[0].second;
-                    int idx2 = residuals[1].second;
-                    
-                    std::vector<double> filtered_cal, filtered_ref;
-                    filtered_cal.push_back(cal_points[idx1]);
-                    filtered_cal.push_back(cal_points[idx2]);
-                    filtered_ref.push_back(ref_points[idx1]);
-                    filtered_ref.push_back(ref_points[idx2]);
-                    
-                    cal_points = std::move(filtered_cal);
-                    ref_points = std::move(filtered_ref);
-                    
-                }
-            }
-            auto gr = std::make_unique<TGraph>(cal_points.size(), cal_points.data(), ref_points.data());
-            TFitResultPtr r = gr->Fit("pol1", "S Q");
-            if (r.Get()) {
-                k_params[pos] = r->Parameter(1);
-                b_params[pos] = r->Parameter(0);
-                confidence[pos] = cal_points.size();
-                canvas->Clear();
-                gr->SetTitle(TString::Format("Linear Fit for Pos %d", pos));
-                gr->GetXaxis()->SetTitle("Measured Peak Position (channels)");
-                gr->GetYaxis()->SetTitle("Reference Energy (keV)");
-                gr->SetMarkerStyle(20); gr->SetMarkerSize(1.5);
-                gr->Draw("AP");
-                auto pt = std::make_unique<TPaveText>(0.2, 0.65, 0.6, 0.85, "NDC");
-                pt->SetFillColor(0); pt->SetBorderSize(1); pt->SetTextAlign(12);
-                pt->AddText(TString::Format("Fit: E = k * Ch + b"));
-                pt->AddText(TString::Format("k = %.5f #pm %.5f", r->Parameter(1), r->ParError(1)));
-                pt->AddText(TString::Format("b = %.2f #pm %.2f keV", r->Parameter(0), r->ParError(0)));
-                pt->AddText(TString::Format("#chi^{2} / NDF = %.2f / %d", r->Chi2(), r->Ndf()));
-                pt->Draw();
-
-                // --- 能量信息显示 ---
-                auto pt_E = std::make_unique<TPaveText>(0.65, 0.2, 0.9, 0.45, "NDC");
-                pt_E->SetFillColor(0); pt_E->SetBorderSize(1); pt_E->SetTextAlign(12);
-                pt_E->AddText("Calibration Points:");
-                pt_E->AddText("Ch | Ref E -> Cal E (keV)"); 
-                
-                double k_fit = r->Parameter(1);
-                double b_fit = r->Parameter(0);
-
-                for (size_t i = 0; i < cal_points.size(); ++i) {
-                    double E_ref = ref_points[i];
-                    double Channel = cal_points[i];
-                    double E_cal = k_fit * Channel + b_fit;
-                    pt_E->AddText(TString::Format("%.0f | %.2f -> %.2f", Channel, E_ref, E_cal));
-                }
-                pt_E->Draw();
-                canvas->SaveAs(TString::Format("%s/pos_%d_3_linear_fit.png", output_plot_dir, pos));
-            } else {
-                 std::cerr << "    Error: Fit failed for Pos " << pos << ". Using default parameters." << std::endl;
-                 k_params[pos] = 1.0; b_params[pos] = 0.0;
-                 confidence[pos] = 0; 
-            }
+        } else if (r.confidence == 0) {
+            std::cerr << "    Error: Fit failed for Pos " << pos << ". Using default parameters." << std::endl;
         }
+        if (canvas) DrawPosition(pos, hists[pos].get(), r, canvas.get());
     }
+
     // --- 步骤 5: 保存参数文件 ---
     std::cout << "\n--> Writing calibration parameters to " << calibration_param_file << "..." << std::endl;
     std::ofstream txt_out(calibration_param_file);
@@ -335,9 +353,8 @@ ErrorCode calibrate_ssd_professional() {
     }
     txt_out << "# Pos\tk\tb\tconfidence" << std::endl;
     for (int pos = 0; pos < NUM_SSD_POS; ++pos) {
-        if(k_params.count(pos)) {
-            txt_out << pos << "\t" << k_params[pos] << "\t" << b_params[pos] << "\t" << confidence[pos] << std::endl;
-        }
+        const PosResult& r = results[pos];
+        txt_out << pos << "\t" << r.k << "\t" << r.b << "\t" << r.confidence << std::endl;
     }
     txt_out.close();
     
@@ -350,6 +367,14 @@ ErrorCode calibrate_ssd_professional() {
 int main(int argc, char* argv[]) {
     // 增加 try-catch 块以捕获配置或运行时的错误
     try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string a = argv[i];
+            if (a == "--png") save_diagnostic_plots = true;
+            else {
+                std::cerr << "Error: unknown option " << a << " (usage: " << argv[0] << " [--png])" << std::endl;
+                return 1;
+            }
+        }
         ErrorCode status = calibrate_ssd_professional();
         
         if (status == SUCCESS) {
@@ -24,18 +24,22 @@ const char* tree_name = "tr_chain";
 
 
 // --- 3. 刻度峰配置 ---
-// 用于刻度的参考α粒子能量 (keV) 及其搜索窗口 (channel)
+// 用于刻度的参考α粒子能量 (keV) 及匹配容差 (keV)
+// 不再为每个峰手动设搜索窗口：寻到的峰与参考能量按 E = k*Ch + b 整体匹配 (../common/LineMatch.h)
 struct CalibrationPeak {
-    double win_min;
-    double win_max;
     double ref_E;
+    double tol;
 };
 
 std::vector<CalibrationPeak> peaks_of_interest = {
-    {6000, 6400, 6111.0},
-    {7300, 7700, 7447.0},
-    {5100, 5500, 5307.0}
+    {6111.0, 30.0},
+    {7447.0, 30.0},
+    {5307.0, 30.0}
 };
+// 匹配时增益 k (keV/channel) 的搜索范围，以及按道址计的额外容差 (容差 = tol + k * match_tol_ch)
+const double match_k_min = 0.8;
+const double match_k_max = 1.25;
+const double match_tol_ch = 2.0;
 
 // --- 3.1 背景扣除参数 ---
 // 是否启用背景扣除功能 (true = 开启, false = 关闭)
@@ -50,6 +54,15 @@ const double peak_search_sigma = 2.0;
 // TSpectrum 寻峰的阈值 (0到1之间)
 const double peak_search_threshold = 0.25;
 
+// --- 3.3 能谱与诊断图 ---
+// DSSD_E + SSD_E 能谱的分 bin (channel)
+const int SUM_E_BINS = 700;
+const double SUM_E_MIN = 3000;
+const double SUM_E_MAX = 10000;
+// 是否输出 output_plot_dir 下的 PNG 诊断图 (命令行 --png 可临时打开)
+// 关闭时只输出参数文件，不创建画布、不渲染
+bool save_diagnostic_plots = false;
+
 // --- 4. 物理和程序参数 ---
 // 使用的线程数 
 int num_threads = 12; // 12核心
@@ -72,7 +85,8 @@ enum ErrorCode {
     TREE_NOT_FOUND = 2,
     BRANCH_NOT_FOUND = 3,
     INSUFFICIENT_DATA = 4,
-    CONFIG_ERROR = 5
+    CONFIG_ERROR = 5,
+    VERIFY_ERROR = 6   // 输出回读核对失败（apply_calibration）
 };
 // --- 7. 附加全局削减 ---
 // 应用于TChain::Draw的全局事件削减条件 (ROOT TCut format)
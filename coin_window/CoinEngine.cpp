@@ -0,0 +1,164 @@
+#include "CoinEngine.h"
+#include "ROOT/RVec.hxx"
+#include "TFile.h"
+#include "TString.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+using ROOT::VecOps::RVec;
+
+static const CoinAxis& DtAxis(CoinPair p) {
+    switch (p) {
+        case kPairDSSD: return DT_DSSD_AXIS;
+        case kPairSSD:  return DT_SSD_AXIS;
+        case kPairVeto: return DT_VETO_AXIS;
+        default:        return DT_MWPC_AXIS;
+    }
+}
+
+static const CoinAxis& EAxis(CoinPair p) { return (p == kPairSSD) ? E_SSD_AXIS : E_BEAM_AXIS; }
+
+// 时间戳差：先做整数减法（ns 量级的 ULong64_t 转 double 会丢精度）
+static inline double TsDiff(ULong64_t a, ULong64_t b) {
+    return static_cast<double>(static_cast<int64_t>(a - b));
+}
+
+CoinEngine::CoinEngine(unsigned n_slots) {
+    ediff_ = make_unique<HistBank>(1, EDIFF_AXIS.nb, EDIFF_AXIS.lo, EDIFF_AXIS.hi, n_slots);
+    for (int p = 0; p < kNumPairs; ++p) {
+        const CoinAxis& dt = DtAxis(static_cast<CoinPair>(p));
+        const CoinAxis& e = EAxis(static_cast<CoinPair>(p));
+        const int ng = NumGroups(static_cast<CoinPair>(p));
+        dt_.push_back(make_unique<HistBank>(ng, dt.nb, dt.lo, dt.hi, n_slots));
+        // E-vs-ΔT 图较大，不按 slot 复制
+        edt_.push_back(make_unique<HistBank>(ng, dt.nb, dt.lo, dt.hi, e.nb, e.lo, e.hi, n_slots,
+                                             HistBank::Mode::kAtomic));
+    }
+    ssd_group_.resize(NUM_SSD_CH);
+    for (int ch = 0; ch < NUM_SSD_CH; ++ch) ssd_group_[ch] = ch / max(1, SSD_GROUP_SIZE);
+}
+
+int CoinEngine::NumGroups(CoinPair p) {
+    switch (p) {
+        case kPairSSD:  return (NUM_SSD_CH + max(1, SSD_GROUP_SIZE) - 1) / max(1, SSD_GROUP_SIZE);
+        case kPairMWPC: return NUM_MWPC_CH;
+        case kPairVeto: return NUM_VETO_CH;
+        default:        return 1;
+    }
+}
+
+// 与旧的 analyze_rdf*.cpp 相同的名字
+string CoinEngine::DtName(CoinPair p, int g) {
+    const int gs = max(1, SSD_GROUP_SIZE);
+    switch (p) {
+        case kPairDSSD:   return "DSSD_tdiff";
+        case kPairSSD:    return Form("SSD_tdiff_%d_%d", g * gs, min(NUM_SSD_CH, (g + 1) * gs) - 1);
+        case kPairMWPC:   return Form("MWPC_tdiff_%d", g);
+        case kPairMWPC01: return "MWPC_tdiff_MWPC";
+        case kPairVeto:   return Form("Veto_tdiff_%d", g);
+        default:          return "";
+    }
+}
+
+string CoinEngine::EDtName(CoinPair p, int g) {
+    const int gs = max(1, SSD_GROUP_SIZE);
+    switch (p) {
+        case kPairDSSD:   return "DSSD_E_vs_tdiff";
+        case kPairSSD:    return Form("SSD_E_vs_tdiff_%d_%d", g * gs, min(NUM_SSD_CH, (g + 1) * gs) - 1);
+        case kPairMWPC:   return Form("MWPC_E_vs_tdiff_%d", g);
+        case kPairMWPC01: return "MWPC_E_vs_tdiff";
+        case kPairVeto:   return Form("Veto_E_vs_tdiff_%d", g);
+        default:          return "";
+    }
+}
+
+string CoinEngine::Title(CoinPair p, int g) {
+    const int gs = max(1, SSD_GROUP_SIZE);
+    switch (p) {
+        case kPairDSSD:   return "DSSD X-Y;T_x - T_y (ns)";
+        case kPairSSD:    return Form("DSSD-SSD (Ch %d-%d);T_DSSD - T_SSD (ns)", g * gs, min(NUM_SSD_CH, (g + 1) * gs) - 1);
+        case kPairMWPC:   return Form("DSSD-MWPC (Ch %d);T_DSSD - T_MWPC (ns)", g);
+        case kPairMWPC01: return "MWPC[0]-MWPC[1];T_MWPC[0] - T_MWPC[1] (ns)";
+        case kPairVeto:   return Form("DSSD-Veto (Ch %d);T_DSSD - T_Veto (ns)", g);
+        default:          return "";
+    }
+}
+
+void CoinEngine::GroupChannels(CoinPair p, int g, int& ch_lo, int& ch_hi) {
+    const int gs = max(1, SSD_GROUP_SIZE);
+    switch (p) {
+        case kPairSSD:  ch_lo = g * gs; ch_hi = min(NUM_SSD_CH, (g + 1) * gs) - 1; break;
+        case kPairMWPC:
+        case kPairVeto: ch_lo = ch_hi = g; break;
+        default:        ch_lo = ch_hi = 0; break;
+    }
+}
+
+inline void CoinEngine::Fill(unsigned slot, CoinPair p, int g, double dt, double e) {
+    dt_[p]->Fill(slot, g, dt);
+    edt_[p]->Fill(slot, g, dt, e);
+}
+
+unsigned long long CoinEngine::Run(ROOT::RDF::RNode df) {
+    vector<unsigned long long> n_events(df.GetNSlots(), 0);
+
+    df.ForeachSlot([&](unsigned int s, UShort_t xm, UShort_t ym, UShort_t sm, UShort_t mm, UShort_t vm,
+                       const RVec<double>& xe, const RVec<double>& ye,
+                       const RVec<ULong64_t>& xts, const RVec<ULong64_t>& yts,
+                       const RVec<double>& sch, const RVec<ULong64_t>& sts,
+                       const RVec<double>& mch, const RVec<ULong64_t>& mts,
+                       const RVec<double>& vch, const RVec<ULong64_t>& vts) {
+        ++n_events[s];
+        if (xm != 1 || ym != 1 || xe.empty() || ye.empty() || xts.empty() || yts.empty()) return;
+        const double ediff = xe[0] - ye[0];
+        ediff_->Fill(s, 0, ediff);
+        if (!(fabs(ediff) < EDIFF_CUT)) return;
+
+        const ULong64_t tx = xts[0];
+        const double e = xe[0];
+        Fill(s, kPairDSSD, 0, TsDiff(tx, yts[0]), e);
+
+        if (sm == 1 && !sch.empty() && !sts.empty()) {
+            const int ch = static_cast<int>(sch[0]);
+            if (ch >= 0 && ch < NUM_SSD_CH) Fill(s, kPairSSD, ssd_group_[ch], TsDiff(tx, sts[0]), e);
+        }
+        if (mm == 2 && mch.size() >= 2 && mts.size() >= 2 && mch[0] == 0 && mch[1] == 1) {
+            Fill(s, kPairMWPC, 0, TsDiff(tx, mts[0]), e);
+            Fill(s, kPairMWPC, 1, TsDiff(tx, mts[1]), e);
+            Fill(s, kPairMWPC01, 0, TsDiff(mts[0], mts[1]), e);
+        }
+        if (vm == 1 && !vch.empty() && !vts.empty()) {
+            const int ch = static_cast<int>(vch[0]);
+            if (ch >= 0 && ch < NUM_VETO_CH) Fill(s, kPairVeto, ch, TsDiff(tx, vts[0]), e);
+        }
+    }, {"DSSDX_mul", "DSSDY_mul", "SSD_mul", "MWPC_mul", "Veto_mul",
+        "DSSDX_E", "DSSDY_E", "DSSDX_Ts", "DSSDY_Ts",
+        "SSD_Ch", "SSD_Ts", "MWPC_Ch", "MWPC_Ts", "Veto_Ch", "Veto_Ts"});
+
+    ediff_->Merge();
+    for (auto& b : dt_) b->Merge();
+    for (auto& b : edt_) b->Merge();
+
+    unsigned long long n = 0;
+    for (unsigned long long c : n_events) n += c;
+    return n;
+}
+
+bool CoinEngine::Write(const string& file) const {
+    TFile f(file.c_str(), "RECREATE");
+    if (f.IsZombie()) return false;
+
+    ediff_->ToTH1D(0, "DSSD_Ediff", "DSSD X-Y Energy Difference;E_x - E_y (keV);Counts")->Write();
+    for (int p = 0; p < kNumPairs; ++p) {
+        const CoinPair cp = static_cast<CoinPair>(p);
+        for (int g = 0; g < NumGroups(cp); ++g) {
+            const string title = Title(cp, g);
+            dt_[p]->ToTH1D(g, DtName(cp, g).c_str(), (title + ";Counts").c_str())->Write();
+            edt_[p]->ToTH2D(g, EDtName(cp, g).c_str(), (title + ";DSSDX_E (keV)").c_str())->Write();
+        }
+    }
+    f.Close();
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef COIN_ENGINE_H
+#define COIN_ENGINE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Config.h"
+#include "HistBank.h"
+#include "ROOT/RDataFrame.hxx"
+
+// 探测器对：每一对有若干通道组，每组一张 ΔT 图 + 一张 DSSDX_E vs ΔT 图
+// （顺序与 ../common/CoinWindowTable.h 的 Pair 相同）
+enum CoinPair { kPairDSSD = 0, kPairSSD, kPairMWPC, kPairMWPC01, kPairVeto, kNumPairs };
+
+// 一次遍历填完所有符合直方图：
+//   ForeachSlot 的一个 typed lambda 每个事件把 DSSD X/Y、SSD、MWPC、Veto 的时间戳读一次，
+//   算出所有探测器对的 ΔT，按“通道 -> 组”查表填进 HistBank（每对一个 1D 库、一个 2D 库）。
+// 没有 JIT 字符串表达式，也没有按组的 Filter 链；加组只改表，不增加遍历。
+class CoinEngine {
+public:
+    explicit CoinEngine(unsigned n_slots);
+
+    // 遍历一次 df，填全部直方图；返回处理的事件数
+    unsigned long long Run(ROOT::RDF::RNode df);
+    bool Write(const std::string& file) const;
+
+    // 组数与直方图名（CoinWindow_Opt 按同样的名字读）
+    static int NumGroups(CoinPair p);
+    static std::string DtName(CoinPair p, int g);
+    static std::string EDtName(CoinPair p, int g);
+    static std::string Title(CoinPair p, int g);
+    // 组 g 包含的通道 [ch_lo, ch_hi]（DSSD X-Y、MWPC0-MWPC1 只有一组，记 0）
+    static void GroupChannels(CoinPair p, int g, int& ch_lo, int& ch_hi);
+
+private:
+    // 事件的一个探测器对：组 g，ΔT
+    void Fill(unsigned slot, CoinPair p, int g, double dt, double e);
+
+    std::unique_ptr<HistBank> ediff_;
+    std::vector<std::unique_ptr<HistBank>> dt_, edt_; // [pair]
+    std::vector<int> ssd_group_;                      // SSD 通道 -> 组
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "CoinWindowOpt.h"
+#include "Config.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+GausFitTask MakeFitTask(const DtSpectrum& s) {
+    GausFitTask t;
+    const int n = static_cast<int>(s.y.size());
+    t.y = s.y.data();
+    t.n = n;
+    t.xlo = t.lo = s.xlo;
+    t.xhi = t.hi = s.xhi;
+    if (n == 0) return t;
+    const double dx = (s.xhi - s.xlo) / n;
+
+    // 平坦本底取中位数（prompt 峰只占少数箱），峰取最高箱，σ 由半高宽估计
+    vector<double> sorted(s.y);
+    nth_element(sorted.begin(), sorted.begin() + n / 2, sorted.end());
+    const double bkg = sorted[n / 2];
+    const int imax = static_cast<int>(max_element(s.y.begin(), s.y.end()) - s.y.begin());
+    const double amp = max(s.y[imax] - bkg, 1.0);
+    int il = imax, ir = imax;
+    while (il > 0 && s.y[il - 1] > bkg + 0.5 * amp) --il;
+    while (ir < n - 1 && s.y[ir + 1] > bkg + 0.5 * amp) ++ir;
+
+    t.A0 = amp;
+    t.mu0 = s.xlo + (imax + 0.5) * dx;
+    t.sigma0 = max(dx, (ir - il + 1) * dx / 2.355);
+    t.b00 = bkg;
+    t.sigmaMin = 0.3 * dx;
+    t.sigmaMax = 0.5 * (s.xhi - s.xlo);
+    t.muMin = s.xlo;
+    t.muMax = s.xhi;
+    t.background = true;
+    t.flatBackground = true;
+    t.cost = GausFitCost::kPoissonML;
+    return t;
+}
+
+void ChooseWindow(const DtSpectrum& s, const GausFitResult& fit, CoinWindow& w) {
+    const int n = static_cast<int>(s.y.size());
+    double total = 0;
+    for (double v : s.y) total += v;
+    w.status = "ok";
+    if (n == 0 || total < OPT_MIN_COUNTS) { w.status = "low"; return; }
+    if (!fit.ok()) { w.status = "fit"; return; }
+
+    const double dx = (s.xhi - s.xlo) / n;
+    const double sig = fit.sigma;
+    const double s_tot = fit.A * sig * sqrt(2.0 * M_PI) / dx;  // prompt 峰面积（计数）
+    const double rho = max(fit.b0, 0.0) / dx;                    // 随机本底密度（计数 / ns）
+    w.mu = fit.mu;
+    w.sigma = sig;
+    if (s_tot < OPT_MIN_PEAK) { w.status = "nopeak"; return; }
+
+    // FoM 必须依赖随机本底的绝对量：eff / √(ρ·2w) 与 ρ 无关，只会停在 OPT_MIN_EFF 的边上
+    auto fom_of = [&](double eff, double b) {
+        return (OPT_FOM == 0) ? eff / (0.5 * OPT_PUNZI_A + sqrt(b)) : s_tot * eff / sqrt(s_tot * eff + b);
+    };
+    // 半宽 w 从 0.5σ 扫到 OPT_MAX_NSIGMA·σ（步长 σ/20）；OPT_MIN_EFF 只是约束
+    double best_fom = -1, best_w = OPT_MAX_NSIGMA * sig;
+    for (double hw = 0.5 * sig; hw <= OPT_MAX_NSIGMA * sig + 1e-9; hw += 0.05 * sig) {
+        const double eff = erf(hw / (sig * M_SQRT2));
+        if (eff < OPT_MIN_EFF) continue;
+        const double fom = fom_of(eff, rho * 2.0 * hw);
+        if (fom > best_fom) { best_fom = fom; best_w = hw; }
+    }
+    w.lo = max(s.xlo, fit.mu - best_w);
+    w.hi = min(s.xhi, fit.mu + best_w);
+    w.eff = 0.5 * (erf((w.hi - fit.mu) / (sig * M_SQRT2)) - erf((w.lo - fit.mu) / (sig * M_SQRT2)));
+    w.random = rho * (w.hi - w.lo);
+    w.fom = fom_of(w.eff, w.random);
+}
@@ -0,0 +1,21 @@
+#ifndef COIN_WINDOW_OPT_H
+#define COIN_WINDOW_OPT_H
+
+#include "CoinWindowTable.h"
+#include "GausFit.h"
+#include <vector>
+
+// 一张 ΔT 图（固定分箱，bins 1..n 的内容）
+struct DtSpectrum {
+    std::vector<double> y;
+    double xlo = 0, xhi = 0;
+};
+
+// ΔT 图的符合窗优化（不依赖 ROOT）：
+//   1. MakeFitTask：prompt 高斯峰 + 平坦本底的起始值（最高箱、中位数本底、半高宽）
+//   2. FitGausBatch 并行拟合全部图（../common/GausFit.h，Baker-Cousins 似然）
+//   3. ChooseWindow：在 μ ± w 上扫 w，按 OPT_FOM 取最优窗，结果与状态写进 CoinWindow
+GausFitTask MakeFitTask(const DtSpectrum& s);
+void ChooseWindow(const DtSpectrum& s, const GausFitResult& fit, CoinWindow& w);
+
+#endif
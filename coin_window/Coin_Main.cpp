@@ -0,0 +1,38 @@
+#include "CoinEngine.h"
+#include "Config.h"
+#include "ROOT/RDataFrame.hxx"
+#include "TChain.h"
+#include <iostream>
+
+using namespace std;
+
+// 一次遍历 tr_map，填全部符合时间窗直方图（取代 analyze_all.C / analyze_rdf*.cpp）
+// 用法：./Coin_Build [文件或通配符 ...]   默认 INPUT_GLOB
+int main(int argc, char** argv) {
+    if (NUM_THREADS > 0) ROOT::EnableImplicitMT(NUM_THREADS);
+
+    TChain chain(TREE_NAME);
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) chain.Add(argv[i]);
+    } else {
+        chain.Add(INPUT_GLOB);
+    }
+    if (chain.GetNtrees() == 0) {
+        cerr << "[ERROR] No input files found." << endl;
+        return 1;
+    }
+
+    ROOT::RDataFrame df(chain);
+    cout << "=== Coincidence windows: " << chain.GetNtrees() << " file(s), " << df.GetNSlots() << " slot(s) ===" << endl;
+
+    CoinEngine engine(df.GetNSlots());
+    const unsigned long long n = engine.Run(df);
+    cout << "--> " << n << " events" << endl;
+
+    if (!engine.Write(OUTPUT_FILE)) {
+        cerr << "[ERROR] Cannot write " << OUTPUT_FILE << endl;
+        return 1;
+    }
+    cout << "=== Done: " << OUTPUT_FILE << " ===" << endl;
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+// ===================================================================
+//        符合时间窗 (coin_window) 一次遍历直方图 配置文件
+// ===================================================================
+
+// --- 1. 运行配置 ---
+inline constexpr int NUM_THREADS = 12;
+
+// --- 2. 文件路径配置 ---
+// [输入] tr_map（TChain 通配符；命令行参数可覆盖）
+inline constexpr char INPUT_GLOB[] = "/home/evalie2/Project/document/273Ds/inter_map/SS032001*_map.root";
+inline constexpr char TREE_NAME[] = "tr_map";
+// [输出] 全部 ΔT / E-vs-ΔT 直方图（名字与旧的 analyze_rdf*.cpp 相同）
+inline constexpr char OUTPUT_FILE[] = "coin_window_all.root";
+
+// --- 3. 事件选择 ---
+// 所有探测器对都要求 DSSDX_mul == 1 && DSSDY_mul == 1 && |DSSDX_E - DSSDY_E| < EDIFF_CUT
+inline constexpr double EDIFF_CUT = 500.0;
+// MWPC：MWPC_mul == 2 && MWPC_Ch[0] == 0 && MWPC_Ch[1] == 1；SSD / Veto：mul == 1
+
+// --- 4. 通道分组 ---
+// 每组一张 ΔT 图和一张 E-vs-ΔT 图；加组只改这里，不增加遍历次数
+inline constexpr int NUM_SSD_CH = 48;
+inline constexpr int SSD_GROUP_SIZE = 1;  // 1 = 每个 SSD 通道一组（符合窗逐通道优化）；8 = 旧的 SSD_tdiff_0_7 分组
+inline constexpr int NUM_MWPC_CH = 2;
+inline constexpr int NUM_VETO_CH = 3;
+
+// --- 5. 直方图轴 ---
+struct CoinAxis {
+    int nb;
+    double lo, hi;
+};
+inline constexpr CoinAxis EDIFF_AXIS   = {60, -300.0, 300.0};    // E_x - E_y (keV)
+inline constexpr CoinAxis DT_DSSD_AXIS = {60, -300.0, 300.0};    // T_x - T_y (ns)
+inline constexpr CoinAxis DT_SSD_AXIS  = {60, -300.0, 300.0};    // T_DSSD - T_SSD (ns)
+inline constexpr CoinAxis DT_MWPC_AXIS = {100, -500.0, 500.0};   // T_DSSD - T_MWPC, T_MWPC0 - T_MWPC1 (ns)
+inline constexpr CoinAxis DT_VETO_AXIS = {100, -500.0, 500.0};   // T_DSSD - T_Veto (ns)
+inline constexpr CoinAxis E_SSD_AXIS   = {200, 0.0, 15000.0};    // DSSDX_E (keV)，SSD 符合
+inline constexpr CoinAxis E_BEAM_AXIS  = {4000, 0.0, 40000.0};   // DSSDX_E (keV)，MWPC / Veto 符合
+
+// --- 6. 符合窗优化 (CoinWindow_Opt：读 OUTPUT_FILE，写 WINDOW_TABLE_FILE) ---
+// 每张 ΔT 图拟合 prompt 高斯峰 + 平坦随机本底，在 μ ± w 上扫 w，取 FoM 最大且效率 >= OPT_MIN_EFF 的窗
+inline constexpr char WINDOW_TABLE_FILE[] = "coin_windows.dat";
+inline constexpr char WINDOW_DIAG_FILE[] = "coin_windows_fit.root";  // 每张图的拟合模型
+inline constexpr int OPT_THREADS = 0;              // 0 = 全部核
+inline constexpr double OPT_MIN_COUNTS = 200.0;    // ΔT 图总计数少于此不拟合
+inline constexpr double OPT_MIN_PEAK = 50.0;       // 拟合的 prompt 峰面积（计数）少于此视为没有峰
+inline constexpr double OPT_MIN_EFF = 0.95;        // 窗口内 prompt 峰的最低比例
+inline constexpr double OPT_MAX_NSIGMA = 5.0;      // 扫描的最大半宽 (σ)
+// FoM：0 = Punzi，效率 / (a/2 + √B)；1 = S / √(S + B)。B = 窗口内随机计数，S = 窗口内 prompt 计数
+inline constexpr int OPT_FOM = 0;
+inline constexpr double OPT_PUNZI_A = 3.0;         // Punzi FoM 的显著性 a (σ)
+
+#endif
@@ -0,0 +1,98 @@
+#include "CoinEngine.h"
+#include "CoinWindowOpt.h"
+#include "CoinWindowTable.h"
+#include "Config.h"
+#include "TFile.h"
+#include "TH1D.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Coin_Build 的 ΔT 图 -> 符合窗表（../common/CoinWindowTable.h 格式，DSSD_Pre / DSSD_Fused 读）
+// 用法：./CoinWindow_Opt [输入 ROOT 文件] [输出窗表]   默认 OUTPUT_FILE、WINDOW_TABLE_FILE
+// 按 run 段重做：./Coin_Build 段内文件 && ./CoinWindow_Opt coin_window_all.root coin_windows_runXX.dat
+int main(int argc, char** argv) {
+    const string in_file = (argc > 1) ? argv[1] : OUTPUT_FILE;
+    const string out_file = (argc > 2) ? argv[2] : WINDOW_TABLE_FILE;
+    const auto t0 = chrono::steady_clock::now();
+
+    TFile fin(in_file.c_str(), "READ");
+    if (fin.IsZombie()) {
+        cerr << "[ERROR] Cannot open " << in_file << " (run Coin_Build first)" << endl;
+        return 1;
+    }
+
+    // 全部 (探测器对, 组) 的 ΔT 图
+    struct Item {
+        CoinPair pair;
+        int g;
+        string name;
+    };
+    vector<Item> items;
+    vector<DtSpectrum> spectra;
+    for (int p = 0; p < kNumPairs; ++p) {
+        const CoinPair cp = static_cast<CoinPair>(p);
+        for (int g = 0; g < CoinEngine::NumGroups(cp); ++g) {
+            const string name = CoinEngine::DtName(cp, g);
+            TH1D* h = dynamic_cast<TH1D*>(fin.Get(name.c_str()));
+            if (!h) continue;
+            DtSpectrum s;
+            s.xlo = h->GetXaxis()->GetXmin();
+            s.xhi = h->GetXaxis()->GetXmax();
+            s.y.resize(h->GetNbinsX());
+            for (int b = 1; b <= h->GetNbinsX(); ++b) s.y[b - 1] = h->GetBinContent(b);
+            items.push_back({cp, g, name});
+            spectra.push_back(std::move(s));
+        }
+    }
+    if (items.empty()) {
+        cerr << "[ERROR] No dT histograms in " << in_file << endl;
+        return 1;
+    }
+
+    vector<GausFitTask> tasks;
+    tasks.reserve(spectra.size());
+    for (const DtSpectrum& s : spectra) tasks.push_back(MakeFitTask(s));
+    const vector<GausFitResult> fits = FitGausBatch(tasks, OPT_THREADS);
+
+    CoinWindowTable table;
+    TFile fdiag(WINDOW_DIAG_FILE, "RECREATE");
+    int n_ok = 0;
+    printf("%-22s %10s %10s %8s %7s %10s %s\n", "histogram", "lo (ns)", "hi (ns)", "sigma", "eff", "random", "status");
+    for (size_t i = 0; i < items.size(); ++i) {
+        CoinWindow w;
+        w.pair = CoinWindowTable::PairName(items[i].pair);
+        CoinEngine::GroupChannels(items[i].pair, items[i].g, w.ch_lo, w.ch_hi);
+        ChooseWindow(spectra[i], fits[i], w);
+        table.Add(w);
+        n_ok += w.ok();
+        printf("%-22s %10.1f %10.1f %8.1f %7.3f %10.4g %s\n", items[i].name.c_str(), w.lo, w.hi, w.sigma, w.eff,
+               w.random, w.status.c_str());
+
+        // 诊断：拟合模型（与 ΔT 图同分箱）
+        const DtSpectrum& s = spectra[i];
+        const int n = static_cast<int>(s.y.size());
+        TH1D hm((items[i].name + "_fit").c_str(), (items[i].name + " prompt + flat fit;#DeltaT (ns);Counts").c_str(),
+                n, s.xlo, s.xhi);
+        const GausFitResult& f = fits[i];
+        for (int b = 0; b < n && f.ok(); ++b) {
+            const double x = s.xlo + (b + 0.5) * (s.xhi - s.xlo) / n;
+            hm.SetBinContent(b + 1, f.A * exp(-0.5 * pow((x - f.mu) / f.sigma, 2)) + f.b0);
+        }
+        hm.Write();
+    }
+    fdiag.Close();
+
+    if (!table.Save(out_file, "coincidence windows from " + in_file + " (CoinWindow_Opt)")) {
+        cerr << "[ERROR] Cannot write " << out_file << endl;
+        return 1;
+    }
+    const double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "=== " << n_ok << "/" << items.size() << " windows ok -> " << out_file << " (" << sec << " s) ===" << endl;
+    return 0;
+}
@@ -0,0 +1,404 @@
+#pragma once
+// CalibApply: rewrite the energy branches of a tree with a linear calibration table, E' = k*E + b.
+// Used by:
+//   SSD_calibration/apply_calibrationv1.cpp   SSD_E of tr_chain (SSD params), or any table via options
+//   DSSD_recal_all/Apply_Main.cpp             DSSDX_E / DSSDY_E / DSSDYH_E of tr_map (ener_cal_Recal.dat)
+// Build: add -I../common (see the Makefiles).
+//
+// How the output is written:
+//   - every branch that is not rewritten is fast-cloned (CloneTree "fast": compressed baskets are
+//     copied as they are, no decompression / recompression)
+//   - the rewritten branches are re-created with the input leaf spec (e.g. "SSD_E[chain_mul]/D",
+//     the count leaf is one of the cloned branches) and filled in entry order; the cloned count
+//     leaf is bound to a local set to each entry's length (its own baskets are already copied, it
+//     is never filled again)
+//   - the input is read cluster by cluster on nThreads reader threads, each with its own TFile and
+//     only the (energy, channel) branches enabled; while the writer fills one batch of clusters,
+//     the readers already decompress and calibrate the next one
+// Rules per hit (same as the original apply_calibration): raw E < threshold -> 0; channel without
+// parameters -> raw E unchanged; a negative calibrated E -> 0.
+// With verify (default) the output is read back and every length and value of the rewritten
+// branches is compared with the input recalibrated; a mismatch returns kVerifyError.
+
+#include "TBranch.h"
+#include "TFile.h"
+#include "TLeaf.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Parameter table indexed by channel id. File formats differ only in the column order after the id:
+//   kIdKB: "id k b ..."   SSD_calibration params (id = SSD position)
+//   kIdBK: "id b k ..."   DSSD ener_cal_Recal.dat / ener_cal.dat (id: X 0-127, Y 128-175, YH 176-223)
+// Lines that do not start with an integer (headers, comments) are skipped.
+struct CalibTable {
+  enum class Columns { kIdKB, kIdBK };
+
+  std::vector<double> k, b;
+  std::vector<char> has;
+
+  int Size() const { return static_cast<int>(has.size()); }
+  int Count() const { return static_cast<int>(std::count(has.begin(), has.end(), 1)); }
+  bool Has(int id) const { return id >= 0 && id < Size() && has[id]; }
+
+  void Set(int id, double kk, double bb) {
+    if (id >= Size()) { k.resize(id + 1, 1.0); b.resize(id + 1, 0.0); has.resize(id + 1, 0); }
+    k[id] = kk; b[id] = bb; has[id] = 1;
+  }
+
+  bool Load(const std::string& path, Columns cols) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream ss(line);
+      int id;
+      double c1, c2;
+      if (!(ss >> id >> c1 >> c2) || id < 0) continue;
+      if (cols == Columns::kIdKB) Set(id, c1, c2);
+      else                        Set(id, c2, c1);
+    }
+    return true;
+  }
+};
+
+// One branch to rewrite: energy[i] of hit i is calibrated with the table entry Nint(channel[i]) + offset.
+struct CalibTarget {
+  std::string energy;   // e.g. "SSD_E", "DSSDY_E"
+  std::string channel;  // e.g. "SSD_Pos", "DSSDY_Ch"
+  int offset = 0;       // table id offset (DSSD Y: 128, YH: 176)
+};
+
+struct CalibApplyOptions {
+  int nThreads = 1;
+  int compression = 1;           // output file compression level (rewritten branches)
+  double threshold = 1.0;        // raw E below this -> 0
+  int clustersPerBatch = 0;      // clusters per reader batch; 0 = 4 * nThreads
+  bool verify = true;            // read the output back and compare with the input
+};
+
+struct CalibApplyStats {
+  long long entries = 0;
+  long long hits = 0;
+  long long calibrated = 0;
+  long long uncalibrated = 0;
+};
+
+enum class CalibApplyStatus { kOk = 0, kFileError, kTreeError, kBranchError, kVerifyError };
+
+namespace calibapply_detail {
+
+// A leaf that can be rewritten: Double_t, scalar / fixed array / variable array.
+inline bool CheckLeaf(TTree* t, const std::string& name, std::string& spec, int& capacity) {
+  TLeaf* leaf = t->GetLeaf(name.c_str());
+  if (!leaf || std::string(leaf->GetTypeName()) != "Double_t") return false;
+  spec = std::string(leaf->GetTitle()) + "/D";
+  capacity = leaf->GetLenStatic();
+  if (TLeaf* lc = leaf->GetLeafCount()) capacity *= std::max(1, lc->GetMaximum());
+  capacity = std::max(capacity, 1);
+  return true;
+}
+
+// count leaf of a variable-length array ("" for scalars / fixed arrays)
+inline std::string CountLeafName(TTree* t, const std::string& name) {
+  TLeaf* leaf = t->GetLeaf(name.c_str());
+  TLeaf* lc = leaf ? leaf->GetLeafCount() : nullptr;
+  return lc ? std::string(lc->GetName()) : std::string();
+}
+
+// Local storage for a cloned count leaf: 8 bytes hold any integer leaf type, Set writes the value
+// with the leaf's own type.
+struct CountSlot {
+  std::string name, type;
+  alignas(8) unsigned char raw[8] = {};
+
+  template <class T> void Put(long long v) { const T x = static_cast<T>(v); std::memcpy(raw, &x, sizeof x); }
+  bool Known() const {
+    for (const char* k : {"Int_t", "UInt_t", "Short_t", "UShort_t", "Char_t", "UChar_t", "Long64_t", "ULong64_t",
+                          "Long_t", "ULong_t", "Bool_t"}) {
+      if (type == k) return true;
+    }
+    return false;
+  }
+  void Set(int v) {
+    if      (type == "Int_t")     Put<Int_t>(v);
+    else if (type == "UInt_t")    Put<UInt_t>(v);
+    else if (type == "Short_t")   Put<Short_t>(v);
+    else if (type == "UShort_t")  Put<UShort_t>(v);
+    else if (type == "Char_t")    Put<Char_t>(v);
+    else if (type == "UChar_t" || type == "Bool_t") Put<UChar_t>(v);
+    else if (type == "Long_t")    Put<Long_t>(v);
+    else if (type == "ULong_t")   Put<ULong_t>(v);
+    else if (type == "Long64_t")  Put<Long64_t>(v);
+    else                          Put<ULong64_t>(v);
+  }
+};
+
+struct Range { long long lo, hi; };
+
+// calibrated values of one cluster: len[(entry - lo) * nTargets + t], values concatenated
+struct ClusterOut {
+  std::vector<int> len;
+  std::vector<double> val;
+  CalibApplyStats stats;
+};
+
+// One reader thread: its own file handle, only the needed branches enabled.
+class Reader {
+public:
+  Reader(const std::string& file, const std::string& tree, const std::vector<CalibTarget>& targets,
+         const std::vector<int>& capacity)
+    : f_(TFile::Open(file.c_str(), "READ")) {
+    if (!f_ || f_->IsZombie()) return;
+    t_ = dynamic_cast<TTree*>(f_->Get(tree.c_str()));
+    if (!t_) return;
+    t_->SetBranchStatus("*", false);
+    const size_t n = targets.size();
+    e_.resize(n); ch_.resize(n); leafE_.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      e_[i].assign(capacity[i], 0.0);
+      ch_[i].assign(capacity[i], 0.0);
+      t_->SetBranchStatus(targets[i].energy.c_str(), true);
+      t_->SetBranchStatus(targets[i].channel.c_str(), true);
+      // count leaves of variable-length arrays must be read too
+      for (const std::string& b : {targets[i].energy, targets[i].channel}) {
+        if (TLeaf* lc = t_->GetLeaf(b.c_str())->GetLeafCount()) t_->SetBranchStatus(lc->GetBranch()->GetName(), true);
+      }
+      t_->SetBranchAddress(targets[i].energy.c_str(), e_[i].data());
+      t_->SetBranchAddress(targets[i].channel.c_str(), ch_[i].data());
+      leafE_[i] = t_->GetLeaf(targets[i].energy.c_str());
+    }
+  }
+
+  bool ok() const { return t_ != nullptr; }
+
+  void Run(Range r, const CalibTable& table, const std::vector<CalibTarget>& targets, double threshold,
+           ClusterOut& out) {
+    const size_t nT = targets.size();
+    out.len.assign(static_cast<size_t>(r.hi - r.lo) * nT, 0);
+    out.val.clear();
+    out.stats = CalibApplyStats{};
+    for (long long i = r.lo; i < r.hi; ++i) {
+      t_->GetEntry(i);
+      for (size_t t = 0; t < nT; ++t) {
+        const int len = std::min<int>(leafE_[t]->GetLen(), static_cast<int>(e_[t].size()));
+        out.len[static_cast<size_t>(i - r.lo) * nT + t] = len;
+        for (int j = 0; j < len; ++j) {
+          const double raw = e_[t][j];
+          const int id = static_cast<int>(std::lround(ch_[t][j])) + targets[t].offset;
+          double cal;
+          ++out.stats.hits;
+          if (raw < threshold) {
+            cal = 0.0;
+            ++out.stats.uncalibrated;
+          } else if (table.Has(id)) {
+            cal = std::max(0.0, raw * table.k[id] + table.b[id]);
+            ++out.stats.calibrated;
+          } else {
+            cal = raw;
+            ++out.stats.uncalibrated;
+          }
+          out.val.push_back(cal);
+        }
+      }
+    }
+    out.stats.entries = r.hi - r.lo;
+  }
+
+private:
+  std::unique_ptr<TFile> f_;
+  TTree* t_ = nullptr;
+  std::vector<std::vector<double>> e_, ch_;
+  std::vector<TLeaf*> leafE_;
+};
+
+// Round trip: the rewritten branches of the output (lengths from their count leaves) against the
+// input recalibrated cluster by cluster with the same Reader. Returns the number of mismatching
+// entries (-1 if the output cannot be read or the entry counts differ).
+inline long long VerifyOutput(const std::string& inFile, const std::string& outFile, const std::string& treeName,
+                              const CalibTable& table, const std::vector<CalibTarget>& targets,
+                              const std::vector<int>& capacity, const std::vector<Range>& clusters,
+                              double threshold) {
+  Reader ref(inFile, treeName, targets, capacity);
+  std::unique_ptr<TFile> f(TFile::Open(outFile.c_str(), "READ"));
+  if (!ref.ok() || !f || f->IsZombie()) return -1;
+  TTree* t = dynamic_cast<TTree*>(f->Get(treeName.c_str()));
+  if (!t) return -1;
+
+  const size_t nT = targets.size();
+  t->SetBranchStatus("*", false);
+  std::vector<std::vector<double>> e(nT);
+  std::vector<TLeaf*> leaf(nT);
+  for (size_t i = 0; i < nT; ++i) {
+    e[i].assign(capacity[i], 0.0);
+    t->SetBranchStatus(targets[i].energy.c_str(), true);
+    const std::string cnt = CountLeafName(t, targets[i].energy);
+    if (!cnt.empty()) t->SetBranchStatus(t->GetLeaf(cnt.c_str())->GetBranch()->GetName(), true);
+    t->SetBranchAddress(targets[i].energy.c_str(), e[i].data());
+    leaf[i] = t->GetLeaf(targets[i].energy.c_str());
+  }
+  long long nIn = 0;
+  for (const Range& r : clusters) nIn += r.hi - r.lo;
+  if (t->GetEntries() != nIn) return -1;
+
+  long long bad = 0;
+  ClusterOut co;
+  for (const Range& r : clusters) {
+    ref.Run(r, table, targets, threshold, co);
+    const double* v = co.val.data();
+    for (long long i = r.lo; i < r.hi; ++i) {
+      t->GetEntry(i);
+      bool same = true;
+      for (size_t k = 0; k < nT; ++k) {
+        const int len = co.len[static_cast<size_t>(i - r.lo) * nT + k];
+        if (leaf[k]->GetLen() != len || !std::equal(v, v + len, e[k].begin())) same = false;
+        v += len;
+      }
+      if (!same) ++bad;
+    }
+  }
+  return bad;
+}
+
+} // namespace calibapply_detail
+
+inline CalibApplyStatus ApplyCalibrationTable(const std::string& inFile, const std::string& treeName,
+                                              const std::string& outFile, const CalibTable& table,
+                                              const std::vector<CalibTarget>& targets,
+                                              const CalibApplyOptions& opt, CalibApplyStats* stats = nullptr) {
+  using namespace calibapply_detail;
+  const int nThreads = std::max(1, opt.nThreads);
+  ROOT::EnableThreadSafety(); // readers run next to the writer even with nThreads = 1
+
+  std::unique_ptr<TFile> fin(TFile::Open(inFile.c_str(), "READ"));
+  if (!fin || fin->IsZombie()) return CalibApplyStatus::kFileError;
+  TTree* tin = dynamic_cast<TTree*>(fin->Get(treeName.c_str()));
+  if (!tin) return CalibApplyStatus::kTreeError;
+
+  const size_t nT = targets.size();
+  std::vector<std::string> spec(nT);
+  std::vector<int> capacity(nT);
+  std::vector<int> basket(nT);
+  for (size_t t = 0; t < nT; ++t) {
+    int capCh = 0;
+    std::string specCh;
+    if (!CheckLeaf(tin, targets[t].energy, spec[t], capacity[t])) return CalibApplyStatus::kBranchError;
+    if (!CheckLeaf(tin, targets[t].channel, specCh, capCh)) return CalibApplyStatus::kBranchError;
+    capacity[t] = std::max(capacity[t], capCh);
+    basket[t] = tin->GetBranch(targets[t].energy.c_str())->GetBasketSize();
+  }
+
+  // cluster boundaries of the input
+  std::vector<Range> clusters;
+  const long long nEntries = tin->GetEntries();
+  {
+    auto it = tin->GetClusterIterator(0);
+    for (long long lo = it(); lo < nEntries; lo = it()) clusters.push_back({lo, std::min(it.GetNextEntry(), nEntries)});
+  }
+
+  // output: everything except the rewritten branches, fast-cloned
+  auto fout = std::make_unique<TFile>(outFile.c_str(), "RECREATE", "", opt.compression);
+  if (!fout || fout->IsZombie()) return CalibApplyStatus::kFileError;
+  for (const CalibTarget& t : targets) tin->SetBranchStatus(t.energy.c_str(), false);
+  TTree* tout = tin->CloneTree(-1, "fast");
+  if (!tout) return CalibApplyStatus::kTreeError;
+  tout->SetDirectory(fout.get());
+
+  std::vector<std::vector<double>> buf(nT);
+  std::vector<TBranch*> br(nT);
+  for (size_t t = 0; t < nT; ++t) {
+    buf[t].assign(capacity[t], 0.0);
+    br[t] = tout->Branch(targets[t].energy.c_str(), buf[t].data(), spec[t].c_str(), basket[t]);
+  }
+
+  // The new branches take their length from the cloned count leaves, whose addresses still point
+  // into the input tree: bind each to a local (targets sharing a count leaf share the slot).
+  std::vector<std::unique_ptr<CountSlot>> counts;
+  std::vector<CountSlot*> countOf(nT, nullptr);
+  for (size_t t = 0; t < nT; ++t) {
+    const std::string name = CountLeafName(tout, targets[t].energy);
+    if (name.empty()) continue;
+    for (auto& c : counts) {
+      if (c->name == name) countOf[t] = c.get();
+    }
+    if (countOf[t]) continue;
+    auto c = std::make_unique<CountSlot>();
+    c->name = name;
+    c->type = tout->GetLeaf(name.c_str())->GetTypeName();
+    if (!c->Known()) return CalibApplyStatus::kBranchError;
+    tout->SetBranchAddress(tout->GetLeaf(name.c_str())->GetBranch()->GetName(), static_cast<void*>(c->raw));
+    countOf[t] = c.get();
+    counts.push_back(std::move(c));
+  }
+  fin->Close();
+
+  // readers: one file handle per thread, kept for the whole run
+  std::vector<std::unique_ptr<Reader>> readers;
+  for (int i = 0; i < nThreads; ++i) {
+    readers.push_back(std::make_unique<Reader>(inFile, treeName, targets, capacity));
+    if (!readers.back()->ok()) return CalibApplyStatus::kFileError;
+  }
+
+  const size_t batch = opt.clustersPerBatch > 0 ? opt.clustersPerBatch : 4 * nThreads;
+  auto readBatch = [&](size_t first) {
+    const size_t n = std::min(batch, clusters.size() - first);
+    std::vector<ClusterOut> outs(n);
+    std::atomic<size_t> next{0};
+    auto work = [&](int w) {
+      for (size_t c = next++; c < n; c = next++) readers[w]->Run(clusters[first + c], table, targets, opt.threshold, outs[c]);
+    };
+    std::vector<std::thread> pool;
+    for (int w = 1; w < nThreads; ++w) pool.emplace_back(work, w);
+    work(0);
+    for (auto& th : pool) th.join();
+    return outs;
+  };
+
+  CalibApplyStats total;
+  std::future<std::vector<ClusterOut>> pending;
+  if (!clusters.empty()) pending = std::async(std::launch::async, readBatch, size_t(0));
+  for (size_t first = 0; first < clusters.size(); first += batch) {
+    std::vector<ClusterOut> outs = pending.get();
+    if (first + batch < clusters.size()) pending = std::async(std::launch::async, readBatch, first + batch);
+
+    // writer: entry order, only the rewritten branches are filled
+    for (ClusterOut& co : outs) {
+      const double* v = co.val.data();
+      const size_t nEnt = co.len.size() / std::max<size_t>(nT, 1);
+      for (size_t e = 0; e < nEnt; ++e) {
+        for (size_t t = 0; t < nT; ++t) {
+          const int len = co.len[e * nT + t];
+          std::copy(v, v + len, buf[t].begin());
+          v += len;
+          if (countOf[t]) countOf[t]->Set(len);
+          br[t]->Fill();
+        }
+      }
+      total.entries      += co.stats.entries;
+      total.hits         += co.stats.hits;
+      total.calibrated   += co.stats.calibrated;
+      total.uncalibrated += co.stats.uncalibrated;
+    }
+  }
+
+  fout->cd();
+  tout->Write("", TObject::kOverwrite);
+  fout->Close();
+  if (stats) *stats = total;
+  if (opt.verify && VerifyOutput(inFile, outFile, treeName, table, targets, capacity, clusters, opt.threshold) != 0) {
+    return CalibApplyStatus::kVerifyError;
+  }
+  return CalibApplyStatus::kOk;
+}
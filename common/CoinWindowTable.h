@@ -0,0 +1,141 @@
+#pragma once
+// CoinWindowTable: coincidence windows per detector pair and channel group, fitted from the dT
+// spectra and read back by the preselection.
+// Used by:
+//   coin_window/Opt_Main.cpp         writes the table (prompt peak + flat background fits)
+//   DSSD_recal_all/CoinSelect.h      MWPC / SSD / Veto hits counted only inside their window
+// Header-only and ROOT-free.
+//
+// Text format, one window per line, '#' starts a comment:
+//   pair ch_lo ch_hi lo_ns hi_ns mu_ns sigma_ns eff random fom status
+// pair is one of DSSD (X-Y), SSD, MWPC, MWPC01, Veto; dT = T_DSSDX - T_det in ns, and a hit is in
+// coincidence if lo_ns <= dT <= hi_ns. Only the first five columns are needed to read a table;
+// the fit columns are for bookkeeping. Rows with status != "ok" are kept but not used.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct CoinWindow {
+  std::string pair;
+  int ch_lo = 0, ch_hi = 0;
+  double lo = 0.0, hi = 0.0;      // window (ns)
+  double mu = 0.0, sigma = 0.0;   // prompt peak
+  double eff = 0.0;               // prompt fraction inside the window
+  double random = 0.0;            // flat-background counts inside the window
+  double fom = 0.0;
+  std::string status = "ok";
+
+  bool ok() const { return status == "ok"; }
+};
+
+class CoinWindowTable {
+public:
+  CoinWindowTable() { Reindex(); }
+
+  enum Pair { kDSSD = 0, kSSD, kMWPC, kMWPC01, kVeto, kNumPairs };
+  static constexpr int kMaxCh = 256;
+
+  static const char* PairName(int p) {
+    static const char* names[kNumPairs] = {"DSSD", "SSD", "MWPC", "MWPC01", "Veto"};
+    return (p >= 0 && p < kNumPairs) ? names[p] : "";
+  }
+  static int PairId(const std::string& name) {
+    for (int p = 0; p < kNumPairs; ++p) {
+      if (name == PairName(p)) return p;
+    }
+    return -1;
+  }
+
+  // false if the file cannot be read or has no usable window
+  bool Load(const std::string& path) {
+    windows_.clear();
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+      const size_t hash = line.find('#');
+      if (hash != std::string::npos) line.erase(hash);
+      std::istringstream ss(line);
+      CoinWindow w;
+      if (!(ss >> w.pair >> w.ch_lo >> w.ch_hi >> w.lo >> w.hi)) continue;
+      ss >> w.mu >> w.sigma >> w.eff >> w.random >> w.fom >> w.status;
+      windows_.push_back(w);
+    }
+    Reindex();
+    for (const CoinWindow& w : windows_) {
+      if (w.ok()) return true;
+    }
+    return false;
+  }
+
+  bool Save(const std::string& path, const std::string& comment = "") const {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    if (!comment.empty()) std::fprintf(f, "# %s\n", comment.c_str());
+    std::fprintf(f, "# pair ch_lo ch_hi lo_ns hi_ns mu_ns sigma_ns eff random fom status\n");
+    for (const CoinWindow& w : windows_) {
+      std::fprintf(f, "%-7s %3d %3d %10.2f %10.2f %10.2f %8.2f %7.4f %12.4g %12.4g %s\n", w.pair.c_str(), w.ch_lo,
+                   w.ch_hi, w.lo, w.hi, w.mu, w.sigma, w.eff, w.random, w.fom, w.status.c_str());
+    }
+    return std::fclose(f) == 0;
+  }
+
+  void Add(const CoinWindow& w) {
+    windows_.push_back(w);
+    Reindex();
+  }
+  const std::vector<CoinWindow>& Windows() const { return windows_; }
+
+  // usable window of (pair, ch); nullptr if none
+  const CoinWindow* Find(int pair, int ch) const {
+    if (pair < 0 || pair >= kNumPairs || ch < 0 || ch >= kMaxCh) return nullptr;
+    const int i = index_[pair][ch];
+    return (i >= 0) ? &windows_[i] : nullptr;
+  }
+
+  bool Has(int pair) const {
+    for (const CoinWindow& w : windows_) {
+      if (w.ok() && PairId(w.pair) == pair) return true;
+    }
+    return false;
+  }
+
+  // Hits of one detector in coincidence with the DSSD time tRef: channel ch[i], time ts[i].
+  // A channel without a usable window counts as in coincidence (same as the bare multiplicity),
+  // so a failed fit never turns a vetoed event into a clean one.
+  template <class VCh, class VTs>
+  int CountInWindow(int pair, const VCh& ch, const VTs& ts, uint64_t tRef) const {
+    int n = 0;
+    const size_t m = std::min<size_t>(ch.size(), ts.size());
+    for (size_t i = 0; i < m; ++i) {
+      const CoinWindow* w = Find(pair, static_cast<int>(ch[i]));
+      if (!w) { ++n; continue; }
+      const double dt = static_cast<double>(static_cast<int64_t>(tRef - static_cast<uint64_t>(ts[i])));
+      if (dt >= w->lo && dt <= w->hi) ++n;
+    }
+    return n;
+  }
+
+private:
+  // (pair, channel) -> first usable window, so the per-event lookup is one array access
+  void Reindex() {
+    for (auto& row : index_) std::fill(std::begin(row), std::end(row), -1);
+    for (size_t i = 0; i < windows_.size(); ++i) {
+      const CoinWindow& w = windows_[i];
+      const int p = PairId(w.pair);
+      if (!w.ok() || p < 0) continue;
+      for (int ch = std::max(0, w.ch_lo); ch <= std::min(kMaxCh - 1, w.ch_hi); ++ch) {
+        if (index_[p][ch] < 0) index_[p][ch] = static_cast<int>(i);
+      }
+    }
+  }
+
+  std::vector<CoinWindow> windows_;
+  int index_[kNumPairs][kMaxCh];
+};
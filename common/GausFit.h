@@ -0,0 +1,358 @@
+#pragma once
+// Native Gaussian (+ linear background) peak fitter on raw, uniformly binned counts.
+// Header-only and ROOT-free, shared by:
+//   A80_fixedN_final_package/PeakFinder.cpp      FitOnePeakGaus
+//   DSSD_outcal_all_byCh/PerChannelCalibrator.cpp FitPeakTwoStage
+//   DSSD_recal_all/Calibrator.cpp                 Calibrator::FindPeakGaussian
+//   coin_window/CoinWindowOpt.cpp                 prompt peak + flat random background of dT spectra
+// Build: add -I../common (see the Makefiles).
+//
+// Model:  f(x) = A * exp(-0.5*((x-mu)/sigma)^2) [+ b0 + b1*(x - xc)],  xc = centre of the fit range
+//         (flatBackground: b1 fixed at 0)
+// Cost:   kChi2     : Neyman chi2, error^2 = counts, empty bins skipped (what TH1::Fit does by default);
+//                     with GausFitTask::e2 the given per-bin errors^2 (a TH1 with Sumw2), zero-error bins skipped
+//         kPoissonML: Baker-Cousins likelihood chi2 (TH1::Fit option "L"), empty bins included
+// Minimiser: Levenberg-Marquardt with box limits (projection), analytic Jacobian.
+// Bins take part if their centre is inside [lo, hi] (same rule as TH1::Fit with option "R").
+//
+// It is thread-safe (no global state), unlike TF1/TMinuit, so fits can run in parallel.
+// FitGausBatch runs many independent fits; the per-bin loop is branch-free over contiguous
+// arrays so the compiler can vectorise it.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <thread>
+#include <vector>
+
+enum class GausFitCost { kChi2, kPoissonML };
+
+struct GausFitTask {
+  // histogram: y[0..n-1] = contents of bins 1..n of a fixed-bin axis [xlo, xhi)
+  // (for a TH1D: y = h->GetArray() + 1, n = h->GetNbinsX())
+  const double* y = nullptr;
+  // optional errors^2 of the same bins for kChi2 (for a TH1D with Sumw2: h->GetSumw2()->GetArray() + 1);
+  // nullptr: error^2 = counts
+  const double* e2 = nullptr;
+  int    n   = 0;
+  double xlo = 0.0;
+  double xhi = 0.0;
+
+  // fit range
+  double lo = 0.0;
+  double hi = 0.0;
+
+  // start values
+  double A0 = 1.0, mu0 = 0.0, sigma0 = 1.0;
+  double b00 = 0.0, b10 = 0.0;
+
+  // limits (sigma is always kept > 0)
+  double sigmaMin = 0.0;
+  double sigmaMax = std::numeric_limits<double>::infinity();
+  double muMin = -std::numeric_limits<double>::infinity();
+  double muMax =  std::numeric_limits<double>::infinity();
+
+  bool background = false; // add b0 + b1*(x - xc)
+  bool flatBackground = false; // with background: b0 only (b1 = 0)
+  GausFitCost cost = GausFitCost::kChi2;
+
+  int maxIter = 200;
+};
+
+struct GausFitResult {
+  enum Status { kConverged = 0, kMaxIter = 1, kSingular = 2, kTooFewBins = 3 };
+  int status = kTooFewBins;
+
+  double A = 0.0, mu = 0.0, sigma = 0.0;
+  double b0 = 0.0, b1 = 0.0;          // background at (x - xc), xc = 0.5*(lo+hi)
+  double eA = 0.0, emu = 0.0, esigma = 0.0; // from the inverse curvature matrix
+
+  double chi2 = 0.0; // cost at the minimum
+  int    ndf  = 0;   // bins used - free parameters
+  int    iter = 0;
+
+  bool ok() const { return status == kConverged; }
+  double chi2ndf() const { return ndf > 0 ? chi2 / ndf : 0.0; }
+};
+
+namespace gausfit_detail {
+
+constexpr int kMaxPar = 5;
+
+// Solves (a) x = b for a symmetric positive definite np x np matrix (Cholesky); false if singular.
+inline bool SolveSPD(double a[kMaxPar][kMaxPar], const double* b, double* x, int np) {
+  double l[kMaxPar][kMaxPar] = {};
+  for (int i = 0; i < np; ++i) {
+    for (int j = 0; j <= i; ++j) {
+      double s = a[i][j];
+      for (int k = 0; k < j; ++k) s -= l[i][k] * l[j][k];
+      if (i == j) {
+        if (!(s > 0.0)) return false;
+        l[i][i] = std::sqrt(s);
+      } else {
+        l[i][j] = s / l[j][j];
+      }
+    }
+  }
+  double z[kMaxPar];
+  for (int i = 0; i < np; ++i) {
+    double s = b[i];
+    for (int k = 0; k < i; ++k) s -= l[i][k] * z[k];
+    z[i] = s / l[i][i];
+  }
+  for (int i = np - 1; i >= 0; --i) {
+    double s = z[i];
+    for (int k = i + 1; k < np; ++k) s -= l[k][i] * x[k];
+    x[i] = s / l[i][i];
+  }
+  return true;
+}
+
+// Bins of one fit, as contiguous arrays.
+struct Bins {
+  std::vector<double> x, y, w; // w: chi2 weight 1/error^2 (0 for bins that are skipped) for kChi2
+  int nUsed = 0;
+};
+
+inline Bins Select(const GausFitTask& t) {
+  Bins b;
+  if (!t.y || t.n <= 0 || !(t.xhi > t.xlo)) return b;
+  const double dx = (t.xhi - t.xlo) / t.n;
+  // first/last bin with centre in [lo, hi]
+  int i0 = static_cast<int>(std::ceil((t.lo - t.xlo) / dx - 0.5));
+  int i1 = static_cast<int>(std::floor((t.hi - t.xlo) / dx - 0.5));
+  i0 = std::max(i0, 0);
+  i1 = std::min(i1, t.n - 1);
+  if (i1 < i0) return b;
+
+  const size_t m = static_cast<size_t>(i1 - i0 + 1);
+  b.x.resize(m);
+  b.y.resize(m);
+  b.w.resize(m);
+  for (size_t k = 0; k < m; ++k) {
+    const int i = i0 + static_cast<int>(k);
+    const double yi = t.y[i];
+    const double vi = t.e2 ? t.e2[i] : yi;
+    b.x[k] = t.xlo + (i + 0.5) * dx;
+    b.y[k] = yi;
+    b.w[k] = (vi > 0.0) ? 1.0 / vi : 0.0;
+    if (t.cost == GausFitCost::kPoissonML || vi > 0.0) ++b.nUsed;
+  }
+  return b;
+}
+
+// Baker-Cousins term of one bin. f <= 0 is allowed only where y = 0 (a background that dips
+// below zero in empty tails), so zero-background peaks fitted with background still converge.
+inline double MLTerm(double y, double f) {
+  if (y > 0.0) return (f > 0.0) ? 2.0 * (f - y + y * std::log(y / f)) : std::numeric_limits<double>::infinity();
+  return 2.0 * std::max(f, 0.0);
+}
+
+// One pass over the bins: cost, curvature matrix and gradient (both halved).
+inline double Accumulate(const Bins& b, const GausFitTask& t, const double* p, double xc, int np,
+                         double jtj[kMaxPar][kMaxPar], double* jtr) {
+  for (int i = 0; i < np; ++i) {
+    jtr[i] = 0.0;
+    for (int j = 0; j < np; ++j) jtj[i][j] = 0.0;
+  }
+  const bool ml = (t.cost == GausFitCost::kPoissonML);
+  const double A = p[0], mu = p[1], is = 1.0 / p[2];
+  const double b0 = (np > 3) ? p[3] : 0.0, b1 = (np > 4) ? p[4] : 0.0;
+
+  double cost = 0.0;
+  const size_t m = b.x.size();
+  for (size_t k = 0; k < m; ++k) {
+    const double u  = (b.x[k] - mu) * is;
+    const double g  = std::exp(-0.5 * u * u);
+    const double dx = b.x[k] - xc;
+    const double f  = A * g + b0 + b1 * dx;
+    const double y  = b.y[k];
+
+    // gradient weight gr and curvature weight wh:
+    //   chi2: gr = (y-f)/e^2, wh = 1/e^2 (e^2 = y without e2)
+    //   ML  : gr = (y-f)/f, wh = y/f^2 (Newton without f''; = 1/f at y = f; empty bins only push f down to 0)
+    double gr, wh;
+    if (ml) {
+      if (y > 0.0) {
+        gr = (y - f) / f;
+        wh = y / (f * f);
+      } else {
+        gr = (f > 0.0) ? -1.0 : 0.0;
+        wh = 0.0;
+      }
+      cost += MLTerm(y, f);
+    } else {
+      const double r = y - f;
+      gr = b.w[k] * r;
+      wh = b.w[k];
+      cost += b.w[k] * r * r;
+    }
+
+    const double d[kMaxPar] = {g, A * g * u * is, A * g * u * u * is, 1.0, dx};
+    for (int i = 0; i < np; ++i) {
+      jtr[i] += gr * d[i];
+      for (int j = 0; j <= i; ++j) jtj[i][j] += wh * d[i] * d[j];
+    }
+  }
+  for (int i = 0; i < np; ++i)
+    for (int j = i + 1; j < np; ++j) jtj[i][j] = jtj[j][i];
+  return cost;
+}
+
+inline double CostOnly(const Bins& b, const GausFitTask& t, const double* p, double xc, int np) {
+  const bool ml = (t.cost == GausFitCost::kPoissonML);
+  const double A = p[0], mu = p[1], is = 1.0 / p[2];
+  const double b0 = (np > 3) ? p[3] : 0.0, b1 = (np > 4) ? p[4] : 0.0;
+  double cost = 0.0;
+  const size_t m = b.x.size();
+  for (size_t k = 0; k < m; ++k) {
+    const double u = (b.x[k] - mu) * is;
+    const double f = A * std::exp(-0.5 * u * u) + b0 + b1 * (b.x[k] - xc);
+    const double y = b.y[k];
+    if (ml) {
+      cost += MLTerm(y, f);
+    } else {
+      const double r = y - f;
+      cost += b.w[k] * r * r;
+    }
+  }
+  return cost;
+}
+
+} // namespace gausfit_detail
+
+inline GausFitResult FitGaus(const GausFitTask& t) {
+  using namespace gausfit_detail;
+  GausFitResult res;
+
+  const int np = t.background ? (t.flatBackground ? 4 : 5) : 3;
+  const Bins b = Select(t);
+  if (b.nUsed <= np) return res;
+
+  const double xc = 0.5 * (t.lo + t.hi);
+  const double sMin = std::max(t.sigmaMin, 1e-12);
+
+  double pLo[kMaxPar] = {-std::numeric_limits<double>::infinity(), t.muMin, sMin,
+                         -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+  double pHi[kMaxPar] = {std::numeric_limits<double>::infinity(), t.muMax, t.sigmaMax,
+                         std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+  auto clamp = [&](double* p) {
+    for (int i = 0; i < np; ++i) p[i] = std::min(std::max(p[i], pLo[i]), pHi[i]);
+  };
+
+  // background start values are given at x, the fit uses x - xc
+  double p[kMaxPar] = {t.A0, t.mu0, std::fabs(t.sigma0), t.b00 + t.b10 * xc, t.b10};
+  if (np == 4) { p[3] = t.b00; p[4] = 0.0; }
+  clamp(p);
+
+  // likelihood: start from the chi2 minimum (the likelihood is steep far from it, where f << y)
+  if (t.cost == GausFitCost::kPoissonML) {
+    GausFitTask pre = t;
+    pre.cost = GausFitCost::kChi2;
+    const GausFitResult r0 = FitGaus(pre);
+    double p0[kMaxPar] = {r0.A, r0.mu, r0.sigma, r0.b0, r0.b1};
+    // chi2 background may dip below zero under filled bins: flatten it to >= 0 then
+    if (np > 3 && !std::isfinite(CostOnly(b, t, p0, xc, np))) { p0[3] = std::max(p0[3], 0.0); p0[4] = 0.0; }
+    if (r0.ok() && std::isfinite(CostOnly(b, t, p0, xc, np))) {
+      for (int i = 0; i < np; ++i) p[i] = p0[i];
+    }
+  }
+
+  double jtj[kMaxPar][kMaxPar], jtr[kMaxPar];
+  double cost = Accumulate(b, t, p, xc, np, jtj, jtr);
+
+  double lambda = 1e-3;
+  res.status = GausFitResult::kMaxIter;
+  int it = 0;
+  for (; it < t.maxIter; ++it) {
+    double a[kMaxPar][kMaxPar];
+    for (int i = 0; i < np; ++i) {
+      for (int j = 0; j < np; ++j) a[i][j] = jtj[i][j];
+      a[i][i] += lambda * (jtj[i][i] > 0.0 ? jtj[i][i] : 1.0);
+    }
+    double dp[kMaxPar] = {};
+    if (!SolveSPD(a, jtr, dp, np)) {
+      lambda *= 10.0;
+      if (lambda > 1e12) { res.status = GausFitResult::kSingular; break; }
+      continue;
+    }
+
+    double pn[kMaxPar];
+    for (int i = 0; i < np; ++i) pn[i] = p[i] + dp[i];
+    clamp(pn);
+
+    const double costN = CostOnly(b, t, pn, xc, np);
+    if (std::isfinite(costN) && costN <= cost) {
+      double step = 0.0;
+      for (int i = 0; i < np; ++i) step = std::max(step, std::fabs(pn[i] - p[i]) / (std::fabs(p[i]) + 1e-6));
+      const double drop = cost - costN;
+      for (int i = 0; i < np; ++i) p[i] = pn[i];
+      cost = Accumulate(b, t, p, xc, np, jtj, jtr);
+      lambda = std::max(lambda * 0.1, 1e-12);
+      if (drop <= 1e-10 * (cost + 1e-10) || step < 1e-10) {
+        res.status = GausFitResult::kConverged;
+        ++it;
+        break;
+      }
+    } else {
+      lambda *= 10.0;
+      if (lambda > 1e12) {
+        // no downhill step left: at a (possibly bounded) minimum
+        res.status = GausFitResult::kConverged;
+        break;
+      }
+    }
+  }
+  res.iter = it;
+
+  res.A = p[0];
+  res.mu = p[1];
+  res.sigma = p[2];
+  if (np > 3) { res.b0 = p[3]; res.b1 = (np > 4) ? p[4] : 0.0; }
+  res.chi2 = cost;
+  res.ndf = b.nUsed - np;
+
+  // parameter errors: diagonal of (J^T W J)^-1
+  for (int k = 0; k < 3; ++k) {
+    double e[kMaxPar] = {};
+    e[k] = 1.0;
+    double a[kMaxPar][kMaxPar];
+    for (int i = 0; i < np; ++i)
+      for (int j = 0; j < np; ++j) a[i][j] = jtj[i][j];
+    double col[kMaxPar] = {};
+    const double v = SolveSPD(a, e, col, np) ? col[k] : 0.0;
+    const double err = (v > 0.0) ? std::sqrt(v) : 0.0;
+    if (k == 0) res.eA = err;
+    else if (k == 1) res.emu = err;
+    else res.esigma = err;
+  }
+
+  if (!std::isfinite(res.A) || !std::isfinite(res.mu) || !std::isfinite(res.sigma) || !std::isfinite(cost)) {
+    res.status = GausFitResult::kSingular;
+  }
+  return res;
+}
+
+// Independent fits, optionally on several threads (nThreads <= 0: hardware concurrency).
+// out[i] belongs to tasks[i]; the result does not depend on nThreads.
+inline std::vector<GausFitResult> FitGausBatch(const std::vector<GausFitTask>& tasks, int nThreads = 1) {
+  std::vector<GausFitResult> out(tasks.size());
+  if (tasks.empty()) return out;
+  if (nThreads <= 0) nThreads = static_cast<int>(std::thread::hardware_concurrency());
+  nThreads = std::max(1, std::min<int>(nThreads, static_cast<int>(tasks.size())));
+
+  auto worker = [&](int w) {
+    for (size_t i = static_cast<size_t>(w); i < tasks.size(); i += static_cast<size_t>(nThreads)) {
+      out[i] = FitGaus(tasks[i]);
+    }
+  };
+  if (nThreads == 1) {
+    worker(0);
+    return out;
+  }
+  std::vector<std::thread> pool;
+  for (int w = 0; w < nThreads; ++w) pool.emplace_back(worker, w);
+  for (auto& th : pool) th.join();
+  return out;
+}
@@ -0,0 +1,172 @@
+#pragma once
+// HistBank: many fixed-bin 1D/2D count histograms (one per channel) in one contiguous uint32_t
+// array, for filling from RDataFrame::ForeachSlot without nSlots x nChannels TH1D/TH2D objects.
+// Used by:
+//   DSSD_outcal_all_byCh/PerChannelCalibrator.cpp  raw ADC spectra (224 x 4096)
+//   DSSD_recal_all/Normalize_Main.cpp              strip vs reference-strip maps (176 x 200x200)
+//   DSSD_recal_all/Calibrator.cpp                  per-strip normalized-ADC spectra (176 x 20000)
+// Build: add -I../common (see the Makefiles).
+//
+// Layout: channel ch owns cells [ch*nCells, (ch+1)*nCells), in ROOT's global-bin order
+// (underflow and overflow included), so a channel converts to TH1D/TH2D bin by bin.
+// Fill modes:
+//   kSharded: one array per slot, allocated on the slot's first fill (idle slots cost nothing);
+//             Merge() adds them pairwise (tree reduction), each level split over threads.
+//   kAtomic : one shared array, relaxed atomic increments; Merge() is a no-op. For large banks
+//             (2D maps) where nSlots copies would not fit.
+// Counts are unweighted (TH1::Fill(x) semantics): Entries(ch) = number of fills of ch.
+// Convert with ToTH1D/ToTH2D only for the channels that are written or fitted.
+
+#include "TH1D.h"
+#include "TH2D.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class HistBank {
+public:
+  enum class Mode { kSharded, kAtomic };
+
+  // 1D bank: nCh histograms of nbx bins on [xlo, xhi)
+  HistBank(int nCh, int nbx, double xlo, double xhi, unsigned nSlots, Mode mode = Mode::kSharded)
+    : HistBank(nCh, nbx, xlo, xhi, 0, 0.0, 0.0, nSlots, mode) {}
+
+  // 2D bank: nCh histograms of nbx x nby bins on [xlo, xhi) x [ylo, yhi)
+  HistBank(int nCh, int nbx, double xlo, double xhi, int nby, double ylo, double yhi,
+           unsigned nSlots, Mode mode = Mode::kSharded)
+    : nCh_(nCh), nbx_(nbx), nby_(nby), xlo_(xlo), xhi_(xhi), ylo_(ylo), yhi_(yhi), mode_(mode) {
+    nCells_ = static_cast<size_t>(nbx_ + 2) * (nby_ > 0 ? static_cast<size_t>(nby_ + 2) : 1u);
+    if (mode_ == Mode::kAtomic) {
+      slots_.resize(1);
+      slots_[0].assign(nCells_ * nCh_, 0u);
+    } else {
+      slots_.resize(std::max(1u, nSlots));
+    }
+  }
+
+  int NChannels() const { return nCh_; }
+  bool Is2D() const { return nby_ > 0; }
+
+  void Fill(unsigned slot, int ch, double x) {
+    Add(slot, static_cast<size_t>(ch) * nCells_ + XBin(x));
+  }
+
+  void Fill(unsigned slot, int ch, double x, double y) {
+    Add(slot, static_cast<size_t>(ch) * nCells_ + static_cast<size_t>(YBin(y)) * (nbx_ + 2) + XBin(x));
+  }
+
+  // Sum all slots into one array (call once, after filling). nThreads <= 0: hardware concurrency.
+  void Merge(int nThreads = 0) {
+    if (mode_ == Mode::kAtomic || slots_.size() == 1) {
+      if (slots_[0].empty()) slots_[0].assign(nCells_ * nCh_, 0u);
+      slots_.resize(1);
+      return;
+    }
+    if (nThreads <= 0) nThreads = static_cast<int>(std::thread::hardware_concurrency());
+    nThreads = std::max(1, nThreads);
+
+    const size_t n = nCells_ * nCh_;
+    const size_t kChunk = size_t(1) << 16;
+    const size_t nChunks = (n + kChunk - 1) / kChunk;
+
+    for (size_t step = 1; step < slots_.size(); step *= 2) {
+      // pairs (s, s+step) at this level, each split into chunks
+      std::vector<std::pair<size_t, size_t>> pairs;
+      for (size_t s = 0; s + step < slots_.size(); s += 2 * step) {
+        if (slots_[s + step].empty()) continue;
+        if (slots_[s].empty()) { slots_[s].swap(slots_[s + step]); continue; }
+        pairs.emplace_back(s, s + step);
+      }
+      const size_t nTasks = pairs.size() * nChunks;
+      std::atomic<size_t> next{0};
+      auto worker = [&]() {
+        for (size_t t = next++; t < nTasks; t = next++) {
+          const auto& pr = pairs[t / nChunks];
+          const size_t lo = (t % nChunks) * kChunk;
+          const size_t hi = std::min(n, lo + kChunk);
+          uint32_t* dst = slots_[pr.first].data();
+          const uint32_t* src = slots_[pr.second].data();
+          for (size_t i = lo; i < hi; ++i) dst[i] += src[i];
+        }
+      };
+      const int nt = static_cast<int>(std::min<size_t>(nThreads, nTasks));
+      if (nt <= 1) {
+        worker();
+      } else {
+        std::vector<std::thread> pool;
+        for (int i = 0; i < nt; ++i) pool.emplace_back(worker);
+        for (auto& th : pool) th.join();
+      }
+      for (const auto& pr : pairs) std::vector<uint32_t>().swap(slots_[pr.second]);
+    }
+    if (slots_[0].empty()) slots_[0].assign(n, 0u);
+    slots_.resize(1);
+  }
+
+  // ---- after Merge ----
+  const uint32_t* Cells(int ch) const { return slots_[0].data() + static_cast<size_t>(ch) * nCells_; }
+
+  uint64_t Entries(int ch) const {
+    const uint32_t* c = Cells(ch);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < nCells_; ++i) sum += c[i];
+    return sum;
+  }
+
+  std::unique_ptr<TH1D> ToTH1D(int ch, const char* name, const char* title) const {
+    auto h = std::make_unique<TH1D>(name, title, nbx_, xlo_, xhi_);
+    h->SetDirectory(nullptr);
+    const uint32_t* c = Cells(ch);
+    for (int b = 0; b <= nbx_ + 1; ++b) {
+      if (c[b]) h->SetBinContent(b, c[b]);
+    }
+    h->ResetStats();
+    h->SetEntries(static_cast<double>(Entries(ch)));
+    return h;
+  }
+
+  std::unique_ptr<TH2D> ToTH2D(int ch, const char* name, const char* title) const {
+    auto h = std::make_unique<TH2D>(name, title, nbx_, xlo_, xhi_, nby_, ylo_, yhi_);
+    h->SetDirectory(nullptr);
+    const uint32_t* c = Cells(ch);
+    for (int by = 0; by <= nby_ + 1; ++by) {
+      for (int bx = 0; bx <= nbx_ + 1; ++bx) {
+        const uint32_t v = c[static_cast<size_t>(by) * (nbx_ + 2) + bx];
+        if (v) h->SetBinContent(bx, by, v);
+      }
+    }
+    h->ResetStats();
+    h->SetEntries(static_cast<double>(Entries(ch)));
+    return h;
+  }
+
+private:
+  // same expression as TAxis::FindFixBin on a fixed-bin axis (NaN -> overflow)
+  static int AxisBin(double v, double lo, double hi, int nb) {
+    if (v < lo) return 0;
+    if (!(v < hi)) return nb + 1;
+    return 1 + static_cast<int>(nb * (v - lo) / (hi - lo));
+  }
+  int XBin(double x) const { return AxisBin(x, xlo_, xhi_, nbx_); }
+  int YBin(double y) const { return AxisBin(y, ylo_, yhi_, nby_); }
+
+  void Add(unsigned slot, size_t cell) {
+    if (mode_ == Mode::kAtomic) {
+      __atomic_fetch_add(&slots_[0][cell], 1u, __ATOMIC_RELAXED);
+      return;
+    }
+    std::vector<uint32_t>& s = slots_[slot];
+    if (s.empty()) s.assign(nCells_ * nCh_, 0u); // only this slot's thread touches it
+    ++s[cell];
+  }
+
+  int nCh_, nbx_, nby_;
+  double xlo_, xhi_, ylo_, yhi_;
+  Mode mode_;
+  size_t nCells_ = 0;
+  std::vector<std::vector<uint32_t>> slots_;
+};
@@ -0,0 +1,302 @@
+#pragma once
+// LineMatch: identify known lines among candidate peaks by finding the gain/offset (k, b) that
+// maps the most candidates x onto reference energies E (E = k * x + b), with no per-line windows.
+// Header-only and ROOT-free, shared by:
+//   DSSD_outcal_all_byCh/PerChannelCalibrator.cpp  raw ADC spectra, EREF triplet
+//   DSSD_recal_all/Calibrator.cpp                  plane spectra, REF_PEAKS
+//   SSD_calibration/SSD_calibration.cpp            DSSD_E + SSD_E per position, peaks_of_interest
+// Build: add -I../common (see the Makefiles).
+//
+// Search (Hough transform over (k, b)):
+//   k runs over a geometric grid on [kMin, kMax], fine enough that one step moves a prediction
+//   across the candidate span by less than the tolerance. At fixed k, candidate i and line j vote
+//   for the interval b in E_j - k * x_i +- tol_j; a sweep over the sorted interval ends finds the
+//   b where the covered lines weigh most (1 + height of the tallest candidate, per line). Cost
+//   ~ nK * nCand * nLines * log, linear in lines and candidates: no subsets are enumerated.
+//   The strongest distinct cells are refined: one-to-one assignment of lines to the nearest
+//   candidate within tolerance, least-squares line, repeated until the assignment is stable. Refined
+//   hypotheses are ranked by score = sum over matched lines of (1 + h) * (1 - (r / tol)^2), with
+//   h the candidate height relative to the tallest: real lines are tall and sit close to the line.
+// Confidence in [0, 1], monotone in the number of matched lines n out of L:
+//   confidence = (n - 1 + q) / L, so n matched lines always score in [(n-1)/L, n/L] and a match
+//   of more lines never ranks below one of fewer. The quality q in [0, 1] places it inside the
+//   band: (1 - rms / tol) x margin over the best hypothesis that calibrates differently
+//   (predictions over the candidate span differ by more than tol). Any two peaks fit two lines,
+//   so the margin only counts the score beyond the two best-matching lines.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+struct LinePeak {
+  double x;      // position (channel)
+  double height; // e.g. TSpectrum GetPositionY or bin content; only ratios are used
+};
+
+struct RefLine {
+  double energy;
+  double tol; // max |E - (k x + b)| for a match, energy units
+};
+
+struct LineMatchOptions {
+  double kMin = 0.5, kMax = 2.0; // gain range, energy per channel (kMin > 0)
+  double bMin = -std::numeric_limits<double>::infinity();
+  double bMax = std::numeric_limits<double>::infinity();
+  double tolX = 0.0;   // extra tolerance in channels, added as k * tolX to every line
+  int minMatched = 2;  // fewer matched lines: ok = false
+  int maxCands = 50;   // only the tallest candidates take part
+  int maxKSteps = 20000;
+  int nRefine = 64;    // Hough cells (distinct, strongest first) that are refined
+};
+
+struct LineMatchResult {
+  bool ok = false;
+  double k = 1.0, b = 0.0;
+  int nMatched = 0;
+  double rms = 0.0;        // energy residual of the matched lines
+  double confidence = 0.0;
+  std::vector<int> cand;   // per line: index into the candidate list, -1 if unmatched
+  std::vector<double> x;   // per line: matched candidate position, 0 if unmatched
+};
+
+namespace linematch_detail {
+
+struct Hyp {
+  double k = 0.0, b = 0.0, rms = 0.0;
+  double score = 0.0;    // sum over matched lines of (1 + height) * (1 - (r / tol)^2)
+  double evidence = 0.0; // score beyond the two best-matching lines (which any line passes through)
+  int n = 0;
+  std::vector<int> cand; // per line, index into the kept candidates
+};
+
+// one-to-one: all (line, candidate) pairs within tolerance (+ extra), closest (relative) first
+inline int Assign(const std::vector<LinePeak>& c, const std::vector<RefLine>& lines, double tolX,
+                  double k, double b, std::vector<int>& cand, double extra = 0.0) {
+  struct Pair { double r; int i, j; };
+  std::vector<Pair> pairs;
+  for (size_t j = 0; j < lines.size(); ++j) {
+    const double tol = lines[j].tol + std::abs(k) * tolX + extra;
+    for (size_t i = 0; i < c.size(); ++i) {
+      const double r = std::abs(lines[j].energy - (k * c[i].x + b));
+      if (r <= tol) pairs.push_back({r / tol, static_cast<int>(i), static_cast<int>(j)});
+    }
+  }
+  std::sort(pairs.begin(), pairs.end(), [](const Pair& p, const Pair& q) { return p.r < q.r; });
+  cand.assign(lines.size(), -1);
+  std::vector<char> used(c.size(), 0);
+  int n = 0;
+  for (const Pair& p : pairs) {
+    if (cand[p.j] >= 0 || used[p.i]) continue;
+    cand[p.j] = p.i;
+    used[p.i] = 1;
+    ++n;
+  }
+  return n;
+}
+
+// least-squares E = k x + b over the assigned lines
+inline bool FitAssigned(const std::vector<LinePeak>& c, const std::vector<RefLine>& lines,
+                        const std::vector<int>& cand, double& k, double& b) {
+  double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (size_t j = 0; j < lines.size(); ++j) {
+    if (cand[j] < 0) continue;
+    const double x = c[cand[j]].x, y = lines[j].energy;
+    n += 1; sx += x; sy += y; sxx += x * x; sxy += x * y;
+  }
+  const double den = n * sxx - sx * sx;
+  if (n < 2 || !(std::abs(den) > 1e-12)) return false;
+  k = (n * sxy - sx * sy) / den;
+  b = (sy - k * sx) / n;
+  return std::isfinite(k) && std::isfinite(b);
+}
+
+// start from a Hough cell (k, b): the first assignment uses the cell's vote width (slack
+// included), so the cell's matches are kept even when b lies near the edge of the overlap
+inline Hyp Refine(const std::vector<LinePeak>& c, const std::vector<RefLine>& lines,
+                  const LineMatchOptions& opt, double k, double b, double slack) {
+  Hyp h;
+  std::vector<int> cand, prev;
+  for (int it = 0; it < 10; ++it) {
+    Assign(c, lines, opt.tolX, k, b, cand, it == 0 ? slack : 0.0);
+    if (cand == prev) break;
+    if (!FitAssigned(c, lines, cand, k, b)) break;
+    prev = cand;
+  }
+  // final state: parameters from the fit, assignment made with them
+  h.n = Assign(c, lines, opt.tolX, k, b, cand);
+  if (h.n < 2 || !FitAssigned(c, lines, cand, k, b)) return Hyp{};
+  if (k < opt.kMin || k > opt.kMax || b < opt.bMin || b > opt.bMax) return Hyp{};
+  h.k = k; h.b = b; h.cand = cand;
+  double s2 = 0, top1 = 0, top2 = 0;
+  for (size_t j = 0; j < lines.size(); ++j) {
+    if (cand[j] < 0) continue;
+    const double r = lines[j].energy - (k * c[cand[j]].x + b);
+    const double u = r / (lines[j].tol + std::abs(k) * opt.tolX);
+    const double w = (1.0 + c[cand[j]].height) * std::max(0.0, 1.0 - u * u);
+    s2 += r * r;
+    h.score += w;
+    if (w > top1) { top2 = top1; top1 = w; } else if (w > top2) { top2 = w; }
+  }
+  h.rms = std::sqrt(s2 / h.n);
+  h.evidence = (lines.size() > 2) ? h.score - top1 - top2 : h.score;
+  return h;
+}
+
+// ranking: score (matched lines weighted by height and closeness), then smaller rms
+inline bool Better(const Hyp& p, const Hyp& q) {
+  if (p.score != q.score) return p.score > q.score;
+  return p.rms < q.rms;
+}
+
+} // namespace linematch_detail
+
+// cands: any order (positions need not be unique); lines: any order, tol > 0.
+inline LineMatchResult MatchLines(const std::vector<LinePeak>& cands, const std::vector<RefLine>& lines,
+                                  const LineMatchOptions& opt = LineMatchOptions()) {
+  using namespace linematch_detail;
+  LineMatchResult res;
+  res.cand.assign(lines.size(), -1);
+  res.x.assign(lines.size(), 0.0);
+  if (cands.size() < 2 || lines.size() < 2 || !(opt.kMin > 0) || !(opt.kMax >= opt.kMin)) return res;
+
+  // tallest maxCands candidates, heights normalised to the tallest; idx maps back to cands
+  std::vector<int> idx(cands.size());
+  for (size_t i = 0; i < idx.size(); ++i) idx[i] = static_cast<int>(i);
+  std::stable_sort(idx.begin(), idx.end(), [&](int a, int b) { return cands[a].height > cands[b].height; });
+  if (static_cast<int>(idx.size()) > opt.maxCands) idx.resize(std::max(opt.maxCands, 2));
+  std::vector<LinePeak> c(idx.size());
+  const double hTop = cands[idx[0]].height > 0 ? cands[idx[0]].height : 1.0;
+  double xlo = cands[idx[0]].x, xhi = xlo;
+  for (size_t i = 0; i < idx.size(); ++i) {
+    c[i] = {cands[idx[i]].x, std::max(cands[idx[i]].height, 0.0) / hTop};
+    xlo = std::min(xlo, c[i].x);
+    xhi = std::max(xhi, c[i].x);
+  }
+  const double span = std::max(xhi - xlo, 1.0);
+  double tolMin = lines[0].tol;
+  for (const RefLine& l : lines) tolMin = std::min(tolMin, l.tol);
+
+  // k grid: relative step so that a rotation over the span stays within the tolerance
+  double step = tolMin / (opt.kMax * span) + opt.tolX / span;
+  int nK = 1;
+  if (opt.kMax > opt.kMin) {
+    nK = static_cast<int>(std::ceil(std::log(opt.kMax / opt.kMin) / std::log1p(step))) + 1;
+    if (nK > opt.maxKSteps) {
+      nK = opt.maxKSteps;
+      step = std::expm1(std::log(opt.kMax / opt.kMin) / (nK - 1));
+    }
+  }
+
+  // Hough: per k row, the b covered by the best set of lines; each covered line counts
+  // 1 + height of its tallest active candidate (the refined score without the residual term)
+  struct Event { double pos; int open; int j; double h; };
+  struct Cell { double w = 0.0, b = 0.0; int row = 0; };
+  std::vector<Cell> cells;
+  std::vector<Event> ev;
+  ev.reserve(2 * c.size() * lines.size());
+  std::vector<std::vector<double>> active(lines.size());
+  std::vector<double> lineW(lines.size());
+  for (int r = 0; r < nK; ++r) {
+    const double k = (nK == 1) ? opt.kMin : opt.kMin * std::pow(1.0 + step, r);
+    if (k > opt.kMax * (1.0 + 1e-12)) break;
+    const double slack = 0.5 * step * k * span;
+    ev.clear();
+    for (size_t j = 0; j < lines.size(); ++j) {
+      const double w = lines[j].tol + k * opt.tolX + slack;
+      for (size_t i = 0; i < c.size(); ++i) {
+        const double b0 = lines[j].energy - k * c[i].x;
+        if (b0 + w < opt.bMin || b0 - w > opt.bMax) continue;
+        ev.push_back({b0 - w, 1, static_cast<int>(j), c[i].height});
+        ev.push_back({b0 + w, 0, static_cast<int>(j), c[i].height});
+      }
+    }
+    std::sort(ev.begin(), ev.end(), [](const Event& p, const Event& q) {
+      return p.pos < q.pos || (p.pos == q.pos && p.open > q.open); // closed intervals: open first
+    });
+    for (auto& a : active) a.clear();
+    std::fill(lineW.begin(), lineW.end(), 0.0);
+    int n = 0;
+    double W = 0.0;
+    Cell best;
+    best.row = r;
+    for (size_t e = 0; e < ev.size(); ++e) {
+      const Event& x = ev[e];
+      std::vector<double>& a = active[x.j];
+      if (x.open) {
+        if (a.empty()) ++n;
+        a.push_back(x.h);
+      } else {
+        a.erase(std::find(a.begin(), a.end(), x.h));
+        if (a.empty()) --n;
+      }
+      const double lw = a.empty() ? 0.0 : 1.0 + *std::max_element(a.begin(), a.end());
+      W += lw - lineW[x.j];
+      lineW[x.j] = lw;
+      // evaluate once all intervals opening here are in
+      if (!x.open || n < 2) continue;
+      if (e + 1 < ev.size() && ev[e + 1].open && ev[e + 1].pos == x.pos) continue;
+      if (W > best.w) {
+        best.w = W;
+        best.b = (e + 1 < ev.size()) ? 0.5 * (x.pos + ev[e + 1].pos) : x.pos;
+      }
+    }
+    if (best.w > 0.0) cells.push_back(best);
+  }
+
+  // strongest cells first; a cell within two k steps of a chosen one and inside its vote
+  // interval is the same hypothesis and is skipped. Vote widths grow with k, so the cells
+  // are only a shortlist: the chosen ones are refined and ranked by the residual-aware score.
+  std::sort(cells.begin(), cells.end(), [](const Cell& p, const Cell& q) { return p.w > q.w; });
+  std::vector<Cell> chosen;
+  for (const Cell& cl : cells) {
+    if (static_cast<int>(chosen.size()) >= opt.nRefine) break;
+    bool same = false;
+    for (const Cell& o : chosen) {
+      if (std::abs(o.row - cl.row) > 2) continue;
+      const double ko = opt.kMin * std::pow(1.0 + step, o.row);
+      same = same || std::abs(o.b - cl.b) <= tolMin + ko * opt.tolX;
+    }
+    if (!same) chosen.push_back(cl);
+  }
+
+  std::vector<Hyp> hyps;
+  for (const Cell& cl : chosen) {
+    const double k = (nK == 1) ? opt.kMin : opt.kMin * std::pow(1.0 + step, cl.row);
+    Hyp h = Refine(c, lines, opt, k, cl.b, 0.5 * step * k * span);
+    if (h.n < 2) continue;
+    bool dup = false;
+    for (const Hyp& o : hyps) dup = dup || (o.cand == h.cand);
+    if (!dup) hyps.push_back(std::move(h));
+  }
+  if (hyps.empty()) return res;
+  std::sort(hyps.begin(), hyps.end(), Better);
+  const Hyp& best = hyps[0];
+
+  res.k = best.k;
+  res.b = best.b;
+  res.nMatched = best.n;
+  res.rms = best.rms;
+  res.ok = best.n >= opt.minMatched;
+  double tolSum = 0.0;
+  for (size_t j = 0; j < lines.size(); ++j) {
+    if (best.cand[j] < 0) continue;
+    res.cand[j] = idx[best.cand[j]];
+    res.x[j] = c[best.cand[j]].x;
+    tolSum += lines[j].tol + std::abs(best.k) * opt.tolX;
+  }
+  const double tolMean = tolSum / best.n;
+  const double fitq = std::max(0.0, 1.0 - best.rms / tolMean);
+  // runner-up: best hypothesis giving a different calibration (not just one swapped candidate)
+  double margin = 1.0;
+  for (size_t h = 1; h < hyps.size(); ++h) {
+    const double dk = hyps[h].k - best.k, db = hyps[h].b - best.b;
+    if (std::max(std::abs(dk * xlo + db), std::abs(dk * xhi + db)) <= tolMean) continue;
+    margin = (best.evidence > 0) ? std::clamp(1.0 - hyps[h].evidence / best.evidence, 0.0, 1.0) : 0.0;
+    break;
+  }
+  // the matched fraction sets the band, fit quality x margin the position inside it
+  res.confidence = (best.n - 1 + fitq * margin) / static_cast<double>(lines.size());
+  return res;
+}
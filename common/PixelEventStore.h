@@ -0,0 +1,280 @@
+#pragma once
+// PixelEventStore: on-disk index of DSSD events bucketed by pixel (X strip x Y strip) and sorted by
+// timestamp within each pixel, read through mmap. Built once from the tr_map files; afterwards a
+// correlation query ("implants in pixel p +- neighbours within [t - dt, t)") is a binary search in a
+// few short arrays instead of a pass over every run.
+// Used by:
+//   ChainBuilder/Store_Main.cpp   builds the store from tr_map (PixelEventStoreWriter, one run in memory)
+//   ChainBuilder/Chain_Main.cpp   --store FILE: rebuilds tr_chain from the store instead of tr_map
+//   ChainBuilder/Store_Query.cpp  look-back queries from the command line
+//   ChainBuilder/RandomCorr.cpp   per-pixel rates and the random-correlation Monte Carlo
+// Build: add -I../common (see the Makefiles). POSIX only (mmap).
+//
+// File layout (native little endian, 8-byte aligned):
+//   StoreHeader                      magic "PXEVST01", nx, ny, event count, time range
+//   uint64_t offset[nx * ny + 1]     events of pixel p = x * ny + y are [offset[p], offset[p + 1])
+//   StoreEvent event[n]              per pixel, sorted by (ts, run, entry)
+// Only events with DSSDX_mul == 1 && DSSDY_mul == 1 (a defined pixel) are stored; the detector
+// multiplicities that the implant/decay selections need are kept as flags.
+// Time queries assume a clock that does not go backwards across runs (same as ChainBuilder's
+// CHAIN_ACROSS_RUNS); the store is still sorted by ts within a pixel if it does.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum StoreFlags : uint8_t {
+  kStoreMWPC = 1, // MWPC_mul > 0 (implant side of Preselect)
+  kStoreSSD  = 2, // SSD_mul > 0
+  kStoreVeto = 4, // Veto_mul > 0
+};
+
+struct StoreEvent {
+  uint64_t ts;     // DSSDX_Ts[0] (ns)
+  float e;         // DSSDX_E[0] (keV)
+  float ssd_e;     // SSD_E[0], 0 without SSD
+  uint32_t entry;  // entry in the run's tr_map
+  uint16_t run;
+  uint8_t flags;   // StoreFlags
+  int8_t ssd_pos;  // SSD_Ch[0], -1 without SSD
+};
+static_assert(sizeof(StoreEvent) == 24, "StoreEvent is part of the file format");
+
+struct StoreHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t nx, ny;
+  uint32_t reserved;
+  uint64_t nEvents;
+  uint64_t tMin, tMax;
+};
+static_assert(sizeof(StoreHeader) == 48, "StoreHeader is part of the file format");
+
+inline constexpr char kStoreMagic[8] = {'P', 'X', 'E', 'V', 'S', 'T', '0', '1'};
+
+inline bool StoreEventLess(const StoreEvent& a, const StoreEvent& b) {
+  if (a.ts != b.ts) return a.ts < b.ts;
+  if (a.run != b.run) return a.run < b.run;
+  return a.entry < b.entry;
+}
+
+class PixelEventStore {
+public:
+  // nullptr if the file cannot be mapped or is not a store
+  static std::unique_ptr<PixelEventStore> Open(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(StoreHeader)) { ::close(fd); return nullptr; }
+    void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return nullptr;
+
+    std::unique_ptr<PixelEventStore> s(new PixelEventStore(p, static_cast<size_t>(st.st_size)));
+    const StoreHeader& h = *s->header_;
+    const size_t need = sizeof(StoreHeader) + (static_cast<size_t>(h.nx) * h.ny + 1) * sizeof(uint64_t)
+                      + h.nEvents * sizeof(StoreEvent);
+    if (std::memcmp(h.magic, kStoreMagic, 8) != 0 || h.version != 1 || need > s->size_) return nullptr;
+    s->offset_ = reinterpret_cast<const uint64_t*>(s->base_ + sizeof(StoreHeader));
+    s->events_ = reinterpret_cast<const StoreEvent*>(s->offset_ + static_cast<size_t>(h.nx) * h.ny + 1);
+    return s;
+  }
+
+  ~PixelEventStore() { ::munmap(const_cast<char*>(base_), size_); }
+  PixelEventStore(const PixelEventStore&) = delete;
+  PixelEventStore& operator=(const PixelEventStore&) = delete;
+
+  int NX() const { return static_cast<int>(header_->nx); }
+  int NY() const { return static_cast<int>(header_->ny); }
+  uint64_t Size() const { return header_->nEvents; }
+  uint64_t TMin() const { return header_->tMin; }
+  uint64_t TMax() const { return header_->tMax; }
+
+  // all events of pixel (x, y), sorted by time
+  const StoreEvent* Begin(int x, int y) const { return events_ + offset_[Pixel(x, y)]; }
+  const StoreEvent* End(int x, int y) const { return events_ + offset_[Pixel(x, y) + 1]; }
+
+  // events of pixel (x, y) with t0 <= ts < t1
+  std::pair<const StoreEvent*, const StoreEvent*> Range(int x, int y, uint64_t t0, uint64_t t1) const {
+    const StoreEvent* b = Begin(x, y);
+    const StoreEvent* e = End(x, y);
+    auto lo = std::lower_bound(b, e, t0, [](const StoreEvent& ev, uint64_t t) { return ev.ts < t; });
+    auto hi = std::lower_bound(lo, e, t1, [](const StoreEvent& ev, uint64_t t) { return ev.ts < t; });
+    return {lo, hi};
+  }
+
+  // f(x, y, ev) for every event within |dx|, |dy| <= win of (x, y) and t0 <= ts < t1 (pixel by pixel)
+  template <class F>
+  void ForEach(int x, int y, int win, uint64_t t0, uint64_t t1, F&& f) const {
+    for (int xi = std::max(0, x - win); xi <= std::min(NX() - 1, x + win); ++xi) {
+      for (int yi = std::max(0, y - win); yi <= std::min(NY() - 1, y + win); ++yi) {
+        auto r = Range(xi, yi, t0, t1);
+        for (const StoreEvent* ev = r.first; ev != r.second; ++ev) f(xi, yi, *ev);
+      }
+    }
+  }
+
+  // latest event with pred(ev) in the neighbourhood and t - dtMax <= ts < t; nullptr if none.
+  // Each pixel is walked backwards from t, so the cost is the number of events that fail pred.
+  template <class Pred>
+  const StoreEvent* LookBack(int x, int y, int win, uint64_t t, uint64_t dtMax, Pred&& pred,
+                             int* px = nullptr, int* py = nullptr) const {
+    const uint64_t t0 = (t > dtMax) ? t - dtMax : 0;
+    const StoreEvent* best = nullptr;
+    for (int xi = std::max(0, x - win); xi <= std::min(NX() - 1, x + win); ++xi) {
+      for (int yi = std::max(0, y - win); yi <= std::min(NY() - 1, y + win); ++yi) {
+        auto r = Range(xi, yi, t0, t);
+        for (const StoreEvent* ev = r.second; ev != r.first;) {
+          --ev;
+          if (best && ev->ts <= best->ts) break;
+          if (!pred(*ev)) continue;
+          best = ev;
+          if (px) *px = xi;
+          if (py) *py = yi;
+          break;
+        }
+      }
+    }
+    return best;
+  }
+
+private:
+  PixelEventStore(void* p, size_t size)
+    : base_(static_cast<const char*>(p)), size_(size), header_(reinterpret_cast<const StoreHeader*>(p)) {}
+
+  size_t Pixel(int x, int y) const { return static_cast<size_t>(x) * header_->ny + y; }
+
+  const char* base_;
+  size_t size_;
+  const StoreHeader* header_;
+  const uint64_t* offset_ = nullptr;
+  const StoreEvent* events_ = nullptr;
+};
+
+// Builds a store with one run in memory at a time:
+//   AddRun: sort the run's events by (pixel, time), append them to a temporary file, keep the
+//           per-pixel counts of the run
+//   Finish: size the output from the counts, copy every run's pixel slices into place through a
+//           writable mmap (runs in the order they were added), then sort any pixel whose slices
+//           are out of time order (clock reset between runs), pixels split over threads
+class PixelEventStoreWriter {
+public:
+  PixelEventStoreWriter(int nx, int ny, std::string tmpPath)
+    : nx_(nx), ny_(ny), tmpPath_(std::move(tmpPath)), total_(static_cast<size_t>(nx) * ny, 0) {}
+
+  ~PixelEventStoreWriter() {
+    if (tmp_) std::fclose(tmp_);
+    if (!tmpPath_.empty()) std::remove(tmpPath_.c_str());
+  }
+
+  // events: (pixel index x * ny + y, event); reordered in place
+  bool AddRun(std::vector<std::pair<uint32_t, StoreEvent>>& events) {
+    if (!tmp_ && !(tmp_ = std::fopen(tmpPath_.c_str(), "w+b"))) return false;
+    std::sort(events.begin(), events.end(), [](const auto& a, const auto& b) {
+      return a.first != b.first ? a.first < b.first : StoreEventLess(a.second, b.second);
+    });
+    std::vector<uint32_t> counts(total_.size(), 0);
+    std::vector<StoreEvent> buf;
+    buf.reserve(events.size());
+    for (const auto& pe : events) {
+      if (pe.first >= total_.size()) continue;
+      ++counts[pe.first];
+      buf.push_back(pe.second);
+    }
+    if (!buf.empty() && std::fwrite(buf.data(), sizeof(StoreEvent), buf.size(), tmp_) != buf.size()) return false;
+    for (size_t p = 0; p < counts.size(); ++p) total_[p] += counts[p];
+    runCounts_.push_back(std::move(counts));
+    return true;
+  }
+
+  // nThreads <= 0: hardware concurrency
+  bool Finish(const std::string& path, int nThreads = 0) {
+    const size_t nPix = total_.size();
+    std::vector<uint64_t> offset(nPix + 1, 0);
+    for (size_t p = 0; p < nPix; ++p) offset[p + 1] = offset[p] + total_[p];
+    const uint64_t n = offset[nPix];
+    const size_t headBytes = sizeof(StoreHeader) + (nPix + 1) * sizeof(uint64_t);
+    const size_t bytes = headBytes + n * sizeof(StoreEvent);
+
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) { ::close(fd); return false; }
+    void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    char* base = static_cast<char*>(p);
+    std::memcpy(base + sizeof(StoreHeader), offset.data(), (nPix + 1) * sizeof(uint64_t));
+    StoreEvent* events = reinterpret_cast<StoreEvent*>(base + headBytes);
+
+    // runs in order: each pixel's slice goes right after the previous run's slice of that pixel
+    bool ok = true;
+    std::vector<uint64_t> cursor(offset.begin(), offset.end() - 1);
+    if (tmp_) {
+      std::rewind(tmp_);
+      for (const auto& counts : runCounts_) {
+        for (size_t px = 0; px < nPix && ok; ++px) {
+          if (!counts[px]) continue;
+          ok = std::fread(events + cursor[px], sizeof(StoreEvent), counts[px], tmp_) == counts[px];
+          cursor[px] += counts[px];
+        }
+      }
+    }
+
+    // time order within each pixel, and the global time range
+    if (nThreads <= 0) nThreads = static_cast<int>(std::thread::hardware_concurrency());
+    nThreads = std::max(1, std::min<int>(nThreads, static_cast<int>(nPix)));
+    std::vector<uint64_t> tMin(nThreads, UINT64_MAX), tMax(nThreads, 0);
+    auto worker = [&](int w) {
+      for (size_t px = static_cast<size_t>(w); px < nPix; px += static_cast<size_t>(nThreads)) {
+        StoreEvent* b = events + offset[px];
+        StoreEvent* e = events + offset[px + 1];
+        if (b == e) continue;
+        if (!std::is_sorted(b, e, StoreEventLess)) std::sort(b, e, StoreEventLess);
+        tMin[w] = std::min(tMin[w], b->ts);
+        tMax[w] = std::max(tMax[w], (e - 1)->ts);
+      }
+    };
+    std::vector<std::thread> pool;
+    for (int w = 0; w < nThreads; ++w) pool.emplace_back(worker, w);
+    for (auto& t : pool) t.join();
+
+    StoreHeader h{};
+    std::memcpy(h.magic, kStoreMagic, 8);
+    h.version = 1;
+    h.nx = static_cast<uint32_t>(nx_);
+    h.ny = static_cast<uint32_t>(ny_);
+    h.nEvents = n;
+    h.tMin = n ? *std::min_element(tMin.begin(), tMin.end()) : 0;
+    h.tMax = n ? *std::max_element(tMax.begin(), tMax.end()) : 0;
+    if (!ok) std::memset(h.magic, 0, 8); // a truncated store must not open
+    std::memcpy(base, &h, sizeof(h));
+
+    ok = (::msync(base, bytes, MS_SYNC) == 0) && ok;
+    ::munmap(base, bytes);
+    return ok;
+  }
+
+  uint64_t Count() const {
+    uint64_t n = 0;
+    for (uint64_t c : total_) n += c;
+    return n;
+  }
+
+private:
+  int nx_, ny_;
+  std::string tmpPath_;
+  std::FILE* tmp_ = nullptr;
+  std::vector<uint64_t> total_;
+  std::vector<std::vector<uint32_t>> runCounts_;
+};
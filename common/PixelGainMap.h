@@ -0,0 +1,241 @@
+#pragma once
+// PixelGainMap: per-pixel (X strip x Y strip) gain correction on top of a per-strip calibration,
+// E_pix = g(x, y) * E_strip, and PixelGainBuilder, which estimates g from known lines.
+// Used by:
+//   DSSD_recal_all/Calibrator.cpp         builds PIXEL_MAP_FILE from the decay hits (REF_PEAKS)
+//   A80_fixedN_final_package/RunProcessor  applies it to DSSDX_E while reading (--pixel-gain FILE)
+// Build: add -I../common (see the Makefiles).
+//
+// File format (text): "# PixelGainMap nx ny" header, then one line per pixel "x y gain err n".
+//
+// Estimator (PixelGainBuilder):
+//   A hit within +-window of a line adds r = E / E_line to its pixel. r is histogrammed in one
+//   HistBank (nx*ny channels, nBins on [1-rWin, 1+rWin]), so memory does not grow with the event
+//   count and all lines pool into a single peak at r = mu; the gain is g = 1 / mu.
+//   - pixels with >= minFit counts: Poisson-ML Gaussian + flat background (FitGausBatch, one batch)
+//   - fewer counts, failed or degenerate fit: mean of r, error rms / sqrt(n), rms floored at
+//     the pooled within-pixel width (a single hit does not pin its pixel)
+//   Every estimate is then shrunk toward the strip calibration (mu = 1) with a normal prior of
+//   width tau, tau^2 = spread of the fitted mu minus their mean squared error (method of moments).
+//   Empty pixels stay at g = 1; sparse pixels move only as far as their statistics allow.
+
+#include "GausFit.h"
+#include "HistBank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class PixelGainMap {
+public:
+  PixelGainMap(int nx = 128, int ny = 48)
+    : nx_(nx), ny_(ny), gain_(static_cast<size_t>(nx) * ny, 1.0f),
+      err_(static_cast<size_t>(nx) * ny, 0.0f), n_(static_cast<size_t>(nx) * ny, 0u) {}
+
+  int NX() const { return nx_; }
+  int NY() const { return ny_; }
+
+  // hot path: one multiply; pixels outside the map are left unchanged
+  double Apply(int x, int y, double e) const {
+    if (x < 0 || x >= nx_ || y < 0 || y >= ny_) return e;
+    return e * gain_[static_cast<size_t>(x) * ny_ + y];
+  }
+
+  double Gain(int x, int y) const { return gain_[Index(x, y)]; }
+  double Error(int x, int y) const { return err_[Index(x, y)]; }
+  uint32_t Counts(int x, int y) const { return n_[Index(x, y)]; }
+
+  void Set(int x, int y, double gain, double err, uint32_t n) {
+    const size_t i = Index(x, y);
+    gain_[i] = static_cast<float>(gain);
+    err_[i]  = static_cast<float>(err);
+    n_[i]    = n;
+  }
+
+  bool Save(const std::string& path) const {
+    std::FILE* fp = std::fopen(path.c_str(), "w");
+    if (!fp) return false;
+    std::fprintf(fp, "# PixelGainMap %d %d\n# x\ty\tgain\t\terr\t\tn\n", nx_, ny_);
+    for (int x = 0; x < nx_; ++x) {
+      for (int y = 0; y < ny_; ++y) {
+        const size_t i = Index(x, y);
+        std::fprintf(fp, "%d\t%d\t%.7f\t%.7f\t%u\n", x, y, gain_[i], err_[i], n_[i]);
+      }
+    }
+    return std::fclose(fp) == 0;
+  }
+
+  // nullptr if the file cannot be read or has no "# PixelGainMap nx ny" header
+  static std::unique_ptr<PixelGainMap> Load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) return nullptr;
+    std::string line, tag;
+    std::unique_ptr<PixelGainMap> m;
+    while (std::getline(in, line)) {
+      if (line.empty()) continue;
+      std::istringstream ss(line);
+      if (line[0] == '#') {
+        int nx = 0, ny = 0;
+        if (!m && ss >> tag >> tag >> nx >> ny && tag == "PixelGainMap" && nx > 0 && ny > 0) {
+          m = std::make_unique<PixelGainMap>(nx, ny);
+        }
+        continue;
+      }
+      if (!m) return nullptr;
+      int x, y;
+      double g, e;
+      unsigned n;
+      if (ss >> x >> y >> g >> e >> n && x >= 0 && x < m->nx_ && y >= 0 && y < m->ny_) {
+        m->Set(x, y, g, e, n);
+      }
+    }
+    return m;
+  }
+
+private:
+  size_t Index(int x, int y) const { return static_cast<size_t>(x) * ny_ + y; }
+
+  int nx_, ny_;
+  std::vector<float> gain_, err_;
+  std::vector<uint32_t> n_;
+};
+
+struct PixelGainLine {
+  double energy; // keV
+  double window; // keV, hits within +-window of energy are used
+};
+
+class PixelGainBuilder {
+public:
+  PixelGainBuilder(int nx, int ny, std::vector<PixelGainLine> lines, unsigned nSlots, int nBins = 100)
+    : nx_(nx), ny_(ny), lines_(std::move(lines)), rWin_(RatioWindow(lines_)), nBins_(nBins),
+      bank_(nx * ny, nBins, 1.0 - rWin_, 1.0 + rWin_, nSlots) {}
+
+  // one hit with strip-calibrated energy e on pixel (x, y); ForeachSlot-safe
+  void Fill(unsigned slot, int x, int y, double e) {
+    if (x < 0 || x >= nx_ || y < 0 || y >= ny_) return;
+    for (const PixelGainLine& l : lines_) {
+      if (std::abs(e - l.energy) < l.window) {
+        bank_.Fill(slot, x * ny_ + y, e / l.energy);
+        return;
+      }
+    }
+  }
+
+  // call once after filling; nThreads <= 0: hardware concurrency
+  PixelGainMap Build(int minFit = 50, int nThreads = 0) {
+    bank_.Merge(nThreads);
+    const int nPix = nx_ * ny_;
+    const double lo = 1.0 - rWin_, dr = 2.0 * rWin_ / nBins_;
+
+    // moments of r for every pixel (in-range bins only)
+    std::vector<double> n(nPix, 0.0), mean(nPix, 1.0), emean(nPix, 0.0), ss(nPix, 0.0);
+    double ssSum = 0, dof = 0;
+    for (int p = 0; p < nPix; ++p) {
+      const uint32_t* c = bank_.Cells(p) + 1;
+      double s0 = 0, s1 = 0, s2 = 0;
+      for (int b = 0; b < nBins_; ++b) {
+        const double r = lo + (b + 0.5) * dr;
+        s0 += c[b]; s1 += c[b] * r; s2 += c[b] * r * r;
+      }
+      n[p] = s0;
+      if (s0 > 0) {
+        mean[p] = s1 / s0;
+        ss[p] = std::max(s2 - s1 * mean[p], 0.0);
+        ssSum += ss[p];
+        dof += s0 - 1.0;
+      }
+    }
+    // per-hit variance is floored at the pooled within-pixel line width: a pixel with one or
+    // two hits would otherwise get a near-zero error and take its gain from those hits alone
+    const double varPool = std::max((dof > 0) ? ssSum / dof : 0.0, dr * dr / 12.0);
+    for (int p = 0; p < nPix; ++p) {
+      if (n[p] > 0) emean[p] = std::sqrt(std::max(ss[p] / n[p], varPool) / n[p]);
+    }
+
+    // batched fits of the well-populated pixels
+    std::vector<int> fitPix;
+    for (int p = 0; p < nPix; ++p) if (n[p] >= minFit) fitPix.push_back(p);
+    std::vector<double> y(fitPix.size() * nBins_);
+    std::vector<GausFitTask> tasks(fitPix.size());
+    for (size_t k = 0; k < fitPix.size(); ++k) {
+      const int p = fitPix[k];
+      const uint32_t* c = bank_.Cells(p) + 1;
+      double* yk = &y[k * nBins_];
+      int imax = 0;
+      for (int b = 0; b < nBins_; ++b) {
+        yk[b] = c[b];
+        if (yk[b] > yk[imax]) imax = b;
+      }
+      GausFitTask& t = tasks[k];
+      t.y = yk; t.n = nBins_;
+      t.xlo = lo; t.xhi = 1.0 + rWin_;
+      t.lo = t.xlo; t.hi = t.xhi;
+      t.A0 = yk[imax];
+      t.mu0 = lo + (imax + 0.5) * dr;
+      t.sigma0 = std::max(emean[p] * std::sqrt(n[p]), dr);
+      t.sigmaMin = 0.5 * dr;
+      t.sigmaMax = rWin_;
+      t.muMin = t.xlo; t.muMax = t.xhi;
+      t.background = true;
+      t.cost = GausFitCost::kPoissonML;
+    }
+    const std::vector<GausFitResult> res = FitGausBatch(tasks, nThreads);
+
+    std::vector<double> mu(mean), emu(emean);
+    double sumD2 = 0, sumE2 = 0;
+    int nFit = 0;
+    for (size_t k = 0; k < fitPix.size(); ++k) {
+      const GausFitResult& r = res[k];
+      const int p = fitPix[k];
+      // a fit much less precise than the plain mean is degenerate (peak traded against background)
+      if (!r.ok() || !(r.emu > 0) || r.emu > 3.0 * emean[p]) continue;
+      mu[p] = r.mu; emu[p] = r.emu;
+      sumD2 += (r.mu - 1.0) * (r.mu - 1.0);
+      sumE2 += r.emu * r.emu;
+      ++nFit;
+    }
+    // prior width: pixel-to-pixel spread seen by the fits, floored at one bin
+    tau_ = (nFit > 0) ? std::sqrt(std::max((sumD2 - sumE2) / nFit, 0.0)) : 0.0;
+    tau_ = std::max(tau_, dr);
+    nFit_ = nFit;
+
+    PixelGainMap m(nx_, ny_);
+    const double wPrior = 1.0 / (tau_ * tau_);
+    for (int p = 0; p < nPix; ++p) {
+      double muP = 1.0, eP = tau_;
+      if (n[p] > 0 && emu[p] > 0) {
+        const double w = 1.0 / (emu[p] * emu[p]);
+        muP = (w * mu[p] + wPrior) / (w + wPrior);
+        eP  = 1.0 / std::sqrt(w + wPrior);
+      }
+      m.Set(p / ny_, p % ny_, 1.0 / muP, eP / (muP * muP), static_cast<uint32_t>(n[p]));
+    }
+    return m;
+  }
+
+  double RatioWindow() const { return rWin_; }
+  double PriorWidth() const { return tau_; } // after Build
+  int NFitted() const { return nFit_; }      // after Build
+
+private:
+  static double RatioWindow(const std::vector<PixelGainLine>& lines) {
+    double w = 0.0;
+    for (const PixelGainLine& l : lines) w = std::max(w, l.window / l.energy);
+    return w > 0.0 ? w : 0.01;
+  }
+
+  int nx_, ny_;
+  std::vector<PixelGainLine> lines_;
+  double rWin_;
+  int nBins_;
+  HistBank bank_;
+  double tau_ = 0.0;
+  int nFit_ = 0;
+};